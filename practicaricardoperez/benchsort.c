@@ -0,0 +1,74 @@
+// Benchmark del radix sort paralelo, fuera del programa interactivo:
+//
+//   gcc -O2 -pthread -o benchsort benchsort.c lib.c
+//   ./benchsort [<filas>]
+//
+// Ordena double aleatorios con 1, 2, 4... hasta numeroHilos() hilos y muestra
+// el tiempo, las filas por segundo y la aceleración respecto a un hilo.
+#include "lib.h"
+
+#define FILAS_POR_DEFECTO 10000000
+
+int main(int argc, char **argv) {
+    long long leidas = FILAS_POR_DEFECTO;
+    if (argc > 2 || (argc == 2 && sscanf(argv[1], "%lld", &leidas) != 1) || leidas < 2) {
+        print_error("Uso: benchsort [<filas>] (al menos 2)");
+        return 1;
+    }
+    int64_t numFilas = (int64_t)leidas;
+    double *valores = malloc((size_t)numFilas * sizeof(double));
+    uint64_t *claves = malloc((size_t)numFilas * sizeof(uint64_t));
+    int64_t *indices = malloc((size_t)numFilas * sizeof(int64_t));
+    if (!valores || !claves || !indices) {
+        free(valores);
+        free(claves);
+        free(indices);
+        print_error("No hay memoria suficiente para el benchmark");
+        return 1;
+    }
+
+    // xorshift64*: reproducible y sin depender de rand()
+    uint64_t estado = 0x9E3779B97F4A7C15ULL;
+    for (int64_t i = 0; i < numFilas; i++) {
+        estado ^= estado >> 12;
+        estado ^= estado << 25;
+        estado ^= estado >> 27;
+        valores[i] = (double)((estado * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0 * 1e6 - 5e5;
+    }
+
+    int maxHilos = numeroHilos();
+    int resultado = 0;
+    double tiempoBase = 0;
+    printf(GREEN "Radix sort de %" PRId64 " double (%d núcleos disponibles)\n" RESET, numFilas, maxHilos);
+    for (int hilos = 1;; hilos = hilos * 2 < maxHilos ? hilos * 2 : maxHilos) {
+        for (int64_t i = 0; i < numFilas; i++) {
+            claves[i] = claveOrdenableReal(valores[i]);
+            indices[i] = i;
+        }
+        double inicio = tiempoActual();
+        int ok = radixSortClaves(claves, indices, numFilas, (int)sizeof(uint64_t), hilos);
+        double segundos = tiempoActual() - inicio;
+        if (!ok) {
+            print_error("No hay memoria suficiente para el benchmark");
+            resultado = 1;
+            break;
+        }
+        for (int64_t i = 1; i < numFilas; i++) {
+            if (valores[indices[i - 1]] > valores[indices[i]]) {
+                print_error("El resultado del radix sort no está ordenado");
+                resultado = 1;
+                break;
+            }
+        }
+        if (hilos == 1)
+            tiempoBase = segundos;
+        printf("  %2d hilos: %8.3f s  %8.1f Mfilas/s  aceleración x%.2f\n", hilos, segundos,
+               (double)numFilas / segundos / 1e6, tiempoBase / segundos);
+        if (hilos == maxHilos)
+            break;
+    }
+    free(valores);
+    free(claves);
+    free(indices);
+    return resultado;
+}
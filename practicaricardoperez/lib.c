@@ -4,7 +4,7 @@ Lista listaDF = {0, NULL};
 Dataframe *dfActual = NULL;
 char promptTerminal[MAX_LINE_LENGTH] = "[?]:> ";
 
-Dataframe *crearNuevoDataframe(int numColumnas, int numFilas, const char *nombre) {
+Dataframe *crearNuevoDataframe(int numColumnas, int64_t numFilas, const char *nombre) {
     Dataframe *df = malloc(sizeof(Dataframe));
     if (!df || !crearDF(df, numColumnas, numFilas, nombre)) {
         free(df);
@@ -21,15 +21,22 @@ void copiarNombreColumna(char *destino, const char *origen) {
     destino[MAX_NOMBRE_COLUMNA - 1] = '\0';
 }
 
-char *copiarDatoSeguro(const char *origen) { return origen ? strdup(origen) : NULL; }
-
 void actualizarPrompt(const Dataframe *df) {
     if (!df) {
         strncpy(promptTerminal, "[?]:> ", MAX_LINE_LENGTH);
         return;
     }
     const char *nombre_mostrar = (df->nombre[0] != '\0') ? df->nombre : df->indice;
-    snprintf(promptTerminal, MAX_LINE_LENGTH, "[%s: %d,%d]:> ", nombre_mostrar, df->numFilas, df->numColumnas);
+    // Con operaciones pendientes las filas no se conocen hasta ejecutarlas
+    if (df->plan && df->plan->numOperaciones > 0)
+        snprintf(promptTerminal, MAX_LINE_LENGTH, "[%s (lazy): ?,%d]:> ", nombre_mostrar,
+                 df->plan->muestra->numColumnas);
+    else if (df->plan)
+        snprintf(promptTerminal, MAX_LINE_LENGTH, "[%s (lazy): %" PRId64 ",%d]:> ", nombre_mostrar,
+                 df->numFilas, df->numColumnas);
+    else
+        snprintf(promptTerminal, MAX_LINE_LENGTH, "[%s: %" PRId64 ",%d]:> ", nombre_mostrar, df->numFilas,
+                 df->numColumnas);
 }
 
 void liberarRecursosEnError(Dataframe *df, const char *mensaje) {
@@ -38,57 +45,21 @@ void liberarRecursosEnError(Dataframe *df, const char *mensaje) {
     print_error(mensaje);
 }
 
-void procesarPorLotes(FILE *archivo, Dataframe *df, int tamanoLote) {
-    VALIDAR_DF_Y_PARAMETROS(df, archivo);
-
-    char *lineaLeida = NULL;
-    size_t len = 0;
-    int filaActual = 0;
-    int numMaxFilas = tamanoLote;
-    char buffer[2048] = {0};
-
-    while (getline(&lineaLeida, &len, archivo) != -1) {
-        if (filaActual >= numMaxFilas) {
-            numMaxFilas += tamanoLote;
-
-            for (int columnaActual = 0; columnaActual < df->numColumnas; columnaActual++) {
-                char **nuevos_datos =
-                    realloc(df->columnas[columnaActual].datos, numMaxFilas * sizeof(char *));
-                EstadoNulo *nuevos_nulos =
-                    realloc(df->columnas[columnaActual].esNulo, numMaxFilas * sizeof(EstadoNulo));
-
-                if (!nuevos_datos || !nuevos_nulos) {
-                    liberarRecursosEnError(df, "Error al expandir memoria");
-                    free(lineaLeida);
-                    return;
-                }
-
-                df->columnas[columnaActual].datos = nuevos_datos;
-                df->columnas[columnaActual].esNulo = nuevos_nulos;
-
-                for (int j = filaActual; j < numMaxFilas; j++) {
-                    df->columnas[columnaActual].datos[j] = NULL;
-                    df->columnas[columnaActual].esNulo[j] = NO_NULO;
-                }
-            }
-        }
-
-        verificarNulos(lineaLeida, filaActual, df, buffer);
-        char *token = strtok(buffer, ",\n\r");
-        int columnaActual = 0;
-
-        while (token && columnaActual < df->numColumnas) {
-            if (!df->columnas[columnaActual].esNulo[filaActual]) {
-                df->columnas[columnaActual].datos[filaActual] = strdup(token);
-            }
-            token = strtok(NULL, ",\n\r");
-            columnaActual++;
+// Sustituye dfActual por 'nuevo' también en listaDF, para que la lista no
+// quede apuntando a un dataframe ya liberado.
+void reemplazarDFActual(Dataframe *nuevo) {
+    for (Nodo *nodo = listaDF.primero; nodo; nodo = nodo->siguiente) {
+        if (nodo->df == dfActual) {
+            nodo->df = nuevo;
+            break;
         }
-        filaActual++;
     }
-
-    df->numFilas = filaActual;
-    free(lineaLeida);
+    // El modo lazy sigue en el df nuevo
+    nuevo->plan = dfActual->plan;
+    dfActual->plan = NULL;
+    liberarMemoriaDF(dfActual);
+    dfActual = nuevo;
+    actualizarPrompt(dfActual);
 }
 
 void liberarListaCompleta(Lista *lista) {
@@ -105,100 +76,187 @@ void liberarListaCompleta(Lista *lista) {
     lista->numDFs = 0;
 }
 
-int comparar(void *dato1, void *dato2, TipoDato tipo, const char *operador) {
-    if (!dato1 || !dato2)
-        return 0;
-    switch (tipo) {
-    case NUMERICO: {
-        char *str1 = (char *)dato1;
-        char *str2 = (char *)dato2;
-        double val1, val2;
-        char *endptr1, *endptr2;
-        val1 = strtod(str1, &endptr1);
-        val2 = strtod(str2, &endptr2);
-        if (endptr1 == str1 || endptr2 == str2) {
-            return 0;
-        }
-        if (strcmp(operador, "eq") == 0)
-            return fabs(val1 - val2) < 1e-10;
-        if (strcmp(operador, "neq") == 0)
-            return fabs(val1 - val2) >= 1e-10;
-        if (strcmp(operador, "gt") == 0)
-            return val1 > val2;
-        if (strcmp(operador, "lt") == 0)
-            return val1 < val2;
-        if (strcmp(operador, "get") == 0)
-            return val1 >= val2;
-        if (strcmp(operador, "let") == 0)
-            return val1 <= val2;
-        break;
-    }
-    case FECHA: {
-        struct tm tm1 = {0}, tm2 = {0};
-        if (sscanf((char *)dato1, "%d-%d-%d", &tm1.tm_year, &tm1.tm_mon, &tm1.tm_mday) != 3 ||
-            sscanf((char *)dato2, "%d-%d-%d", &tm2.tm_year, &tm2.tm_mon, &tm2.tm_mday) != 3) {
-            return 0;
-        }
-        tm1.tm_year -= 1900;
-        tm2.tm_year -= 1900;
-        tm1.tm_mon -= 1;
-        tm2.tm_mon -= 1;
-        time_t time1 = mktime(&tm1);
-        time_t time2 = mktime(&tm2);
-        if (strcmp(operador, "eq") == 0)
-            return time1 == time2;
-        if (strcmp(operador, "neq") == 0)
-            return time1 != time2;
-        if (strcmp(operador, "gt") == 0)
-            return time1 > time2;
-        if (strcmp(operador, "lt") == 0)
-            return time1 < time2;
-        if (strcmp(operador, "get") == 0)
-            return time1 >= time2;
-        if (strcmp(operador, "let") == 0)
-            return time1 <= time2;
-        break;
-    }
-    case TEXTO: {
-        int comp = strcmp((char *)dato1, (char *)dato2);
-        if (strcmp(operador, "eq") == 0)
-            return comp == 0;
-        if (strcmp(operador, "neq") == 0)
-            return comp != 0;
-        if (strcmp(operador, "gt") == 0)
-            return comp > 0;
-        if (strcmp(operador, "lt") == 0)
-            return comp < 0;
-        if (strcmp(operador, "get") == 0)
-            return comp >= 0;
-        if (strcmp(operador, "let") == 0)
-            return comp <= 0;
-        break;
-    }
-    }
-    return 0;
-}
-
 void liberarMemoriaDF(Dataframe *df) {
     if (!df) {
         return;
     }
+    liberarPlan(df->plan);
+
+    // Una vista comparte las columnas de su padre: se liberan con él
+    if (df->padre) {
+        free(df->filas);
+        liberarMemoriaDF(df->padre);
+        free(df);
+        return;
+    }
 
     if (df->columnas) {
         for (int i = 0; i < df->numColumnas; i++) {
-            if (df->columnas[i].datos) {
-                for (int j = 0; j < df->numFilas; j++) {
-                    free(df->columnas[i].datos[j]);
-                }
-                free(df->columnas[i].datos);
-            }
-            free(df->columnas[i].esNulo);
+            df->columnas[i].numFilas = df->numFilas;
+            liberarDatosColumna(&df->columnas[i]);
         }
         free(df->columnas);
     }
     free(df);
 }
 
+// destino[i] = origen[filas[i]] para celdas de 'tam' bytes
+void reunirCeldas(void *destino, const void *origen, const int64_t *filas, int64_t n, size_t tam) {
+    switch (tam) {
+    case sizeof(uint8_t):
+        for (int64_t i = 0; i < n; i++)
+            ((uint8_t *)destino)[i] = ((const uint8_t *)origen)[filas[i]];
+        break;
+    case sizeof(uint16_t):
+        for (int64_t i = 0; i < n; i++)
+            ((uint16_t *)destino)[i] = ((const uint16_t *)origen)[filas[i]];
+        break;
+    case sizeof(uint32_t):
+        for (int64_t i = 0; i < n; i++)
+            ((uint32_t *)destino)[i] = ((const uint32_t *)origen)[filas[i]];
+        break;
+    default:
+        for (int64_t i = 0; i < n; i++)
+            ((uint64_t *)destino)[i] = ((const uint64_t *)origen)[filas[i]];
+        break;
+    }
+}
+
+// Bitmap de validez de las filas 'filas' de 'origen', en ese orden. Los bits
+// sobrantes de la última palabra quedan a 1, como en las filas sin usar.
+void reunirValidos(uint64_t *destino, const Columna *origen, const int64_t *filas, int64_t n) {
+    for (size_t w = 0; w < PALABRAS_BITMAP(n); w++) {
+        int64_t base = (int64_t)w * 64;
+        int64_t cuantas = n - base < 64 ? n - base : 64;
+        uint64_t palabra = ~0ULL;
+        for (int64_t b = 0; b < cuantas; b++) {
+            if (ES_NULO(origen, filas[base + b]))
+                palabra &= ~(1ULL << b);
+        }
+        destino[w] = palabra;
+    }
+}
+
+// Copia la validez de las filas [0, n) de 'origen' a partir de la fila
+// 'desde' de 'destino', palabra a palabra
+void copiarValidos(Columna *destino, int64_t desde, const Columna *origen, int64_t n) {
+    int desplazamiento = (int)(desde & 63);
+    uint64_t *d = destino->validos + (desde >> 6);
+    for (size_t w = 0; w < PALABRAS_BITMAP(n); w++) {
+        int64_t quedan = n - (int64_t)w * 64;
+        uint64_t v = origen->validos[w];
+        if (quedan < 64)
+            v |= ~0ULL << quedan;
+        if (desplazamiento == 0) {
+            d[w] = v;
+            continue;
+        }
+        d[w] = (d[w] & ((1ULL << desplazamiento) - 1)) | (v << desplazamiento);
+        // Lo que no cabe pasa a la palabra siguiente si aún quedan filas de 'origen'
+        if (quedan > 64 - desplazamiento)
+            d[w + 1] = (d[w + 1] & (~0ULL << desplazamiento)) | (v >> (64 - desplazamiento));
+    }
+}
+
+// Nulos entre las primeras 'n' filas de la columna, con popcount
+int64_t contarNulos(const Columna *col, int64_t n) {
+    int64_t validas = 0;
+    size_t completas = (size_t)(n / 64);
+    for (size_t w = 0; w < completas; w++)
+        validas += __builtin_popcountll(col->validos[w]);
+    if (n & 63)
+        validas += __builtin_popcountll(col->validos[completas] & ((1ULL << (n & 63)) - 1));
+    return n - validas;
+}
+
+// Convierte una vista en un df normal, en el mismo sitio. El padre pertenece
+// solo a la vista, así que las cadenas seleccionadas se traspasan sin copiarlas
+// y las demás se liberan.
+int materializarDF(Dataframe *df) {
+    if (!df || !df->padre)
+        return 1;
+    Dataframe *padre = df->padre;
+    int64_t n = df->numFilas;
+    size_t filas = (size_t)(n > 0 ? n : 1);
+
+    void **valores = calloc((size_t)df->numColumnas, sizeof(void *));
+    uint64_t **nulos = calloc((size_t)df->numColumnas, sizeof(uint64_t *));
+    int ok = valores && nulos;
+    for (int c = 0; ok && c < df->numColumnas; c++) {
+        valores[c] = malloc(filas * tamanoCelda(df->columnas[c].formato));
+        nulos[c] = malloc(PALABRAS_BITMAP(filas) * sizeof(uint64_t));
+        ok = valores[c] && nulos[c];
+    }
+    if (!ok) {
+        for (int c = 0; valores && nulos && c < df->numColumnas; c++) {
+            free(valores[c]);
+            free(nulos[c]);
+        }
+        free(valores);
+        free(nulos);
+        print_error("Error de memoria al materializar el df");
+        return 0;
+    }
+
+    for (int c = 0; c < df->numColumnas; c++) {
+        Columna *col = &df->columnas[c];
+        reunirValidos(nulos[c], col, df->filas, n);
+        // Las cadenas siguen en la arena de la columna: solo se reúnen punteros
+        reunirCeldas(valores[c], col->valores, df->filas, n, tamanoCelda(col->formato));
+        soltarAlmacen(col);
+        col->valores = valores[c];
+        col->validos = nulos[c];
+        col->numFilas = n;
+        col->capacidad = (int64_t)filas;
+    }
+    free(valores);
+    free(nulos);
+
+    free(df->filas);
+    free(padre);
+    df->filas = NULL;
+    df->padre = NULL;
+    return 1;
+}
+
+// Materializa dfActual si es una vista, para los comandos que modifican el
+// almacenamiento de las columnas
+static int materializarDFActual(void) {
+    if (!dfActual || !dfActual->padre)
+        return 1;
+    return materializarDF(dfActual);
+}
+
+// Nuevo df con las columnas de dfActual compartidas, sin copiar sus datos,
+// salvo 'omitida' (-1: ninguna). Si 'nueva' >= 0 deja en esa posición una
+// columna vacía con sitio para todas las filas.
+static Dataframe *derivarDFActual(int omitida, int nueva) {
+    int numColumnas = dfActual->numColumnas - (omitida >= 0) + (nueva >= 0);
+    Dataframe *df = crearNuevoDataframe(numColumnas, 0, dfActual->nombre);
+    if (!df)
+        return NULL;
+    int destino = 0;
+    for (int c = 0; c < dfActual->numColumnas; c++) {
+        if (c == omitida)
+            continue;
+        if (destino == nueva)
+            destino++;
+        if (!compartirColumna(&df->columnas[destino++], &dfActual->columnas[c])) {
+            liberarRecursosEnError(df, "Error de memoria al compartir columnas");
+            return NULL;
+        }
+    }
+    if (nueva >= 0) {
+        if (!reservarFilasColumna(&df->columnas[nueva], dfActual->numFilas)) {
+            liberarRecursosEnError(df, "Error de memoria al crear la columna");
+            return NULL;
+        }
+        df->columnas[nueva].numFilas = dfActual->numFilas;
+    }
+    df->numFilas = dfActual->numFilas;
+    return df;
+}
+
 int agregarDF(Dataframe *nuevoDF) {
     if (!nuevoDF) {
         print_error("Dataframe inválido");
@@ -220,88 +278,397 @@ int agregarDF(Dataframe *nuevoDF) {
     return 1;
 }
 
-void contarFilasYColumnas(const char *nombre_archivo, int *numFilas, int *numColumnas) {
-    FILE *file = fopen(nombre_archivo, "r");
-    if (!file) {
-        print_error("No se puede abrir el archivo");
-        return;
+// Garantiza espacio para al menos 'minimo' filas. La capacidad se duplica
+// para que añadir filas una a una cueste O(1) amortizado.
+int reservarFilasColumna(Columna *col, int64_t minimo) {
+    if (!col || minimo < 0)
+        return 0;
+    if (minimo <= col->capacidad && col->valores && col->validos)
+        return 1;
+    if (!separarColumna(col))
+        return 0;
+
+    int64_t nuevaCapacidad = col->capacidad;
+    if (nuevaCapacidad == 0)
+        nuevaCapacidad = minimo > CAPACIDAD_INICIAL ? minimo : CAPACIDAD_INICIAL;
+    while (nuevaCapacidad < minimo)
+        nuevaCapacidad *= 2;
+
+    size_t tam = tamanoCelda(col->formato);
+    char *nuevos_valores = realloc(col->valores, (size_t)nuevaCapacidad * tam);
+    if (!nuevos_valores)
+        return 0;
+    col->valores = nuevos_valores;
+    size_t palabras = PALABRAS_BITMAP(col->capacidad);
+    uint64_t *nuevos_validos = realloc(col->validos, PALABRAS_BITMAP(nuevaCapacidad) * sizeof(uint64_t));
+    if (!nuevos_validos)
+        return 0;
+    col->validos = nuevos_validos;
+
+    // Las filas nuevas empiezan vacías y no nulas, como en crearDF. Los bits
+    // sin usar de la última palabra ya estaban a 1.
+    memset(nuevos_valores + (size_t)col->capacidad * tam, 0, (size_t)(nuevaCapacidad - col->capacidad) * tam);
+    memset(col->validos + palabras, 0xFF, (PALABRAS_BITMAP(nuevaCapacidad) - palabras) * sizeof(uint64_t));
+    col->capacidad = nuevaCapacidad;
+    return 1;
+}
+
+int reservarFilas(Dataframe *df, int64_t minimo) {
+    if (!df)
+        return 0;
+    for (int i = 0; i < df->numColumnas; i++) {
+        if (!reservarFilasColumna(&df->columnas[i], minimo))
+            return 0;
     }
+    return 1;
+}
 
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
+#define TAMANO_BLOQUE_ARENA (1 << 20)
 
-    *numFilas = 0;
-    *numColumnas = 0;
+ArenaTexto *crearArena(void) {
+    ArenaTexto *arena = calloc(1, sizeof(ArenaTexto));
+    if (arena)
+        arena->referencias = 1;
+    return arena;
+}
 
-    while ((read = getline(&line, &len, file)) != -1) {
-        (*numFilas)++;
-        if (*numFilas == 1) {
-            *numColumnas = contarColumnas(line);
-            if (*numColumnas > MAX_COLUMNS) {
-                print_error("Número de columnas excede el límite máximo");
-                free(line);
-                fclose(file);
-                return;
-            }
-        }
+ArenaTexto *retenerArena(ArenaTexto *arena) {
+    if (arena)
+        arena->referencias++;
+    return arena;
+}
+
+// Suelta una referencia; con la última se liberan todos los bloques
+void liberarArena(ArenaTexto *arena) {
+    if (!arena || --arena->referencias > 0)
+        return;
+    BloqueArena *bloque = arena->actual;
+    while (bloque) {
+        BloqueArena *anterior = bloque->anterior;
+        free(bloque);
+        bloque = anterior;
+    }
+    liberarMapa(arena->mapa);
+    free(arena);
+}
+
+// Copia 'len' bytes de 'texto' en la arena y añade el '\0' final
+char *copiarEnArena(ArenaTexto *arena, const char *texto, size_t len) {
+    BloqueArena *bloque = arena->actual;
+    if (!bloque || bloque->tamano - bloque->usado < len + 1) {
+        size_t tamano = len + 1 > TAMANO_BLOQUE_ARENA ? len + 1 : TAMANO_BLOQUE_ARENA;
+        BloqueArena *nuevo = malloc(sizeof(BloqueArena) + tamano);
+        if (!nuevo)
+            return NULL;
+        nuevo->anterior = bloque;
+        nuevo->usado = 0;
+        nuevo->tamano = tamano;
+        arena->actual = bloque = nuevo;
     }
+    char *destino = bloque->datos + bloque->usado;
+    memcpy(destino, texto, len);
+    destino[len] = '\0';
+    bloque->usado += len + 1;
+    return destino;
+}
 
-    free(line);
-    fclose(file);
+// Pasa los bloques de 'origen' a 'destino' sin copiar las cadenas (no se
+// mueven, así que los punteros a ellas siguen valiendo) y deja 'origen' vacío
+void traspasarArena(ArenaTexto *destino, ArenaTexto *origen) {
+    BloqueArena *primero = origen->actual;
+    if (!primero)
+        return;
+    while (primero->anterior)
+        primero = primero->anterior;
+    primero->anterior = destino->actual;
+    destino->actual = origen->actual;
+    origen->actual = NULL;
 }
 
-void leerEncabezados(FILE *file, Dataframe *df, int numColumnas) {
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
+// Guarda una cadena en la arena de la columna, creándola si aún no tiene
+char *guardarTextoColumna(Columna *col, const char *texto, size_t len) {
+    if (!col->arena && !(col->arena = crearArena()))
+        return NULL;
+    return copiarEnArena(col->arena, texto, len);
+}
 
-    if ((read = getline(&line, &len, file)) != -1) {
-        char *token = strtok(line, ",\n\r");
-        int col = 0;
-        while (token && col < numColumnas) {
-            strncpy(df->columnas[col].nombre, token, sizeof(df->columnas[col].nombre) - 1);
-            df->columnas[col].nombre[sizeof(df->columnas[col].nombre) - 1] = '\0';
-            token = strtok(NULL, ",\n\r");
-            col++;
+Diccionario *retenerDiccionario(Diccionario *dic) {
+    if (dic)
+        dic->referencias++;
+    return dic;
+}
+
+void liberarDiccionario(Diccionario *dic) {
+    if (!dic || --dic->referencias > 0)
+        return;
+    liberarArena(dic->arena);
+    free(dic->valores);
+    free(dic);
+}
+
+IndiceColumna *retenerIndice(IndiceColumna *indice) {
+    if (indice)
+        indice->referencias++;
+    return indice;
+}
+
+void liberarIndice(IndiceColumna *indice) {
+    if (!indice || --indice->referencias > 0)
+        return;
+    free(indice->filas);
+    free(indice->claves);
+    free(indice->inicios);
+    free(indice->huecos);
+    free(indice);
+}
+
+uint32_t codigoCelda(const Columna *col, int64_t fila) {
+    return col->formato == FMT_CATEGORIA8 ? col->codigos8[fila] : col->codigos16[fila];
+}
+
+#define MAX_CATEGORIAS 65536
+#define MIN_REPETICIONES_CATEGORIA 8 // Filas por valor distinto para que compense codificar
+
+static uint64_t hashTexto(const char *s) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+    return h;
+}
+
+// Busca 's' en la tabla hash (direccionamiento abierto sobre 'distintos');
+// devuelve su hueco en la tabla, ocupado o libre
+static size_t huecoTexto(const int32_t *tabla, size_t mascara, const char **distintos,
+                         const char *s) {
+    size_t h = (size_t)hashTexto(s) & mascara;
+    while (tabla[h] != -1 && strcmp(distintos[tabla[h]], s) != 0)
+        h = (h + 1) & mascara;
+    return h;
+}
+
+typedef struct {
+    const char *texto;
+    int32_t provisional;
+} ValorDistinto;
+
+static int compararValoresDistintos(const void *a, const void *b) {
+    return strcmp(((const ValorDistinto *)a)->texto, ((const ValorDistinto *)b)->texto);
+}
+
+// Codifica una columna de texto con pocos valores distintos como códigos
+// uint8/uint16 más un diccionario ordenado. Devuelve 0 (sin tocar nada) si la
+// columna no es de texto, tiene demasiados valores distintos o falta memoria.
+int codificarColumna(Columna *col) {
+    if (!col || col->formato != FMT_TEXTO || !separarColumna(col))
+        return 0;
+    int64_t n = col->numFilas, noNulas = 0;
+    for (int64_t i = 0; i < n; i++)
+        noNulas += !ES_NULO(col, i) && col->datos[i];
+    int64_t limite = noNulas / MIN_REPETICIONES_CATEGORIA;
+    if (limite > MAX_CATEGORIAS)
+        limite = MAX_CATEGORIAS;
+    if (limite < 1)
+        return 0;
+
+    size_t tamTabla = 16;
+    while (tamTabla < (size_t)limite * 2)
+        tamTabla *= 2;
+    int32_t *tabla = malloc(tamTabla * sizeof(int32_t));
+    const char **distintos = malloc((size_t)limite * sizeof(char *));
+    if (!tabla || !distintos) {
+        free(tabla);
+        free(distintos);
+        return 0;
+    }
+    memset(tabla, 0xFF, tamTabla * sizeof(int32_t));
+
+    // Primera pasada: valores distintos, abandonando en cuanto hay demasiados
+    int32_t numDistintos = 0;
+    for (int64_t i = 0; i < n; i++) {
+        if (ES_NULO(col, i) || !col->datos[i])
+            continue;
+        size_t h = huecoTexto(tabla, tamTabla - 1, distintos, col->datos[i]);
+        if (tabla[h] != -1)
+            continue;
+        if (numDistintos == limite) {
+            free(tabla);
+            free(distintos);
+            return 0;
         }
+        distintos[numDistintos] = col->datos[i];
+        tabla[h] = numDistintos++;
     }
 
-    free(line);
+    // El diccionario se ordena una sola vez; 'final' traduce código provisional a definitivo
+    ValorDistinto *orden = malloc((size_t)numDistintos * sizeof(ValorDistinto));
+    int32_t *final = malloc((size_t)numDistintos * sizeof(int32_t));
+    Diccionario *dic = calloc(1, sizeof(Diccionario));
+    Formato formato = numDistintos <= 256 ? FMT_CATEGORIA8 : FMT_CATEGORIA16;
+    int64_t capacidad = col->capacidad > 0 ? col->capacidad : 1;
+    void *codigos = calloc((size_t)capacidad, tamanoCelda(formato));
+    int ok = orden && final && dic && codigos;
+    if (ok) {
+        dic->referencias = 1;
+        dic->numValores = numDistintos;
+        dic->valores = malloc((size_t)numDistintos * sizeof(char *));
+        dic->arena = crearArena();
+        ok = dic->valores && dic->arena;
+    }
+    if (ok) {
+        for (int32_t j = 0; j < numDistintos; j++) {
+            orden[j].texto = distintos[j];
+            orden[j].provisional = j;
+        }
+        qsort(orden, (size_t)numDistintos, sizeof(ValorDistinto), compararValoresDistintos);
+        for (int32_t j = 0; ok && j < numDistintos; j++) {
+            final[orden[j].provisional] = j;
+            dic->valores[j] = copiarEnArena(dic->arena, orden[j].texto, strlen(orden[j].texto));
+            ok = dic->valores[j] != NULL;
+        }
+    }
+    if (ok) {
+        // Segunda pasada: código definitivo de cada fila (los nulos quedan a 0)
+        for (int64_t i = 0; i < n; i++) {
+            if (ES_NULO(col, i) || !col->datos[i])
+                continue;
+            int32_t codigo = final[tabla[huecoTexto(tabla, tamTabla - 1, distintos, col->datos[i])]];
+            if (formato == FMT_CATEGORIA8)
+                ((uint8_t *)codigos)[i] = (uint8_t)codigo;
+            else
+                ((uint16_t *)codigos)[i] = (uint16_t)codigo;
+        }
+        liberarArena(col->arena);
+        col->arena = NULL;
+        free(col->valores);
+        col->valores = codigos;
+        col->formato = formato;
+        col->dic = dic;
+    } else {
+        free(codigos);
+        if (dic) {
+            dic->referencias = 1;
+            liberarDiccionario(dic);
+        }
+    }
+    free(tabla);
+    free(distintos);
+    free(orden);
+    free(final);
+    return ok;
 }
 
-void leerFilas(FILE *file, Dataframe *df, int numFilas, int numColumnas) {
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    int fila_actual = 0;
-    char resultado[MAX_LINE_LENGTH * 2];
+// Suelta los valores y el bitmap de la columna; solo se liberan si ninguna
+// otra columna los comparte
+void soltarAlmacen(Columna *col) {
+    liberarIndice(col->indice);
+    col->indice = NULL;
+    if (!col->referencias || --*col->referencias == 0) {
+        if (col->mapa) {
+            liberarMapa(col->mapa);
+        } else {
+            free(col->valores);
+            free(col->validos);
+        }
+        free(col->referencias);
+    }
+    col->valores = NULL;
+    col->validos = NULL;
+    col->referencias = NULL;
+    col->mapa = NULL;
+}
 
-    while ((read = getline(&line, &len, file)) != -1 && fila_actual < numFilas) {
-        verificarNulos(line, fila_actual, df, resultado);
+void liberarDatosColumna(Columna *col) {
+    if (!col)
+        return;
+    liberarArena(col->arena);
+    col->arena = NULL;
+    liberarDiccionario(col->dic);
+    col->dic = NULL;
+    soltarAlmacen(col);
+    col->capacidad = 0;
+    col->estadisticas.validas = 0;
+}
 
-        char *token = strtok(line, ",\n\r");
-        int col = 0;
-        while (token && col < numColumnas) {
-            if (!df->columnas[col].esNulo[fila_actual]) {
-                df->columnas[col].datos[fila_actual] = strdup(token);
-            }
-            token = strtok(NULL, ",\n\r");
-            col++;
-        }
-        fila_actual++;
+// 'destino' pasa a usar los valores, la validez, la arena y el diccionario de
+// 'origen' sin copiarlos. Quien vaya a escribir en una de las dos llama antes
+// a separarColumna (copy-on-write).
+int compartirColumna(Columna *destino, Columna *origen) {
+    if (!destino || !origen)
+        return 0;
+    if (!origen->referencias) {
+        origen->referencias = malloc(sizeof(int));
+        if (!origen->referencias)
+            return 0;
+        *origen->referencias = 1;
     }
+    liberarDatosColumna(destino);
+    *destino = *origen;
+    (*origen->referencias)++;
+    retenerArena(origen->arena);
+    retenerDiccionario(origen->dic);
+    retenerIndice(origen->indice);
+    return 1;
+}
 
-    free(line);
+// Da a la columna una copia propia de sus valores y su validez si los comparte
+// con otra o si están en una instantánea. Las cadenas no se copian: la arena
+// ya es compartible. El índice y las estadísticas de la columna se descartan.
+int separarColumna(Columna *col) {
+    // Quien separa la columna va a escribir en ella: el índice y las
+    // estadísticas dejan de valer
+    liberarIndice(col->indice);
+    col->indice = NULL;
+    col->estadisticas.validas = 0;
+    if (!col->referencias && !col->mapa)
+        return 1;
+    if (!col->mapa && *col->referencias == 1) {
+        free(col->referencias);
+        col->referencias = NULL;
+        return 1;
+    }
+    size_t tamValores = (size_t)col->capacidad * tamanoCelda(col->formato);
+    size_t tamValidos = PALABRAS_BITMAP(col->capacidad) * sizeof(uint64_t);
+    void *valores = malloc(tamValores > 0 ? tamValores : 1);
+    uint64_t *validos = malloc(tamValidos > 0 ? tamValidos : sizeof(uint64_t));
+    if (!valores || !validos) {
+        free(valores);
+        free(validos);
+        return 0;
+    }
+    memcpy(valores, col->valores, tamValores);
+    memcpy(validos, col->validos, tamValidos);
+    soltarAlmacen(col);
+    col->valores = valores;
+    col->validos = validos;
+    return 1;
 }
 
-int crearDF(Dataframe *df, int numColumnas, int numFilas, const char *nombre_df) {
-    if (!df || numColumnas <= 0 || numFilas <= 0 || !nombre_df) {
-        print_error("Invalid parameters");
+// Fija nombre, tipo y formato de una columna recién creada por crearDF,
+// adaptando el espacio reservado al tamaño de celda del nuevo formato.
+int prepararColumna(Columna *col, const char *nombre, TipoDato tipo, Formato formato) {
+    if (!col)
         return 0;
+    if (nombre)
+        copiarNombreColumna(col->nombre, nombre);
+    col->tipo = tipo;
+    if (col->formato != formato) {
+        int64_t capacidad = col->capacidad;
+        if (!separarColumna(col))
+            return 0;
+        free(col->valores);
+        col->valores = calloc((size_t)(capacidad > 0 ? capacidad : 1), tamanoCelda(formato));
+        if (!col->valores) {
+            col->capacidad = 0;
+            return 0;
+        }
+        col->formato = formato;
     }
-    if (numColumnas > MAX_COLUMNS || numFilas > MAX_ROWS) {
-        print_error("Dataset too large");
+    return 1;
+}
+
+int crearDF(Dataframe *df, int numColumnas, int64_t numFilas, const char *nombre_df) {
+    if (!df || numColumnas <= 0 || numFilas < 0 || !nombre_df) {
+        print_error("Invalid parameters");
         return 0;
     }
     df->columnas = malloc(numColumnas * sizeof(Columna));
@@ -311,1461 +678,6529 @@ int crearDF(Dataframe *df, int numColumnas, int numFilas, const char *nombre_df)
     }
     memset(df->columnas, 0, numColumnas * sizeof(Columna));
     for (int i = 0; i < numColumnas; i++) {
-        df->columnas[i].datos = malloc(numFilas * sizeof(char *));
-        df->columnas[i].esNulo = calloc(numFilas, sizeof(EstadoNulo));
-        if (!df->columnas[i].datos || !df->columnas[i].esNulo) {
+        if (!reservarFilasColumna(&df->columnas[i], numFilas)) {
             for (int j = 0; j <= i; j++) {
-                free(df->columnas[j].datos);
-                free(df->columnas[j].esNulo);
+                free(df->columnas[j].valores);
+                free(df->columnas[j].validos);
             }
             free(df->columnas);
             print_error("Memory allocation failed for data");
             return 0;
         }
-        memset(df->columnas[i].datos, 0, numFilas * sizeof(char *));
+        df->columnas[i].numFilas = numFilas;
     }
     df->numColumnas = numColumnas;
     df->numFilas = numFilas;
+    df->padre = NULL;
+    df->filas = NULL;
+    df->plan = NULL;
     strncpy(df->nombre, nombre_df, sizeof(df->nombre) - 1);
     df->nombre[sizeof(df->nombre) - 1] = '\0';
     return 1;
 }
 
-void loadearCSV(const char *nombre_archivo, char sep) {
-    if (!nombre_archivo) {
-        print_error("Nombre de archivo inválido");
-        return;
+double tiempoActual(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int mapearArchivo(const char *nombre_archivo, ArchivoMapeado *am) {
+    if (!nombre_archivo || !am)
+        return 0;
+    am->fd = open(nombre_archivo, O_RDONLY);
+    if (am->fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(am->fd, &st) != 0 || st.st_size == 0) {
+        close(am->fd);
+        return 0;
     }
-    
-    FILE *file = fopen(nombre_archivo, "r");
-    if (!file) {
-        print_error("No se puede abrir el archivo");
-        return;
+    am->tamano = (size_t)st.st_size;
+    void *mapa = mmap(NULL, am->tamano, PROT_READ, MAP_PRIVATE, am->fd, 0);
+    if (mapa == MAP_FAILED) {
+        close(am->fd);
+        return 0;
     }
-    
-    // Leer primera línea para contar columnas
-    char *headerLine = NULL;
-    size_t len = 0;
-    if (getline(&headerLine, &len, file) == -1) {
-        print_error("Error al leer encabezados");
-        free(headerLine);
-        fclose(file);
+    madvise(mapa, am->tamano, MADV_SEQUENTIAL);
+    am->datos = mapa;
+    return 1;
+}
+
+void desmapearArchivo(ArchivoMapeado *am) {
+    if (!am || !am->datos)
         return;
-    }
-    
-    // Contar columnas correctamente
-    int numColumnas = 1;
-    for (char *p = headerLine; *p; ++p) {
-        if (*p == sep) numColumnas++;
-    }
-    
-    if (numColumnas > MAX_COLUMNS) {
-        print_error("Demasiadas columnas");
-        free(headerLine);
-        fclose(file);
-        return;
-    }
-    
-    // Contar filas en el archivo
-    rewind(file);
-    int numFilas = 0;
-    char *tempLine = NULL;
-    size_t tempLen = 0;
-    while (getline(&tempLine, &tempLen, file) != -1) {
-        numFilas++;
-    }
-    free(tempLine);
-    
-    // Ajustar número de filas (restar 1 por el header)
-    numFilas = (numFilas > 0) ? numFilas - 1 : 0;
-    
-    if (numFilas > MAX_ROWS) {
-        print_error("Demasiadas filas");
-        free(headerLine);
-        fclose(file);
-        return;
-    }
-    
-    // Generar nombre único para el nuevo dataframe
-    char nombre_df[51];
-    int intento = 0;
-    do {
-        snprintf(nombre_df, sizeof(nombre_df), "df%d", intento);
-        intento++;
-    } while (!nombreDFUnico(&listaDF, nombre_df));
-    
-    // Crear dataframe con dimensiones correctas
-    Dataframe *nuevo_df = crearNuevoDataframe(numColumnas, numFilas, nombre_df);
-    if (!nuevo_df) {
-        free(headerLine);
-        fclose(file);
-        return;
-    }
-    
-    // Leer encabezados
-    char *token = strtok(headerLine, &sep);
-    int columnaActual = 0;
-    while (token && columnaActual < numColumnas) {
-        // Limpiar espacios y caracteres de nueva línea
-        char *clean_token = token;
-        while (*clean_token == ' ' || *clean_token == '\t' || *clean_token == '\r' || *clean_token == '\n') {
-            clean_token++;
-        }
-        char *end = clean_token + strlen(clean_token) - 1;
-        while (end > clean_token && (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')) {
-            end--;
-        }
-        *(end + 1) = '\0';
-        
-        strncpy(nuevo_df->columnas[columnaActual].nombre, clean_token, 29);
-        nuevo_df->columnas[columnaActual].nombre[29] = '\0';
-        columnaActual++;
-        token = strtok(NULL, &sep);
-    }
-    free(headerLine);
-    
-    // Leer datos
-    rewind(file);
-    // Saltar header
-    char *skipHeader = NULL;
-    size_t skipLen = 0;
-    getline(&skipHeader, &skipLen, file);
-    free(skipHeader);
-    
-    int filaActual = 0;
-    char *linea = NULL;
-    size_t lenLinea = 0;
-    
-    while (getline(&linea, &lenLinea, file) != -1 && filaActual < numFilas) {
-        // Procesar línea con separador correcto
-        char *line_copy = strdup(linea);
-        if (!line_copy) {
-            free(linea);
-            liberarRecursosEnError(nuevo_df, "Error al asignar memoria para línea");
-            fclose(file);
-            return;
-        }
-        
-        // Parsear línea manualmente para manejar campos vacíos
-        int col = 0;
-        char *start = line_copy;
-        char *end = start;
-        
-        while (col < numColumnas && *start) {
-            // Encontrar el final del campo actual
-            end = start;
-            while (*end && *end != sep) {
-                end++;
-            }
-            
-            // Extraer el campo
-            char temp_char = *end;
-            *end = '\0';
-            
-            // Limpiar espacios
-            char *clean_token = start;
-            while (*clean_token == ' ' || *clean_token == '\t' || *clean_token == '\r' || *clean_token == '\n') {
-                clean_token++;
-            }
-            char *clean_end = clean_token + strlen(clean_token) - 1;
-            while (clean_end > clean_token && (*clean_end == ' ' || *clean_end == '\t' || *clean_end == '\r' || *clean_end == '\n')) {
-                clean_end--;
-            }
-            *(clean_end + 1) = '\0';
-            
-            if (strlen(clean_token) > 0) {
-                nuevo_df->columnas[col].datos[filaActual] = strdup(clean_token);
-                nuevo_df->columnas[col].esNulo[filaActual] = NO_NULO;
-            } else {
-                nuevo_df->columnas[col].datos[filaActual] = NULL;
-                nuevo_df->columnas[col].esNulo[filaActual] = NULO;
-            }
-            
-            // Restaurar el carácter original y avanzar
-            *end = temp_char;
-            start = end + 1;
-            col++;
-        }
-        
-        // Rellenar columnas faltantes con NULL
-        while (col < numColumnas) {
-            nuevo_df->columnas[col].datos[filaActual] = NULL;
-            nuevo_df->columnas[col].esNulo[filaActual] = NULO;
-            col++;
-        }
-        
-        free(line_copy);
-        filaActual++;
-    }
-    
-    free(linea);
-    fclose(file);
-    
-    // Ajustar número final de filas
-    nuevo_df->numFilas = filaActual;
-    
-    dfActual = nuevo_df;
-    agregarDF(nuevo_df);
-    listaDF.numDFs++;
-    tiposColumnas(dfActual);
-    actualizarPrompt(dfActual);
-    printf(GREEN "Archivo cargado: %d filas, %d columnas\n" RESET, dfActual->numFilas, dfActual->numColumnas);
+    munmap((void *)am->datos, am->tamano);
+    close(am->fd);
+    am->datos = NULL;
 }
 
-void cortarEspacios(char *str) {
-    size_t longitud = strlen(str);
-    if (longitud > 0 && str[longitud - 1] == '\n') {
-        str[longitud - 1] = '\0';
-    }
+#ifdef USAR_AVX2
+static int tieneAVX2(void) {
+    static int soporte = -1;
+    if (soporte < 0)
+        soporte = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return soporte;
+}
+#endif
+
+// Tokenizador CSV (RFC 4180). El texto se recorre en bloques de 64 bytes:
+// para cada bloque se obtiene una máscara de bits de comillas, separadores y
+// saltos de línea, y con el XOR prefijo de las comillas se sabe qué bytes
+// están dentro de un campo entrecomillado. Los separadores y saltos de línea
+// que quedan fuera son los delimitadores, que se consumen de uno en uno con
+// ctz. Un "" escapado cambia dos veces de estado, así que no altera la máscara.
+typedef struct {
+    const char *bloque;         // Inicio del bloque de 64 bytes actual
+    const char *fin;
+    uint64_t delimitadores;     // Delimitadores del bloque aún no consumidos
+    uint64_t dentro;            // Todo unos si el bloque anterior acabó entre comillas
+    char sep;
+} EscanerCSV;
+
+// Bit i a 1 si b[i] == c, para 8 bytes a la vez (SWAR)
+static inline uint64_t bitsIgualesSWAR(uint64_t palabra, char c) {
+    uint64_t x = palabra ^ (0x0101010101010101ULL * (unsigned char)c);
+    // Byte a 0x80 exactamente donde x tiene un byte nulo
+    uint64_t nulos = ~(((x & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | x | 0x7F7F7F7F7F7F7F7FULL);
+    return ((nulos >> 7) * 0x0102040810204080ULL) >> 56;
+}
 
-    char *inicio = str;
-    while (*inicio == ' ') {
-        inicio++;
+static void mascarasBloqueSWAR(const char *b, char sep, uint64_t *comillas, uint64_t *delim) {
+    uint64_t q = 0, d = 0;
+    for (int i = 0; i < 64; i += 8) {
+        uint64_t palabra;
+        memcpy(&palabra, b + i, sizeof(palabra));
+        q |= bitsIgualesSWAR(palabra, '"') << i;
+        d |= (bitsIgualesSWAR(palabra, sep) | bitsIgualesSWAR(palabra, '\n')) << i;
     }
+    *comillas = q;
+    *delim = d;
+}
 
-    if (inicio != str) {
-        memmove(str, inicio, strlen(inicio) + 1);
-    }
+#ifdef USAR_AVX2
+__attribute__((target("avx2"))) static void mascarasBloqueAVX2(const char *b, char sep,
+                                                                uint64_t *comillas, uint64_t *delim) {
+    const __m256i vComilla = _mm256_set1_epi8('"');
+    const __m256i vSep = _mm256_set1_epi8(sep);
+    const __m256i vSalto = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256((const __m256i *)b);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(b + 32));
+#define MASCARA64(v)                                                                               \
+    ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v)) |                          \
+     (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)) << 32)
+    *comillas = MASCARA64(vComilla);
+    *delim = MASCARA64(vSep) | MASCARA64(vSalto);
+#undef MASCARA64
+}
+#endif
+
+// XOR prefijo: el bit i queda a 1 si hay un número impar de comillas en [0, i]
+static inline uint64_t xorPrefijo(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
 
-    longitud = strlen(str);
-    while (longitud > 0 && str[longitud - 1] == ' ') {
-        str[--longitud] = '\0';
+static void cargarBloqueCSV(EscanerCSV *e) {
+    const char *b = e->bloque;
+    char relleno[64];
+    if (e->fin - b < 64) {
+        // Último bloque: se completa con ceros, que nunca son delimitadores
+        memset(relleno, 0, sizeof(relleno));
+        memcpy(relleno, b, (size_t)(e->fin - b));
+        b = relleno;
     }
+    uint64_t comillas, delim;
+#ifdef USAR_AVX2
+    if (tieneAVX2())
+        mascarasBloqueAVX2(b, e->sep, &comillas, &delim);
+    else
+#endif
+        mascarasBloqueSWAR(b, e->sep, &comillas, &delim);
+    uint64_t dentro = xorPrefijo(comillas) ^ e->dentro;
+    e->delimitadores = delim & ~dentro;
+    e->dentro = (uint64_t)((int64_t)dentro >> 63);
 }
 
-int contarColumnas(const char *line) {
-    int count = 1;
-    for (int i = 0; line[i]; i++) {
-        if (line[i] == ',')
-            count++;
-    }
-    return count;
+// 'p' debe estar fuera de comillas (principio de fila o de archivo)
+static void iniciarEscanerCSV(EscanerCSV *e, const char *p, const char *fin, char sep) {
+    e->bloque = p;
+    e->fin = fin;
+    e->sep = sep;
+    e->dentro = 0;
+    e->delimitadores = 0;
+    if (p < fin)
+        cargarBloqueCSV(e);
 }
 
-int fechaValida(const char *str_fecha) {
-    if (!str_fecha)
-        return 0;
+// Siguiente separador o salto de línea fuera de comillas ('fin' si no hay más)
+static inline const char *siguienteDelimitador(EscanerCSV *e) {
+    while (!e->delimitadores) {
+        e->bloque += 64;
+        if (e->bloque >= e->fin)
+            return e->fin;
+        cargarBloqueCSV(e);
+    }
+    int bit = __builtin_ctzll(e->delimitadores);
+    e->delimitadores &= e->delimitadores - 1;
+    return e->bloque + bit;
+}
 
-    int año, mes, dia;
-    if (sscanf(str_fecha, "%4d-%2d-%2d", &año, &mes, &dia) != 3)
-        return 0;
+// Ajusta [*inicio, *fin) para descartar espacios, tabuladores y saltos de línea
+static void recortarCampo(const char **inicio, const char **fin) {
+    while (*inicio < *fin && (**inicio == ' ' || **inicio == '\t' || **inicio == '\r' || **inicio == '\n'))
+        (*inicio)++;
+    while (*fin > *inicio &&
+           ((*fin)[-1] == ' ' || (*fin)[-1] == '\t' || (*fin)[-1] == '\r' || (*fin)[-1] == '\n'))
+        (*fin)--;
+}
 
-    // Validar rangos básicos
-    if (año < 1900 || mes < 1 || mes > 12 || dia < 1 || dia > 31)
+// Quita los espacios de alrededor y, si el campo va entre comillas, las
+// comillas. Devuelve 1 si dentro quedan comillas escapadas ("") por convertir.
+static int delimitarCampo(const char **inicio, const char **fin) {
+    recortarCampo(inicio, fin);
+    if (*fin - *inicio < 2 || **inicio != '"' || (*fin)[-1] != '"')
         return 0;
+    (*inicio)++;
+    (*fin)--;
+    return memchr(*inicio, '"', (size_t)(*fin - *inicio)) != NULL;
+}
 
-    // Días por mes, incluyendo bisiestos
-    int diasPorMes[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    if ((año % 4 == 0 && año % 100 != 0) || (año % 400 == 0))
-        diasPorMes[1] = 29;
+// Convierte cada "" en " dentro de la cadena
+static void quitarEscapes(char *texto) {
+    char *escritura = texto;
+    for (const char *lectura = texto; *lectura; lectura++) {
+        *escritura++ = *lectura;
+        if (lectura[0] == '"' && lectura[1] == '"')
+            lectura++;
+    }
+    *escritura = '\0';
+}
 
-    return (dia <= diasPorMes[mes - 1]);
+int contarColumnasCSV(const char *p, const char *fin, char sep) {
+    EscanerCSV e;
+    iniciarEscanerCSV(&e, p, fin, sep);
+    int numColumnas = 1;
+    const char *d;
+    while ((d = siguienteDelimitador(&e)) < fin && *d != '\n')
+        numColumnas++;
+    return numColumnas;
 }
 
-void tiposColumnas(Dataframe *df) {
-    if (!df)
-        return;
+const char *leerEncabezadoCSV(const char *p, const char *fin, char sep, Dataframe *df) {
+    EscanerCSV e;
+    iniciarEscanerCSV(&e, p, fin, sep);
+    int col = 0;
+    const char *d = p;
+    while (p < fin) {
+        d = siguienteDelimitador(&e);
+        if (col < df->numColumnas) {
+            const char *inicio = p, *final = d;
+            delimitarCampo(&inicio, &final);
+            size_t len = (size_t)(final - inicio);
+            if (len > MAX_NOMBRE_COLUMNA - 1)
+                len = MAX_NOMBRE_COLUMNA - 1;
+            memcpy(df->columnas[col].nombre, inicio, len);
+            df->columnas[col].nombre[len] = '\0';
+            col++;
+        }
+        p = d < fin ? d + 1 : fin;
+        if (d >= fin || *d == '\n')
+            break;
+    }
+    return p;
+}
 
-    for (int col = 0; col < df->numColumnas; col++) {
-        int esFecha = 1;
-        for (int fila = 0; fila < df->numFilas; fila++) {
-            if (df->columnas[col].esNulo[fila])
-                continue;
-            char *valor = df->columnas[col].datos[fila];
-            if (!valor || !fechaValida(valor)) {
-                esFecha = 0;
-                break;
+// Lee una fila a partir de *p (que avanza hasta la siguiente) en la fila
+// 'fila' de df. Los campos de más se descartan y los que faltan son nulos.
+static int parsearFilaCSV(EscanerCSV *e, const char **p, Dataframe *df, int64_t fila) {
+    int col = 0;
+    const char *d;
+    do {
+        d = siguienteDelimitador(e);
+        if (col < df->numColumnas) {
+            Columna *c = &df->columnas[col];
+            const char *inicio = *p, *final = d;
+            int escapes = delimitarCampo(&inicio, &final);
+            if (final > inicio) {
+                char *valor = guardarTextoColumna(c, inicio, (size_t)(final - inicio));
+                if (!valor)
+                    return 0;
+                if (escapes)
+                    quitarEscapes(valor);
+                c->datos[fila] = valor;
+                MARCAR_VALIDO(c, fila);
+            } else {
+                c->datos[fila] = NULL;
+                MARCAR_NULO(c, fila);
             }
         }
-        df->columnas[col].tipo = esFecha ? FECHA : TEXTO;
+        col++;
+        *p = d < e->fin ? d + 1 : e->fin;
+    } while (d < e->fin && *d != '\n');
+
+    for (; col < df->numColumnas; col++) {
+        df->columnas[col].datos[fila] = NULL;
+        MARCAR_NULO(&df->columnas[col], fila);
     }
+    return 1;
 }
 
-int compararValores(void *a, void *b, TipoDato tipo, int esta_desc) {
-    if (a == NULL && b == NULL)
-        return 0;
-    if (a == NULL)
-        return esta_desc ? 1 : -1;
-    if (b == NULL)
-        return esta_desc ? -1 : 1;
+int64_t parsearFilasCSV(const char *p, const char *fin, char sep, Dataframe *df) {
+    int64_t fila = df->numFilas;
+    EscanerCSV e;
+    iniciarEscanerCSV(&e, p, fin, sep);
+
+    while (p < fin) {
+        if (fila >= df->columnas[0].capacidad && !reservarFilas(df, fila + 1))
+            return -1;
+        if (!parsearFilaCSV(&e, &p, df, fila))
+            return -1;
+        fila++;
+        df->numFilas = fila;
+    }
+
+    for (int c = 0; c < df->numColumnas; c++)
+        df->columnas[c].numFilas = fila;
+    return fila;
+}
 
-    char *str_a = (char *)a;
-    char *str_b = (char *)b;
+// Tramo de un CSV que parsea un hilo: siempre empieza al principio de una fila
+typedef struct {
+    const char *inicio, *fin;
+    char sep;
+    Dataframe *parcial;         // Columnas propias del tramo
+    int64_t comillas;           // Comillas en [inicio, fin) (para alinear tramos)
+    int64_t filas;              // Filas leídas; -1 si faltó memoria
+} TramoCSV;
+
+static void *hiloContarComillas(void *arg) {
+    TramoCSV *tramo = arg;
+    int64_t n = 0;
+    for (const char *q = tramo->inicio; (q = memchr(q, '"', (size_t)(tramo->fin - q))); q++)
+        n++;
+    tramo->comillas = n;
+    return NULL;
+}
 
-    switch (tipo) {
-    case NUMERICO: {
-        double num_a = atof(str_a);
-        double num_b = atof(str_b);
-        return esta_desc ? (num_a < num_b ? 1 : (num_a > num_b ? -1 : 0))
-                         : (num_a < num_b ? -1 : (num_a > num_b ? 1 : 0));
-    }
-    case FECHA: {
-        struct tm tm_a = {0}, tm_b = {0};
-        sscanf(str_a, "%4d-%2d-%2d", &tm_a.tm_year, &tm_a.tm_mon, &tm_a.tm_mday);
-        sscanf(str_b, "%4d-%2d-%2d", &tm_b.tm_year, &tm_b.tm_mon, &tm_b.tm_mday);
-        tm_a.tm_year -= 1900;
-        tm_b.tm_year -= 1900;
-        tm_a.tm_mon -= 1;
-        tm_b.tm_mon -= 1;
+static void *hiloParsearTramo(void *arg) {
+    TramoCSV *tramo = arg;
+    tramo->filas = parsearFilasCSV(tramo->inicio, tramo->fin, tramo->sep, tramo->parcial);
+    return NULL;
+}
 
-        time_t time_a = mktime(&tm_a);
-        time_t time_b = mktime(&tm_b);
+// Añade al final de df las filas de un tramo. Solo se copian los punteros y
+// la validez: los bloques de arena del tramo pasan a la columna de df.
+static int unirTramoCSV(Dataframe *df, Dataframe *parcial) {
+    int64_t base = df->numFilas, filas = parcial->numFilas;
+    if (!reservarFilas(df, base + filas))
+        return 0;
+    for (int c = 0; c < df->numColumnas; c++) {
+        Columna *destino = &df->columnas[c], *origen = &parcial->columnas[c];
+        memcpy(destino->datos + base, origen->datos, (size_t)filas * sizeof(char *));
+        copiarValidos(destino, base, origen, filas);
+        if (!destino->arena) {
+            destino->arena = origen->arena;
+            origen->arena = NULL;
+        } else if (origen->arena) {
+            traspasarArena(destino->arena, origen->arena);
+        }
+        destino->numFilas = base + filas;
+    }
+    df->numFilas = base + filas;
+    return 1;
+}
 
-        return esta_desc ? (time_a < time_b ? 1 : (time_a > time_b ? -1 : 0))
-                         : (time_a < time_b ? -1 : (time_a > time_b ? 1 : 0));
+// Como parsearFilasCSV pero repartiendo el texto entre varios hilos. Los
+// cortes se hacen en saltos de línea que no estén entre comillas: primero se
+// cuentan las comillas de cada tramo en paralelo para saber si un tramo empieza
+// dentro de un campo entrecomillado. Cada hilo parsea su tramo en columnas
+// propias y al final se unen en orden.
+int64_t parsearFilasCSVParalelo(const char *p, const char *fin, char sep, Dataframe *df) {
+    int numHilos = numeroHilos();
+    if ((fin - p) / MIN_BYTES_HILO_CSV < numHilos)
+        numHilos = (int)((fin - p) / MIN_BYTES_HILO_CSV);
+    if (numHilos <= 1)
+        return parsearFilasCSV(p, fin, sep, df);
+
+    TramoCSV tramos[MAX_HILOS];
+    for (int t = 0; t < numHilos; t++) {
+        tramos[t].inicio = p + (fin - p) * t / numHilos;
+        tramos[t].fin = p + (fin - p) * (t + 1) / numHilos;
     }
-    case TEXTO: {
-        return esta_desc ? strcmp(str_b, str_a) : strcmp(str_a, str_b);
+    ejecutarEnHilos(hiloContarComillas, tramos, sizeof(TramoCSV), numHilos);
+
+    // Mover cada corte al primer salto de línea fuera de comillas
+    int64_t comillasPrevias = 0;
+    const char *corte = p;
+    for (int t = 0; t < numHilos; t++) {
+        const char *nominal = tramos[t].inicio;
+        if (t > 0) {
+            int dentro = comillasPrevias & 1;
+            const char *q = nominal;
+            while (q < fin && (*q != '\n' || dentro)) {
+                dentro ^= *q == '"';
+                q++;
+            }
+            corte = q < fin ? q + 1 : fin;
+            if (corte < tramos[t - 1].inicio)
+                corte = tramos[t - 1].inicio;
+            tramos[t - 1].fin = corte;
+        }
+        comillasPrevias += tramos[t].comillas;
+        tramos[t].inicio = corte;
+        tramos[t].sep = sep;
+        tramos[t].parcial = t == 0 ? df : NULL;
+        tramos[t].filas = 0;
     }
-    default:
-        return 0;
+    tramos[numHilos - 1].fin = fin;
+
+    int ok = 1;
+    for (int t = 1; t < numHilos && ok; t++)
+        ok = (tramos[t].parcial = crearNuevoDataframe(df->numColumnas, 0, df->nombre)) != NULL;
+    if (ok)
+        ejecutarEnHilos(hiloParsearTramo, tramos, sizeof(TramoCSV), numHilos);
+    for (int t = 0; t < numHilos && ok; t++)
+        ok = tramos[t].filas >= 0 && (t == 0 || unirTramoCSV(df, tramos[t].parcial));
+    for (int t = 1; t < numHilos; t++) {
+        if (tramos[t].parcial)
+            liberarMemoriaDF(tramos[t].parcial);
     }
+    return ok ? df->numFilas : -1;
 }
 
-void print_error(const char *mensaje_error) {
-    fprintf(stderr, RED "ERROR: %s\n" RESET, mensaje_error);
+void loadearCSV(const char *nombre_archivo, char sep) {
+    if (!nombre_archivo) {
+        print_error("Nombre de archivo inválido");
+        return;
+    }
+
+    double inicio = tiempoActual();
+    ArchivoMapeado archivo;
+    if (!mapearArchivo(nombre_archivo, &archivo)) {
+        print_error("No se puede abrir el archivo");
+        return;
+    }
+    const char *p = archivo.datos;
+    const char *fin = archivo.datos + archivo.tamano;
+
+    // Contar columnas en la primera línea
+    int numColumnas = contarColumnasCSV(p, fin, sep);
+
+    // Generar nombre único para el nuevo dataframe
+    char nombre_df[51];
+    nombreLibreDF(nombre_df, sizeof(nombre_df));
+
+    // Crear dataframe vacío; las columnas crecen a medida que se leen filas
+    Dataframe *nuevo_df = crearNuevoDataframe(numColumnas, 0, nombre_df);
+    if (!nuevo_df) {
+        desmapearArchivo(&archivo);
+        return;
+    }
+
+    p = leerEncabezadoCSV(p, fin, sep, nuevo_df);
+    if (parsearFilasCSVParalelo(p, fin, sep, nuevo_df) < 0) {
+        desmapearArchivo(&archivo);
+        liberarRecursosEnError(nuevo_df, "Error al asignar memoria para filas");
+        return;
+    }
+    desmapearArchivo(&archivo);
+
+    dfActual = nuevo_df;
+    agregarDF(nuevo_df);
+    listaDF.numDFs++;
+    tiposColumnas(dfActual);
+    calcularEstadisticasDF(dfActual);
+    actualizarPrompt(dfActual);
+
+    double segundos = tiempoActual() - inicio;
+    double megas = (double)archivo.tamano / (1024.0 * 1024.0);
+    printf(GREEN "Archivo cargado: %" PRId64 " filas, %d columnas (%.1f MB en %.3f s, %.1f MB/s)\n" RESET,
+           dfActual->numFilas, dfActual->numColumnas, megas, segundos,
+           segundos > 0 ? megas / segundos : 0.0);
 }
 
-void inicializarLista() {
-    listaDF.numDFs = 0;
-    listaDF.primero = NULL;
+// Instantáneas binarias (.dfb). Un archivo guarda un dataframe por columnas
+// tal como está en memoria, en el orden de bytes de la máquina:
+//
+//   CabeceraDFB | DescriptorDFB x numColumnas | secciones
+//
+// Cada sección empieza en un múltiplo de ALINEACION_DFB para que los arrays
+// puedan usarse directamente desde el mapa. Por columna hay un array de
+// valores (en FMT_TEXTO, el desplazamiento de cada cadena), el bitmap de
+// validez, en texto y categorías las cadenas terminadas en '\0' y los
+// desplazamientos del diccionario, y por último sus estadísticas.
+#define MAGIA_DFB "DFB\x1a"
+#define VERSION_DFB 2            // La versión 1 no guardaba estadísticas
+#define ALINEACION_DFB 64
+#define SIN_CADENA_DFB UINT64_MAX   // Celda de texto sin cadena
+
+typedef struct {
+    char magia[4];
+    uint32_t version;
+    uint32_t numColumnas;
+    uint32_t reservado;
+    int64_t numFilas;
+    uint64_t relleno[5];
+} CabeceraDFB;
+
+typedef struct {
+    char nombre[32];
+    int32_t tipo;
+    int32_t formato;
+    uint64_t valores;           // Desplazamiento del array de valores
+    uint64_t validos;           // Desplazamiento del bitmap de validez
+    uint64_t cadenas;           // Desplazamiento de las cadenas (texto y diccionario)
+    uint64_t tamCadenas;        // Bytes de cadenas
+    uint64_t diccionario;       // Desplazamiento de las cadenas del diccionario
+    int64_t numValores;         // Valores del diccionario
+    int64_t nulos;              // Estadísticas: filas nulas
+    uint64_t reservado[2];      // Versión 1: mínimo y máximo como double (ya no se usan)
+    uint64_t estadisticas;      // Desplazamiento de EstadisticasDFB (0: instantánea sin ellas)
+    uint64_t relleno;
+} DescriptorDFB;
+
+// Estadísticas guardadas de una columna. En FMT_TEXTO 'minimo' y 'maximo' son
+// las longitudes de las dos cadenas, que van detrás terminadas en '\0'.
+typedef struct {
+    int32_t exactas, ordenada, hayValores, reservado;
+    int64_t nulos;
+    int64_t minimo, maximo;     // Bits del valor (ValorEstadistica)
+    uint8_t registros[REGISTROS_HLL];
+} EstadisticasDFB;
+
+int esArchivoDFB(const char *nombre_archivo) {
+    size_t len = nombre_archivo ? strlen(nombre_archivo) : 0;
+    return len > 4 && strcmp(nombre_archivo + len - 4, ".dfb") == 0;
 }
 
-void cambiarDF(Lista *lista, int indice) {
-    (void)lista;  // Suppress unused parameter warning
-    (void)indice; // Suppress unused parameter warning
-    print_error("Este comando ha sido reemplazado. Use el nombre del dataframe.");
+MapaInstantanea *retenerMapa(MapaInstantanea *mapa) {
+    if (mapa)
+        mapa->referencias++;
+    return mapa;
 }
 
-int encontrarIndiceColumna(Dataframe *df, const char *nombreColumna) {
-    for (int i = 0; i < df->numColumnas; i++) {
-        if (strcmp(df->columnas[i].nombre, nombreColumna) == 0) {
-            return i;
-        }
-    }
-    return -1;
+void liberarMapa(MapaInstantanea *mapa) {
+    if (!mapa || --mapa->referencias > 0)
+        return;
+    munmap(mapa->datos, mapa->tamano);
+    free(mapa);
 }
 
-void intercambiarFilas(Dataframe *df, int fila1, int fila2) {
-    for (int col = 0; col < df->numColumnas; col++) {
-        void *temp_datos = df->columnas[col].datos[fila1];
-        df->columnas[col].datos[fila1] = df->columnas[col].datos[fila2];
-        df->columnas[col].datos[fila2] = temp_datos;
+static uint64_t alinearDFB(uint64_t pos) {
+    return (pos + ALINEACION_DFB - 1) & ~(uint64_t)(ALINEACION_DFB - 1);
+}
 
-        int temp_nulo = df->columnas[col].esNulo[fila1];
-        df->columnas[col].esNulo[fila1] = df->columnas[col].esNulo[fila2];
-        df->columnas[col].esNulo[fila2] = temp_nulo;
+// Escribe 'tam' bytes en 'pos', rellenando con ceros desde la posición actual
+static int escribirSeccionDFB(FILE *f, uint64_t *actual, uint64_t pos, const void *datos, size_t tam) {
+    static const char ceros[ALINEACION_DFB];
+    while (*actual < pos) {
+        size_t hueco = pos - *actual < sizeof(ceros) ? (size_t)(pos - *actual) : sizeof(ceros);
+        if (fwrite(ceros, 1, hueco, f) != hueco)
+            return 0;
+        *actual += hueco;
     }
+    if (tam > 0 && fwrite(datos, 1, tam, f) != tam)
+        return 0;
+    *actual += tam;
+    return 1;
 }
 
-void ordenarDataframe(Dataframe *df, int indice_columna, int descendente) {
-    TipoDato tipo_columna = df->columnas[indice_columna].tipo;
+// Cadenas de una columna: las celdas en FMT_TEXTO o los valores del diccionario
+static int64_t numCadenasDFB(const Columna *col, int64_t numFilas) {
+    if (col->formato == FMT_TEXTO)
+        return numFilas;
+    return ES_CATEGORIA(col->formato) ? col->dic->numValores : 0;
+}
 
-    for (int i = 0; i < df->numFilas - 1; i++) {
-        for (int j = 0; j < df->numFilas - i - 1; j++) {
-            void *val1 = df->columnas[indice_columna].datos[j];
-            void *val2 = df->columnas[indice_columna].datos[j + 1];
+static const char *cadenaDFB(const Columna *col, int64_t i) {
+    if (col->formato == FMT_TEXTO)
+        return ES_NULO(col, i) ? NULL : col->datos[i];
+    return col->dic->valores[i];
+}
 
-            if (compararValores(val1, val2, tipo_columna, descendente) > 0) {
-                intercambiarFilas(df, j, j + 1);
-            }
+// Escribe los desplazamientos de las cadenas de la columna en bloques
+static int escribirDesplazamientosDFB(FILE *f, uint64_t *actual, uint64_t pos, const Columna *col,
+                                      int64_t n) {
+    uint64_t bloque[1024];
+    uint64_t desplazamiento = 0;
+    if (!escribirSeccionDFB(f, actual, pos, NULL, 0))
+        return 0;
+    for (int64_t i = 0; i < n;) {
+        int k = 0;
+        for (; k < 1024 && i < n; k++, i++) {
+            const char *s = cadenaDFB(col, i);
+            bloque[k] = s ? desplazamiento : SIN_CADENA_DFB;
+            if (s)
+                desplazamiento += strlen(s) + 1;
         }
+        if (!escribirSeccionDFB(f, actual, *actual, bloque, (size_t)k * sizeof(uint64_t)))
+            return 0;
     }
+    return 1;
 }
 
-void verificarNulos(char *lineaLeida, int fila, Dataframe *df, char *resultado) {
-    cortarEspacios(lineaLeida);
-    int j = 0;
-    int longitud = strlen(lineaLeida);
-    int inicio_campo = 0;
-    int indice_columna = 0;
-
-    for (int i = 0; i <= longitud; i++) {
-        if (i == longitud || lineaLeida[i] == ',' || lineaLeida[i] == '\r') {
-            // Verificar si el campo está vacío o solo tiene espacios
-            int esNulo = 1;
-            for (int k = inicio_campo; k < i; k++) {
-                if (lineaLeida[k] != ' ' && lineaLeida[k] != '\t') {
-                    esNulo = 0;
-                    break;
-                }
-            }
-
-            if (esNulo && indice_columna < df->numColumnas) {
-                df->columnas[indice_columna].esNulo[fila] = 1;
-                resultado[j++] = '1'; // Opcional para depuración
-            } else {
-                // Copiar el campo original
-                for (int k = inicio_campo; k < i; k++) {
-                    resultado[j++] = lineaLeida[k];
-                }
-            }
+static int escribirCadenasDFB(FILE *f, uint64_t *actual, uint64_t pos, const Columna *col, int64_t n) {
+    if (!escribirSeccionDFB(f, actual, pos, NULL, 0))
+        return 0;
+    for (int64_t i = 0; i < n; i++) {
+        const char *s = cadenaDFB(col, i);
+        if (s && !escribirSeccionDFB(f, actual, *actual, s, strlen(s) + 1))
+            return 0;
+    }
+    return 1;
+}
 
-            if (i < longitud)
-                resultado[j++] = lineaLeida[i];
+// Rellena el descriptor de una columna: nombre, formato, nulos y los
+// desplazamientos de sus secciones a partir de *pos
+static void describirColumnaDFB(DescriptorDFB *d, const Columna *col, const EstadisticasColumna *est,
+                                int64_t n, uint64_t *pos) {
+    memset(d, 0, sizeof(*d));
+    memcpy(d->nombre, col->nombre, sizeof(col->nombre));
+    d->tipo = col->tipo;
+    d->formato = col->formato;
+    d->nulos = est->nulos;
+
+    int64_t numCadenas = numCadenasDFB(col, n);
+    for (int64_t i = 0; i < numCadenas; i++) {
+        const char *s = cadenaDFB(col, i);
+        if (s)
+            d->tamCadenas += strlen(s) + 1;
+    }
+    size_t tamValor = col->formato == FMT_TEXTO ? sizeof(uint64_t) : tamanoCelda(col->formato);
+    d->valores = *pos = alinearDFB(*pos);
+    *pos += (uint64_t)n * tamValor;
+    d->validos = *pos = alinearDFB(*pos);
+    *pos += PALABRAS_BITMAP(n) * sizeof(uint64_t);
+    if (ES_CATEGORIA(col->formato)) {
+        d->numValores = numCadenas;
+        d->diccionario = *pos = alinearDFB(*pos);
+        *pos += (uint64_t)numCadenas * sizeof(uint64_t);
+    }
+    if (numCadenas > 0) {
+        d->cadenas = *pos = alinearDFB(*pos);
+        *pos += d->tamCadenas;
+    }
+    d->estadisticas = *pos = alinearDFB(*pos);
+    *pos += sizeof(EstadisticasDFB);
+    if (col->formato == FMT_TEXTO && est->hayValores)
+        *pos += strlen(est->minimo.s) + strlen(est->maximo.s) + 2;
+}
 
-            inicio_campo = i + 1;
-            indice_columna++;
-        }
+static int escribirEstadisticasDFB(FILE *f, uint64_t *actual, uint64_t pos, const Columna *col,
+                                   const EstadisticasColumna *est) {
+    EstadisticasDFB e;
+    memset(&e, 0, sizeof(e));
+    e.exactas = est->exactas;
+    e.ordenada = est->ordenada;
+    e.hayValores = est->hayValores;
+    e.nulos = est->nulos;
+    memcpy(&e.minimo, &est->minimo, sizeof(e.minimo));
+    memcpy(&e.maximo, &est->maximo, sizeof(e.maximo));
+    memcpy(e.registros, est->registros, sizeof(e.registros));
+    int texto = col->formato == FMT_TEXTO && est->hayValores;
+    if (texto) {
+        e.minimo = (int64_t)strlen(est->minimo.s);
+        e.maximo = (int64_t)strlen(est->maximo.s);
     }
-    resultado[j] = '\0';
+    return escribirSeccionDFB(f, actual, pos, &e, sizeof(e)) &&
+           (!texto || (escribirSeccionDFB(f, actual, *actual, est->minimo.s, (size_t)e.minimo + 1) &&
+                       escribirSeccionDFB(f, actual, *actual, est->maximo.s, (size_t)e.maximo + 1)));
 }
 
-void CLI() {
-    char input[MAX_LINE_LENGTH];
+static int escribirColumnaDFB(FILE *f, uint64_t *actual, const DescriptorDFB *d, const Columna *col,
+                              const EstadisticasColumna *est, int64_t n) {
+    int ok;
+    if (col->formato == FMT_TEXTO)
+        ok = escribirDesplazamientosDFB(f, actual, d->valores, col, n);
+    else
+        ok = escribirSeccionDFB(f, actual, d->valores, col->valores, (size_t)n * tamanoCelda(col->formato));
+
+    // Los bits sin usar de la última palabra se guardan a 1, como en memoria
+    size_t palabras = PALABRAS_BITMAP(n);
+    if (ok && palabras > 0) {
+        uint64_t ultima = col->validos[palabras - 1];
+        if (n & 63)
+            ultima |= ~UINT64_C(0) << (n & 63);
+        ok = escribirSeccionDFB(f, actual, d->validos, col->validos, (palabras - 1) * sizeof(uint64_t)) &&
+             escribirSeccionDFB(f, actual, *actual, &ultima, sizeof(ultima));
+    }
+    if (ok && ES_CATEGORIA(col->formato))
+        ok = escribirDesplazamientosDFB(f, actual, d->diccionario, col, d->numValores);
+    if (ok && d->cadenas)
+        ok = escribirCadenasDFB(f, actual, d->cadenas, col, numCadenasDFB(col, n));
+    return ok && escribirEstadisticasDFB(f, actual, d->estadisticas, col, est);
+}
 
-    while (1) {
-        printf("%s", promptTerminal);
-        fgets(input, sizeof(input), stdin);
-        cortarEspacios(input);
+// Guarda el dataframe (que no puede ser una vista) como instantánea .dfb
+int guardarDFB(const Dataframe *df, const char *nombre_archivo) {
+    if (!df || df->filas) {
+        print_error("No se puede guardar una vista como instantánea");
+        return 0;
+    }
+    DescriptorDFB *descriptores = calloc((size_t)df->numColumnas, sizeof(DescriptorDFB));
+    EstadisticasColumna *estadisticas = malloc((size_t)df->numColumnas * sizeof(EstadisticasColumna));
+    if (!descriptores || !estadisticas) {
+        free(descriptores);
+        free(estadisticas);
+        print_error("Error al asignar memoria para la instantánea");
+        return 0;
+    }
+    CabeceraDFB cabecera = {0};
+    memcpy(cabecera.magia, MAGIA_DFB, sizeof(cabecera.magia));
+    cabecera.version = VERSION_DFB;
+    cabecera.numColumnas = (uint32_t)df->numColumnas;
+    cabecera.numFilas = df->numFilas;
+
+    uint64_t pos = sizeof(CabeceraDFB) + (uint64_t)df->numColumnas * sizeof(DescriptorDFB);
+    for (int c = 0; c < df->numColumnas; c++) {
+        estadisticas[c] = df->columnas[c].estadisticas;
+        if (!estadisticas[c].validas)
+            calcularEstadisticasColumna(&df->columnas[c], NULL, df->numFilas, &estadisticas[c]);
+        describirColumnaDFB(&descriptores[c], &df->columnas[c], &estadisticas[c], df->numFilas, &pos);
+    }
 
-        if (strcmp(input, "quit") == 0) {
-            printf(GREEN "Fin...\n" RESET);
-            break;
-        } else if (strncmp(input, "load ", 5) == 0) {
-            char archivo[256] = {0};
-            char sep = ',';
-            int parsed = sscanf(input + 5, "%255s %c", archivo, &sep);
-            if (parsed == 1) {
-                loadearCSV(archivo, ',');
-            } else if (parsed == 2) {
-                if (archivo[0] == '\0' || sep == '\0' || input[5 + strlen(archivo) + 1 + 1] != '\0') {
-                    print_error("Uso: load <nombre_fichero> [<sep>]");
-                    continue;
-                }
-                loadearCSV(archivo, sep);
-            } else {
-                print_error("Uso: load <nombre_fichero> [<sep>]");
-            }
-        } else if (strncmp(input, "add ", 4) == 0) {
-            char archivo[256] = {0};
-            char sep = ',';
-            int parsed = sscanf(input + 4, "%255s %c", archivo, &sep);
-            if (parsed == 1) {
-                addCLI(archivo, ',');
-            } else if (parsed == 2) {
-                if (archivo[0] == '\0' || sep == '\0' || input[4 + strlen(archivo) + 1 + 1] != '\0') {
-                    print_error("Uso: add <nombre_fichero> [<sep>]");
-                    continue;
-                }
-                addCLI(archivo, sep);
-            } else {
-                print_error("Uso: add <nombre_fichero> [<sep>]");
-            }
-        } else if (strcmp(input, "meta") == 0) {
-            metaCLI();
-        } else if (strncmp(input, "save", 4) == 0) {
-            // Saltar espacios después de 'save'
-            const char *nombre_archivo = input + 4;
-            while (*nombre_archivo == ' ') nombre_archivo++;
-            if (*nombre_archivo == '\0') {
-                saveCLI(NULL);
-            } else {
-                saveCLI(nombre_archivo);
-            }
-        } else if (strncmp(input, "view", 4) == 0) {
-            int n = 10;
-            if (strlen(input) > 4) {
-                char *endptr;
-                long parsed_n = strtol(input + 4, &endptr, 10);
-                if (endptr != input + 4 && parsed_n != 0) {
-                    viewCLI((int)parsed_n);
-                } else {
-                    print_error("Número de filas no válido");
-                    continue;
-                }
-            } else {
-                viewCLI(n);
-            }
-        }
+    FILE *f = fopen(nombre_archivo, "wb");
+    if (!f) {
+        char error_msg[MAX_FILENAME + 50];
+        snprintf(error_msg, sizeof(error_msg), "No se puede crear el archivo: %s", nombre_archivo);
+        print_error(error_msg);
+        free(descriptores);
+        free(estadisticas);
+        return 0;
+    }
+    uint64_t actual = 0;
+    int ok = escribirSeccionDFB(f, &actual, 0, &cabecera, sizeof(cabecera)) &&
+             escribirSeccionDFB(f, &actual, actual, descriptores,
+                                (size_t)df->numColumnas * sizeof(DescriptorDFB));
+    for (int c = 0; ok && c < df->numColumnas; c++)
+        ok = escribirColumnaDFB(f, &actual, &descriptores[c], &df->columnas[c], &estadisticas[c],
+                                df->numFilas);
+    ok = fclose(f) == 0 && ok;
+    free(descriptores);
+    free(estadisticas);
+    if (!ok) {
+        remove(nombre_archivo);
+        print_error("Error al escribir la instantánea");
+    }
+    return ok;
+}
 
-        else if (strncmp(input, "sort ", 5) == 0) {
-            char nombreColumna[50];
-            char order[10] = "asc";
-            int esta_desc = 0;
+// Comprueba que [desplazamiento, desplazamiento + tam) cae dentro del mapa
+static int seccionValidaDFB(const MapaInstantanea *mapa, uint64_t desplazamiento, uint64_t tam) {
+    return desplazamiento % sizeof(uint64_t) == 0 && desplazamiento <= mapa->tamano &&
+           tam <= mapa->tamano - desplazamiento;
+}
 
-            int parsed = sscanf(input + 5, "%49s %9s", nombreColumna, order);
-            if (parsed == 0) {
-                print_error("Comando de ordenamiento inválido");
-                continue;
-            }
+// Convierte desplazamientos de cadenas en punteros dentro del mapa
+static int punterosCadenasDFB(char **destino, const uint64_t *desplazamientos, int64_t n,
+                              const char *cadenas, uint64_t tamCadenas) {
+    for (int64_t i = 0; i < n; i++) {
+        uint64_t d = desplazamientos[i];
+        if (d == SIN_CADENA_DFB)
+            destino[i] = NULL;
+        else if (d < tamCadenas)
+            destino[i] = (char *)cadenas + d;
+        else
+            return 0;
+    }
+    return 1;
+}
 
-            if (parsed == 2) {
-                if (strcmp(order, "asc") == 0) {
-                    esta_desc = 0;
-                } else if (strcmp(order, "des") == 0) {
-                    esta_desc = 1;
-                } else {
-                    print_error("Orden de clasificación inválido. Usar 'asc' o 'des'.");
-                    continue;
-                }
-            }
-            sortCLI(nombreColumna, esta_desc);
-        } else if (strncmp(input, "delnull ", 8) == 0) {
-            delnullCLI(input + 8);
-        } else if (strncmp(input, "delcolum ", 9) == 0) {
-            const char *nombreColumna = input + 9;
-            while (*nombreColumna == ' ')
-                nombreColumna++;
-            delcolumCLI(nombreColumna);
-        } else if (strncmp(input, "df", 2) == 0 && strlen(input) > 2) {
-            char *endptr;
-            long indice = strtol(input + 2, &endptr, 10);
-            if (*endptr == '\0' && indice >= 0 && indice < listaDF.numDFs) {
-                // Buscar el dataframe por índice en la lista
-                Nodo *nodoActual = listaDF.primero;
-                for (int i = 0; i < indice && nodoActual != NULL; i++) {
-                    nodoActual = nodoActual->siguiente;
-                }
-                if (nodoActual == NULL || nodoActual->df == NULL) {
-                    print_error("Dataframe no encontrado.");
-                    continue;
-                }
-                dfActual = nodoActual->df;
-                actualizarPrompt(dfActual);
-                const char *nombre_df = (dfActual->nombre[0] != '\0') ? dfActual->nombre : dfActual->indice;
-                printf(GREEN "Cambiado a %s con %d filas y %d columnas\n" RESET, nombre_df, dfActual->numFilas, dfActual->numColumnas);
-            } else {
-                print_error("Índice de dataframe inválido.");
-            }
-        } else if (strncmp(input, "filter ", 7) == 0) {
-            char columna[50], operador[10], valor[50];
+// Arena sin bloques propios cuyas cadenas viven en el mapa
+static ArenaTexto *arenaDeMapa(MapaInstantanea *mapa) {
+    ArenaTexto *arena = crearArena();
+    if (arena)
+        arena->mapa = retenerMapa(mapa);
+    return arena;
+}
 
-            int parsed = sscanf(input + 7, "%49s %9s %49s", columna, operador, valor);
-            if (parsed != 3) {
-                print_error("Uso: filter [columna] [eq|neq|gt|lt] [valor]");
-                continue;
-            }
+// Enlaza una columna vacía con su sección de la instantánea. Los números,
+// fechas, códigos y la validez se usan en sitio; el texto necesita un array
+// de punteros, pero las cadenas siguen en el mapa.
+static int abrirColumnaDFB(Columna *col, const DescriptorDFB *d, int64_t n, MapaInstantanea *mapa) {
+    const char *base = mapa->datos;
+    if (d->tipo < TEXTO || d->tipo > FECHA || d->formato < FMT_TEXTO || d->formato > FMT_CATEGORIA16)
+        return 0;
+    Formato formato = (Formato)d->formato;
+    size_t tamValor = formato == FMT_TEXTO ? sizeof(uint64_t) : tamanoCelda(formato);
+    uint64_t palabras = PALABRAS_BITMAP(n);
+    int conCadenas = formato == FMT_TEXTO || ES_CATEGORIA(formato);
+    if (!seccionValidaDFB(mapa, d->valores, (uint64_t)n * tamValor) ||
+        !seccionValidaDFB(mapa, d->validos, palabras * sizeof(uint64_t)))
+        return 0;
+    if (conCadenas && d->tamCadenas > 0 &&
+        (!seccionValidaDFB(mapa, d->cadenas, d->tamCadenas) || base[d->cadenas + d->tamCadenas - 1] != '\0'))
+        return 0;
 
-            if (!dfActual) {
-                print_error("No hay dataframe activo");
-                continue;
-            }
+    liberarDatosColumna(col);
+    copiarNombreColumna(col->nombre, d->nombre);
+    col->tipo = (TipoDato)d->tipo;
+    col->formato = formato;
+    col->numFilas = col->capacidad = n;
+
+    if (formato == FMT_TEXTO) {
+        col->datos = malloc((size_t)(n > 0 ? n : 1) * sizeof(char *));
+        col->validos = malloc((size_t)(palabras > 0 ? palabras : 1) * sizeof(uint64_t));
+        col->arena = arenaDeMapa(mapa);
+        if (!col->datos || !col->validos || !col->arena)
+            return 0;
+        memcpy(col->validos, base + d->validos, palabras * sizeof(uint64_t));
+        return punterosCadenasDFB(col->datos, (const uint64_t *)(base + d->valores), n,
+                                  base + d->cadenas, d->tamCadenas);
+    }
 
-            int col_idx = -1;
-            for (int i = 0; i < dfActual->numColumnas; i++) {
-                if (strcmp(dfActual->columnas[i].nombre, columna) == 0) {
-                    col_idx = i;
-                    break;
-                }
-            }
+    col->valores = (void *)(base + d->valores);
+    col->validos = (uint64_t *)(base + d->validos);
+    col->mapa = retenerMapa(mapa);
+    if (!ES_CATEGORIA(formato))
+        return 1;
 
-            if (col_idx == -1) {
-                print_error("Columna no encontrada");
-                continue;
-            }
+    int64_t maxValores = formato == FMT_CATEGORIA8 ? 256 : MAX_CATEGORIAS;
+    if (d->numValores <= 0 || d->numValores > maxValores ||
+        !seccionValidaDFB(mapa, d->diccionario, (uint64_t)d->numValores * sizeof(uint64_t)))
+        return 0;
+    // Un código fuera del diccionario leería fuera del array de valores
+    uint32_t codigoMaximo = 0;
+    for (int64_t i = 0; i < n; i++) {
+        uint32_t codigo = codigoCelda(col, i);
+        codigoMaximo = codigo > codigoMaximo ? codigo : codigoMaximo;
+    }
+    if (codigoMaximo >= (uint64_t)d->numValores)
+        return 0;
 
-            char *valor_convertido = strdup(valor);
-            if (!valor_convertido) {
-                print_error("Error de memoria");
-                continue;
-            }
+    Diccionario *dic = calloc(1, sizeof(Diccionario));
+    if (!dic)
+        return 0;
+    dic->referencias = 1;
+    col->dic = dic;
+    dic->numValores = (int32_t)d->numValores;
+    dic->valores = malloc((size_t)d->numValores * sizeof(char *));
+    dic->arena = arenaDeMapa(mapa);
+    if (!dic->valores || !dic->arena)
+        return 0;
+    if (!punterosCadenasDFB(dic->valores, (const uint64_t *)(base + d->diccionario), d->numValores,
+                            base + d->cadenas, d->tamCadenas))
+        return 0;
+    for (int32_t i = 0; i < dic->numValores; i++) {
+        if (!dic->valores[i])
+            return 0;
+    }
+    return 1;
+}
 
-            filterCLI(dfActual, columna, operador, valor_convertido);
-            free(valor_convertido);
-        } else if (strncmp(input, "quarter ", 8) == 0) {
-            char col_fecha[50], col_nueva[50];
+// Recupera las estadísticas guardadas de una columna ya abierta. Si no hay
+// (instantáneas anteriores) o no son coherentes, la columna queda sin ellas.
+static void abrirEstadisticasDFB(Columna *col, const DescriptorDFB *d, const MapaInstantanea *mapa) {
+    if (!d->estadisticas || !seccionValidaDFB(mapa, d->estadisticas, sizeof(EstadisticasDFB)))
+        return;
+    const char *base = (const char *)mapa->datos + d->estadisticas;
+    const EstadisticasDFB *e = (const EstadisticasDFB *)base;
+    EstadisticasColumna *est = &col->estadisticas;
+    if (e->hayValores && col->formato == FMT_TEXTO) {
+        // Las dos cadenas siguen en el mapa, que la arena de la columna mantiene.
+        // Cada longitud se compara con lo que queda del archivo para que la
+        // suma no pueda desbordarse.
+        uint64_t resto = mapa->tamano - d->estadisticas - sizeof(EstadisticasDFB);
+        if (e->minimo < 0 || e->maximo < 0 || (uint64_t)e->minimo >= resto ||
+            (uint64_t)e->maximo >= resto - (uint64_t)e->minimo - 1)
+            return;
+        uint64_t tam = sizeof(EstadisticasDFB) + (uint64_t)e->minimo + (uint64_t)e->maximo + 2;
+        if (base[sizeof(EstadisticasDFB) + e->minimo] != '\0' || base[tam - 1] != '\0')
+            return;
+        est->minimo.s = base + sizeof(EstadisticasDFB);
+        est->maximo.s = est->minimo.s + e->minimo + 1;
+    } else {
+        memcpy(&est->minimo, &e->minimo, sizeof(e->minimo));
+        memcpy(&est->maximo, &e->maximo, sizeof(e->maximo));
+        // Un código fuera del diccionario no se podría mostrar
+        if (e->hayValores && ES_CATEGORIA(col->formato) &&
+            (est->minimo.e < 0 || est->minimo.e > est->maximo.e || est->maximo.e >= col->dic->numValores))
+            return;
+    }
+    if (e->nulos < 0 || e->nulos > col->numFilas)
+        return;
+    est->exactas = e->exactas != 0;
+    est->ordenada = e->ordenada != 0;
+    est->hayValores = e->hayValores != 0;
+    est->nulos = e->nulos;
+    memcpy(est->registros, e->registros, sizeof(est->registros));
+    est->validas = 1;
+}
 
-            int parsed = sscanf(input + 8, "%49s %49s", col_fecha, col_nueva);
-            if (parsed != 2) {
-                print_error("Uso: quarter [columna_fecha] [nombre_nueva_columna]");
-                continue;
+// Abre una instantánea .dfb como nuevo dataframe sin parsear nada: el archivo
+// se proyecta en memoria y las columnas apuntan a él hasta que se modifican
+// (copy-on-write con separarColumna).
+void loadearDFB(const char *nombre_archivo) {
+    double inicio = tiempoActual();
+    int fd = open(nombre_archivo, O_RDONLY);
+    if (fd < 0) {
+        print_error("No se puede abrir el archivo");
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CabeceraDFB)) {
+        close(fd);
+        print_error("El archivo no es una instantánea .dfb válida");
+        return;
+    }
+    // Privado y escribible: una escritura accidental nunca llega al archivo
+    void *datos = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    MapaInstantanea *mapa = datos != MAP_FAILED ? malloc(sizeof(MapaInstantanea)) : NULL;
+    if (!mapa) {
+        if (datos != MAP_FAILED)
+            munmap(datos, (size_t)st.st_size);
+        print_error("No se puede proyectar el archivo en memoria");
+        return;
+    }
+    mapa->datos = datos;
+    mapa->tamano = (size_t)st.st_size;
+    mapa->referencias = 1;
+
+    const CabeceraDFB *cabecera = datos;
+    const DescriptorDFB *descriptores = (const DescriptorDFB *)(cabecera + 1);
+    if (memcmp(cabecera->magia, MAGIA_DFB, sizeof(cabecera->magia)) != 0) {
+        liberarMapa(mapa);
+        print_error("El archivo no es una instantánea .dfb válida");
+        return;
+    }
+    if (cabecera->version < 1 || cabecera->version > VERSION_DFB) {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Versión de instantánea no soportada: %" PRIu32,
+                 cabecera->version);
+        liberarMapa(mapa);
+        print_error(error_msg);
+        return;
+    }
+    int64_t numFilas = cabecera->numFilas;
+    int numColumnas = (int)cabecera->numColumnas;
+    if (numColumnas <= 0 || cabecera->numColumnas > INT32_MAX || numFilas < 0 ||
+        (uint64_t)numFilas > (uint64_t)mapa->tamano * 8 ||
+        !seccionValidaDFB(mapa, sizeof(CabeceraDFB), (uint64_t)numColumnas * sizeof(DescriptorDFB))) {
+        liberarMapa(mapa);
+        print_error("El archivo no es una instantánea .dfb válida");
+        return;
+    }
+
+    char nombre_df[51];
+    nombreLibreDF(nombre_df, sizeof(nombre_df));
+
+    Dataframe *nuevo_df = crearNuevoDataframe(numColumnas, 0, nombre_df);
+    if (!nuevo_df) {
+        liberarMapa(mapa);
+        return;
+    }
+    nuevo_df->numFilas = numFilas;
+    for (int c = 0; c < numColumnas; c++) {
+        if (!abrirColumnaDFB(&nuevo_df->columnas[c], &descriptores[c], numFilas, mapa)) {
+            liberarMapa(mapa);
+            liberarRecursosEnError(nuevo_df, "La instantánea .dfb está dañada");
+            return;
+        }
+        // Las de la versión 1 no traen estadísticas: se calculan abajo
+        if (cabecera->version >= 2)
+            abrirEstadisticasDFB(&nuevo_df->columnas[c], &descriptores[c], mapa);
+    }
+    // Cada columna y arena tiene ya su referencia al mapa
+    liberarMapa(mapa);
+    calcularEstadisticasDF(nuevo_df);
+
+    dfActual = nuevo_df;
+    agregarDF(nuevo_df);
+    listaDF.numDFs++;
+    actualizarPrompt(dfActual);
+
+    double segundos = tiempoActual() - inicio;
+    double megas = (double)st.st_size / (1024.0 * 1024.0);
+    printf(GREEN "Archivo cargado: %" PRId64 " filas, %d columnas (%.1f MB en %.3f s, %.1f MB/s)\n" RESET,
+           dfActual->numFilas, dfActual->numColumnas, megas, segundos,
+           segundos > 0 ? megas / segundos : 0.0);
+}
+
+// --- Modo stream ---------------------------------------------------------------
+// 'load --stream' no carga el CSV: deduce el esquema de una muestra y apunta
+// los comandos. 'save' recorre el archivo en lotes de BYTES_LOTE_FLUJO,
+// aplica los comandos a cada lote y escribe el resultado, así que la memoria
+// usada no depende del tamaño del archivo.
+
+Flujo *flujoActual = NULL;
+
+static void actualizarPromptFlujo(void) {
+    snprintf(promptTerminal, MAX_LINE_LENGTH, "[%s (stream): ?,%d]:> ", flujoActual->archivo,
+             flujoActual->plan.muestra->numColumnas);
+}
+
+void cerrarFlujo(void) {
+    if (!flujoActual)
+        return;
+    liberarMemoriaDF(flujoActual->plan.muestra);
+    free(flujoActual->tipos);
+    free(flujoActual->formatos);
+    free(flujoActual);
+    flujoActual = NULL;
+    actualizarPrompt(dfActual);
+}
+
+// Fin del lote que empieza en 'p' (principio de fila): el primer salto de
+// línea fuera de comillas a partir de p + bytes
+static const char *finDeLote(const char *p, const char *fin, size_t bytes) {
+    if ((size_t)(fin - p) <= bytes)
+        return fin;
+    const char *q = p + bytes;
+    int dentro = 0;
+    for (const char *c = p; (c = memchr(c, '"', (size_t)(q - c))) != NULL; c++)
+        dentro ^= 1;
+    while (q < fin && (*q != '\n' || dentro)) {
+        dentro ^= *q == '"';
+        q++;
+    }
+    return q < fin ? q + 1 : fin;
+}
+
+// Parsea las filas [p, fin) en un dataframe nuevo con el encabezado del archivo
+static Dataframe *parsearLoteFlujo(const ArchivoMapeado *archivo, const char *p, const char *fin,
+                                   char sep) {
+    const char *inicio = archivo->datos, *finArchivo = archivo->datos + archivo->tamano;
+    Dataframe *lote = crearNuevoDataframe(contarColumnasCSV(inicio, finArchivo, sep), 0, "stream");
+    if (!lote)
+        return NULL;
+    leerEncabezadoCSV(inicio, finArchivo, sep, lote);
+    if (parsearFilasCSVParalelo(p, fin, sep, lote) < 0) {
+        liberarRecursosEnError(lote, "Error al asignar memoria para filas");
+        return NULL;
+    }
+    return lote;
+}
+
+// Da a las columnas del lote el tipo deducido de la muestra
+static int aplicarEsquemaFlujo(const Flujo *flujo, Dataframe *lote) {
+    for (int c = 0; c < lote->numColumnas; c++) {
+        Columna *col = &lote->columnas[c];
+        col->numFilas = lote->numFilas;
+        col->tipo = flujo->tipos[c];
+        if (flujo->tipos[c] == TEXTO)
+            continue;
+        // Un lote con decimales en una columna entera de la muestra se lee como real
+        int ok = convertirColumna(col, flujo->formatos[c]) ||
+                 (flujo->formatos[c] == FMT_ENTERO && convertirColumna(col, FMT_REAL));
+        if (!ok) {
+            char error_msg[100];
+            snprintf(error_msg, sizeof(error_msg),
+                     "La columna '%s' tiene valores que no son del tipo deducido de la muestra", col->nombre);
+            print_error(error_msg);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void loadearFlujo(const char *nombre_archivo, char sep) {
+    ArchivoMapeado archivo;
+    if (!mapearArchivo(nombre_archivo, &archivo)) {
+        print_error("No se puede abrir el archivo");
+        return;
+    }
+    // El esquema se deduce de la primera parte del archivo
+    Dataframe sinColumnas = {0};
+    const char *p = leerEncabezadoCSV(archivo.datos, archivo.datos + archivo.tamano, sep, &sinColumnas);
+    Flujo *flujo = calloc(1, sizeof(Flujo));
+    Dataframe *muestra = NULL;
+    if (flujo)
+        muestra = parsearLoteFlujo(&archivo, p, finDeLote(p, archivo.datos + archivo.tamano, BYTES_MUESTRA_FLUJO), sep);
+    desmapearArchivo(&archivo);
+    if (!muestra) {
+        free(flujo);
+        return;
+    }
+    tiposColumnas(muestra);
+    flujo->tipos = malloc((size_t)muestra->numColumnas * sizeof(TipoDato));
+    flujo->formatos = malloc((size_t)muestra->numColumnas * sizeof(Formato));
+    if (!flujo->tipos || !flujo->formatos) {
+        free(flujo->tipos);
+        free(flujo->formatos);
+        free(flujo);
+        liberarRecursosEnError(muestra, "Error de memoria al abrir el stream");
+        return;
+    }
+    for (int c = 0; c < muestra->numColumnas; c++) {
+        flujo->tipos[c] = muestra->columnas[c].tipo;
+        flujo->formatos[c] = muestra->columnas[c].formato;
+    }
+    strncpy(flujo->archivo, nombre_archivo, sizeof(flujo->archivo) - 1);
+    flujo->sep = sep;
+    flujo->plan.muestra = muestra;
+
+    cerrarFlujo();
+    flujoActual = flujo;
+    actualizarPromptFlujo();
+    printf(GREEN "Stream abierto: %d columnas, tipos deducidos de %" PRId64 " filas de muestra\n" RESET,
+           muestra->numColumnas, muestra->numFilas);
+}
+
+// Recorre el archivo lote a lote aplicando las operaciones y escribe el CSV
+void saveFlujo(const char *nombre_archivo) {
+    double inicio = tiempoActual();
+    ArchivoMapeado archivo;
+    if (!mapearArchivo(flujoActual->archivo, &archivo)) {
+        print_error("No se puede abrir el archivo del stream");
+        return;
+    }
+    int fd = open(nombre_archivo, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        char error_msg[MAX_FILENAME + 50];
+        snprintf(error_msg, sizeof(error_msg), "No se puede crear el archivo: %s", nombre_archivo);
+        print_error(error_msg);
+        desmapearArchivo(&archivo);
+        return;
+    }
+
+    const char *fin = archivo.datos + archivo.tamano;
+    Dataframe sinColumnas = {0};
+    const char *p = leerEncabezadoCSV(archivo.datos, fin, flujoActual->sep, &sinColumnas);
+    long pagina = sysconf(_SC_PAGESIZE);
+    int64_t leidas = 0, escritas = 0;
+    int ok = escribirEncabezadoCSV(fd, flujoActual->plan.muestra);
+    while (ok && p < fin) {
+        const char *corte = finDeLote(p, fin, BYTES_LOTE_FLUJO);
+        Dataframe *lote = parsearLoteFlujo(&archivo, p, corte, flujoActual->sep);
+        ok = lote && aplicarEsquemaFlujo(flujoActual, lote);
+        if (ok) {
+            leidas += lote->numFilas;
+            // El plan trabaja sobre dfActual, que se cambia mientras tanto por el lote
+            int estado = 0;
+            if (lote->numFilas > 0) {
+                Dataframe *anterior = dfActual;
+                dfActual = lote;
+                estado = ejecutarPlan(&flujoActual->plan, 1);
+                lote = dfActual;
+                dfActual = anterior;
+                actualizarPromptFlujo();
             }
+            ok = estado >= 0 && (estado == 0 || escribirFilasCSV(fd, lote));
+            if (estado > 0)
+                escritas += lote->numFilas;
+        }
+        if (lote)
+            liberarMemoriaDF(lote);
 
-            quarterCLI(col_fecha, col_nueva);
-        } else if (strncmp(input, "name ", 5) == 0) {
-            char nuevo_nombre[51];
-            strncpy(nuevo_nombre, input + 5, 50);
-            nuevo_nombre[50] = '\0';
-            cortarEspacios(nuevo_nombre);
-            if (strlen(nuevo_nombre) == 0 || strlen(nuevo_nombre) > 50) {
-                print_error("El nombre debe tener entre 1 y 50 caracteres");
+        // Las páginas ya procesadas no se volverán a leer
+        const char *desde = archivo.datos + (p - archivo.datos) / pagina * pagina;
+        madvise((void *)desde, (size_t)((corte - desde) / pagina * pagina), MADV_DONTNEED);
+        p = corte;
+    }
+    ok = close(fd) == 0 && ok;
+    desmapearArchivo(&archivo);
+    if (!ok) {
+        remove(nombre_archivo);
+        print_error("Error al procesar el stream");
+        return;
+    }
+
+    double segundos = tiempoActual() - inicio;
+    double megas = (double)archivo.tamano / (1024.0 * 1024.0);
+    printf(GREEN "Stream guardado en %s: %" PRId64 " filas leídas, %" PRId64
+                 " escritas (%.1f MB en %.3f s, %.1f MB/s)\n" RESET,
+           nombre_archivo, leidas, escritas, megas, segundos, segundos > 0 ? megas / segundos : 0.0);
+}
+
+void cortarEspacios(char *str) {
+    size_t longitud = strlen(str);
+    if (longitud > 0 && str[longitud - 1] == '\n') {
+        str[longitud - 1] = '\0';
+    }
+
+    char *inicio = str;
+    while (*inicio == ' ') {
+        inicio++;
+    }
+
+    if (inicio != str) {
+        memmove(str, inicio, strlen(inicio) + 1);
+    }
+
+    longitud = strlen(str);
+    while (longitud > 0 && str[longitud - 1] == ' ') {
+        str[--longitud] = '\0';
+    }
+}
+
+int fechaValida(const char *str_fecha) {
+    if (!str_fecha)
+        return 0;
+
+    int año, mes, dia;
+    if (sscanf(str_fecha, "%4d-%2d-%2d", &año, &mes, &dia) != 3)
+        return 0;
+
+    // Validar rangos básicos
+    if (año < 1900 || mes < 1 || mes > 12 || dia < 1 || dia > 31)
+        return 0;
+
+    // Días por mes, incluyendo bisiestos
+    int diasPorMes[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if ((año % 4 == 0 && año % 100 != 0) || (año % 400 == 0))
+        diasPorMes[1] = 29;
+
+    return (dia <= diasPorMes[mes - 1]);
+}
+
+// Días transcurridos desde 1970-01-01 en el calendario gregoriano, sin pasar
+// por mktime (que consulta la zona horaria)
+int32_t diasDesdeEpoch(int anio, int mes, int dia) {
+    anio -= mes <= 2;
+    int era = (anio >= 0 ? anio : anio - 399) / 400;
+    int anioEra = anio - era * 400;
+    int diaAnio = (153 * (mes > 2 ? mes - 3 : mes + 9) + 2) / 5 + dia - 1;
+    int diaEra = anioEra * 365 + anioEra / 4 - anioEra / 100 + diaAnio;
+    return (int32_t)(era * 146097 + diaEra - 719468);
+}
+
+// Operación inversa de diasDesdeEpoch, solo con aritmética entera
+void descomponerFecha(int32_t dias, int *anio, int *mes, int *dia) {
+    int z = dias + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int diaEra = z - era * 146097;
+    int anioEra = (diaEra - diaEra / 1460 + diaEra / 36524 - diaEra / 146096) / 365;
+    int diaAnio = diaEra - (365 * anioEra + anioEra / 4 - anioEra / 100);
+    int mp = (5 * diaAnio + 2) / 153;
+    *dia = diaAnio - (153 * mp + 2) / 5 + 1;
+    *mes = mp < 10 ? mp + 3 : mp - 9;
+    *anio = anioEra + era * 400 + (*mes <= 2);
+}
+
+int parsearFecha(const char *str, int32_t *dias) {
+    int anio, mes, dia, usados = 0;
+    if (!fechaValida(str) || sscanf(str, "%4d-%2d-%2d%n", &anio, &mes, &dia, &usados) != 3 ||
+        str[usados] != '\0')
+        return 0;
+    *dias = diasDesdeEpoch(anio, mes, dia);
+    return 1;
+}
+
+// Acepta solo enteros en base 10 que ocupen la cadena completa
+int parsearEntero(const char *str, int64_t *valor) {
+    if (!str || !(isdigit((unsigned char)str[0]) || str[0] == '-' || str[0] == '+'))
+        return 0;
+    char *fin;
+    errno = 0;
+    long long v = strtoll(str, &fin, 10);
+    if (fin == str || *fin != '\0' || errno == ERANGE)
+        return 0;
+    *valor = (int64_t)v;
+    return 1;
+}
+
+// Acepta números decimales que ocupen la cadena completa (sin nan/inf ni hexadecimales)
+int parsearReal(const char *str, double *valor) {
+    if (!str || !(isdigit((unsigned char)str[0]) || str[0] == '-' || str[0] == '+' || str[0] == '.'))
+        return 0;
+    for (const char *c = str; *c; c++) {
+        if (*c == 'x' || *c == 'X' || *c == 'n' || *c == 'N' || *c == 'i' || *c == 'I')
+            return 0;
+    }
+    char *fin;
+    double v = strtod(str, &fin);
+    if (fin == str || *fin != '\0' || !isfinite(v))
+        return 0;
+    *valor = v;
+    return 1;
+}
+
+size_t tamanoCelda(Formato formato) {
+    switch (formato) {
+    case FMT_ENTERO:
+        return sizeof(int64_t);
+    case FMT_REAL:
+        return sizeof(double);
+    case FMT_FECHA:
+        return sizeof(int32_t);
+    case FMT_CATEGORIA8:
+        return sizeof(uint8_t);
+    case FMT_CATEGORIA16:
+        return sizeof(uint16_t);
+    case FMT_TEXTO:
+    default:
+        return sizeof(char *);
+    }
+}
+
+// Cambia la representación de una columna. Convierte TEXTO (o una columna
+// categórica) a ENTERO/REAL/FECHA (falla sin modificar nada si algún valor no
+// encaja), ENTERO a REAL y cualquier formato a TEXTO.
+// Las celdas que cambiarían al escribirse de nuevo se quedan como texto: en
+// números el '+' inicial y los ceros a la izquierda ("007", "-0", "00.5") y en
+// fechas lo que no sea exactamente AAAA-MM-DD
+static int numeroReescribible(const char *str) {
+    const char *d = str[0] == '-' ? str + 1 : str;
+    if (str[0] == '+' || (d[0] == '0' && isdigit((unsigned char)d[1])))
+        return 0;
+    return !(d != str && d[0] == '0' && d[1] == '\0');
+}
+
+static int fechaReescribible(const char *str) {
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7 ? str[i] != '-' : !isdigit((unsigned char)str[i]))
+            return 0;
+    }
+    return str[10] == '\0';
+}
+
+int convertirColumna(Columna *col, Formato formato) {
+    if (!col)
+        return 0;
+    if (col->formato == formato)
+        return 1;
+    // A los formatos categóricos solo se llega con codificarColumna
+    if (ES_CATEGORIA(formato) || !separarColumna(col))
+        return 0;
+
+    // Al decodificar una columna categórica las celdas apuntan a las cadenas
+    // del diccionario, cuya arena pasa a compartirse
+    int desdeTexto = col->formato == FMT_TEXTO || ES_CATEGORIA(col->formato);
+    int64_t capacidad = col->capacidad > 0 ? col->capacidad : 1;
+    void *nuevos = calloc((size_t)capacidad, tamanoCelda(formato));
+    ArenaTexto *arena = NULL;
+    if (formato == FMT_TEXTO)
+        arena = ES_CATEGORIA(col->formato) ? retenerArena(col->dic->arena) : crearArena();
+    if (!nuevos || (formato == FMT_TEXTO && !arena)) {
+        free(nuevos);
+        liberarArena(arena);
+        return 0;
+    }
+
+    for (int64_t fila = 0; fila < col->numFilas; fila++) {
+        if (ES_NULO(col, fila))
+            continue;
+        int ok = 1;
+        char buffer[64];
+        const char *texto = NULL;
+        if (desdeTexto || formato == FMT_TEXTO)
+            texto = textoCelda(col, fila, buffer, sizeof(buffer));
+        if (formato == FMT_TEXTO && ES_CATEGORIA(col->formato)) {
+            ((char **)nuevos)[fila] = (char *)texto;
+        } else if (formato == FMT_TEXTO) {
+            ((char **)nuevos)[fila] = copiarEnArena(arena, texto, strlen(texto));
+            ok = ((char **)nuevos)[fila] != NULL;
+        } else if (desdeTexto && formato == FMT_ENTERO) {
+            ok = texto && numeroReescribible(texto) && parsearEntero(texto, &((int64_t *)nuevos)[fila]);
+        } else if (desdeTexto && formato == FMT_REAL) {
+            ok = texto && numeroReescribible(texto) && parsearReal(texto, &((double *)nuevos)[fila]);
+        } else if (desdeTexto && formato == FMT_FECHA) {
+            ok = texto && fechaReescribible(texto) && parsearFecha(texto, &((int32_t *)nuevos)[fila]);
+        } else if (col->formato == FMT_ENTERO && formato == FMT_REAL) {
+            ((double *)nuevos)[fila] = (double)col->enteros[fila];
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            liberarArena(arena);
+            free(nuevos);
+            return 0;
+        }
+    }
+
+    liberarArena(col->arena);
+    liberarDiccionario(col->dic);
+    col->arena = arena;
+    col->dic = NULL;
+    free(col->valores);
+    col->valores = nuevos;
+    col->formato = formato;
+    return 1;
+}
+
+// Formatea un double con "%.15g" y, si al releerlo no sale el mismo valor,
+// con "%.17g", que siempre lo reproduce exacto.
+static int formatearDoble(char *buffer, size_t tamBuffer, double v) {
+    int len = snprintf(buffer, tamBuffer, "%.15g", v);
+    if (!isnan(v) && strtod(buffer, NULL) != v)
+        len = snprintf(buffer, tamBuffer, "%.17g", v);
+    return len;
+}
+
+// Devuelve el valor de una celda como texto (NULL si es nula). Las cadenas se
+// devuelven tal cual; los números se formatean en 'buffer'.
+const char *textoCelda(const Columna *col, int64_t fila, char *buffer, size_t tamBuffer) {
+    if (ES_NULO(col, fila))
+        return NULL;
+    switch (col->formato) {
+    case FMT_ENTERO:
+        snprintf(buffer, tamBuffer, "%" PRId64, col->enteros[fila]);
+        return buffer;
+    case FMT_REAL:
+        formatearDoble(buffer, tamBuffer, col->reales[fila]);
+        return buffer;
+    case FMT_FECHA: {
+        int anio, mes, dia;
+        descomponerFecha(col->fechas[fila], &anio, &mes, &dia);
+        snprintf(buffer, tamBuffer, "%04d-%02d-%02d", anio, mes, dia);
+        return buffer;
+    }
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        return col->dic->valores[codigoCelda(col, fila)];
+    case FMT_TEXTO:
+    default:
+        return col->datos[fila];
+    }
+}
+
+// Deduce el tipo de cada columna y guarda las numéricas y las fechas como
+// arrays nativos
+void tiposColumnas(Dataframe *df) {
+    if (!df)
+        return;
+
+    for (int col = 0; col < df->numColumnas; col++) {
+        Columna *c = &df->columnas[col];
+        c->numFilas = df->numFilas;
+        if (c->formato != FMT_TEXTO)
+            continue;
+
+        int esFecha = 1, esEntero = 1, esReal = 1;
+        for (int64_t fila = 0; fila < df->numFilas && (esFecha || esEntero || esReal); fila++) {
+            if (ES_NULO(c, fila))
                 continue;
+            char *valor = c->datos[fila];
+            int64_t entero;
+            double real;
+            if (!valor) {
+                esFecha = esEntero = esReal = 0;
+                break;
             }
-            if (!nombreDFUnico(&listaDF, nuevo_nombre)) {
-                print_error("Ya existe un dataframe con ese nombre");
-                continue;
+            if (esFecha && (!fechaReescribible(valor) || !fechaValida(valor)))
+                esFecha = 0;
+            if ((esEntero || esReal) && !numeroReescribible(valor))
+                esEntero = esReal = 0;
+            if (esEntero && !parsearEntero(valor, &entero))
+                esEntero = 0;
+            if (esReal && !esEntero && !parsearReal(valor, &real))
+                esReal = 0;
+        }
+
+        if (esFecha && convertirColumna(c, FMT_FECHA)) {
+            c->tipo = FECHA;
+        } else if (esEntero && convertirColumna(c, FMT_ENTERO)) {
+            c->tipo = NUMERICO;
+        } else if (esReal && convertirColumna(c, FMT_REAL)) {
+            c->tipo = NUMERICO;
+        } else {
+            c->tipo = TEXTO;
+            codificarColumna(c);
+        }
+    }
+}
+
+void print_error(const char *mensaje_error) {
+    fprintf(stderr, RED "ERROR: %s\n" RESET, mensaje_error);
+}
+
+void inicializarLista() {
+    listaDF.numDFs = 0;
+    listaDF.primero = NULL;
+}
+
+int encontrarIndiceColumna(Dataframe *df, const char *nombreColumna) {
+    for (int i = 0; i < df->numColumnas; i++) {
+        if (strcmp(df->columnas[i].nombre, nombreColumna) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Claves normalizadas para ordenar: cada fila se codifica en 'ancho' bytes
+// comparables con memcmp. Por columna se escribe un byte de nulo (0 = nulo,
+// así los nulos son el mínimo), el valor en big-endian con el signo ajustado
+// (o un prefijo de PREFIJO_CLAVE_TEXTO bytes para el texto) y, si la columna
+// es descendente, todos sus bytes invertidos.
+#define PREFIJO_CLAVE_TEXTO 12
+#define MAX_CLAVES_ORDEN 16
+
+// Columna de texto cuyo prefijo puede quedarse corto: al empatar en los bytes
+// hasta 'fin' hay que desempatar con la cadena completa
+typedef struct {
+    const Columna *col;
+    size_t fin;
+    int descendente;
+} CorteTexto;
+
+typedef struct {
+    const unsigned char *claves;
+    size_t ancho;
+    CorteTexto cortes[MAX_CLAVES_ORDEN];
+    int numCortes;
+} ClavesOrden;
+
+static inline int compararClaves(const ClavesOrden *c, int64_t a, int64_t b) {
+    const unsigned char *ka = c->claves + (size_t)a * c->ancho;
+    const unsigned char *kb = c->claves + (size_t)b * c->ancho;
+    size_t inicio = 0;
+    for (int i = 0; i < c->numCortes; i++) {
+        const CorteTexto *corte = &c->cortes[i];
+        int r = memcmp(ka + inicio, kb + inicio, corte->fin - inicio);
+        if (r != 0)
+            return r;
+        // Mismo byte de nulo: o ambos son nulos o ninguno lo es
+        if (!ES_NULO(corte->col, a)) {
+            r = strcmp(corte->col->datos[a], corte->col->datos[b]);
+            if (r != 0)
+                return corte->descendente ? -r : r;
+        }
+        inicio = corte->fin;
+    }
+    return memcmp(ka + inicio, kb + inicio, c->ancho - inicio);
+}
+
+#define TAMANO_TRAMO_INSERCION 32
+
+// Merge sort estable de abajo arriba sobre el array de índices: primero
+// ordena tramos pequeños por inserción y luego los fusiona duplicando el ancho.
+static void ordenarIndices(int64_t *indices, int64_t *temp, int64_t n, const ClavesOrden *c) {
+    for (int64_t inicio = 0; inicio < n; inicio += TAMANO_TRAMO_INSERCION) {
+        int64_t fin = inicio + TAMANO_TRAMO_INSERCION < n ? inicio + TAMANO_TRAMO_INSERCION : n;
+        for (int64_t i = inicio + 1; i < fin; i++) {
+            int64_t actual = indices[i];
+            int64_t j = i;
+            while (j > inicio && compararClaves(c, indices[j - 1], actual) > 0) {
+                indices[j] = indices[j - 1];
+                j--;
+            }
+            indices[j] = actual;
+        }
+    }
+
+    int64_t *origen = indices, *destino = temp;
+    for (int64_t ancho = TAMANO_TRAMO_INSERCION; ancho < n; ancho *= 2) {
+        for (int64_t izq = 0; izq < n; izq += 2 * ancho) {
+            int64_t medio = izq + ancho < n ? izq + ancho : n;
+            int64_t fin = izq + 2 * ancho < n ? izq + 2 * ancho : n;
+            int64_t i = izq, j = medio, k = izq;
+            while (i < medio && j < fin) {
+                // '<=' sobre el lado izquierdo mantiene la estabilidad
+                if (compararClaves(c, origen[i], origen[j]) <= 0)
+                    destino[k++] = origen[i++];
+                else
+                    destino[k++] = origen[j++];
+            }
+            while (i < medio)
+                destino[k++] = origen[i++];
+            while (j < fin)
+                destino[k++] = origen[j++];
+        }
+        int64_t *aux = origen;
+        origen = destino;
+        destino = aux;
+    }
+    if (origen != indices)
+        memcpy(indices, origen, (size_t)n * sizeof(int64_t));
+}
+
+int numeroHilos(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    return n > MAX_HILOS ? MAX_HILOS : (int)n;
+}
+
+// Ejecuta funcion(&tareas[t]) en numHilos hilos; el hilo llamante hace la primera
+void ejecutarEnHilos(void *(*funcion)(void *), void *tareas, size_t tamTarea, int numHilos) {
+    pthread_t hilos[MAX_HILOS];
+    int lanzado[MAX_HILOS] = {0};
+    for (int t = 1; t < numHilos; t++)
+        lanzado[t] = pthread_create(&hilos[t], NULL, funcion, (char *)tareas + (size_t)t * tamTarea) == 0;
+    funcion(tareas);
+    for (int t = 1; t < numHilos; t++) {
+        if (lanzado[t])
+            pthread_join(hilos[t], NULL);
+        else
+            funcion((char *)tareas + (size_t)t * tamTarea);
+    }
+}
+
+// Transformaciones a claves sin signo cuyo orden de bits coincide con el orden
+// numérico: se invierte el bit de signo, y en los double negativos todos los bits.
+uint64_t claveOrdenableEntero(int64_t v) { return (uint64_t)v ^ 0x8000000000000000ULL; }
+
+uint64_t claveOrdenableReal(double v) {
+    uint64_t bits;
+    if (v == 0.0)
+        v = 0.0; // -0.0 y 0.0 deben compartir clave
+    memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x8000000000000000ULL) ? ~bits : bits ^ 0x8000000000000000ULL;
+}
+
+uint64_t claveOrdenableFecha(int32_t v) { return (uint64_t)((uint32_t)v ^ 0x80000000U); }
+
+#define BITS_DIGITO_RADIX 8
+#define CUBETAS_RADIX (1 << BITS_DIGITO_RADIX)
+#define MIN_FILAS_POR_HILO_RADIX 65536
+#define MIN_FILAS_RADIX 256
+
+// Trozo del array asignado a un hilo en una pasada del radix sort
+typedef struct {
+    const uint64_t *claves;
+    const int64_t *indices;
+    uint64_t *clavesDestino;
+    int64_t *indicesDestino;
+    int64_t inicio, fin;
+    int desplazamiento;
+    int64_t histograma[CUBETAS_RADIX];  // Cuenta del dígito en el trozo
+    int64_t posiciones[CUBETAS_RADIX];  // Primera posición de salida de cada dígito
+} TareaRadix;
+
+static void *histogramaRadix(void *arg) {
+    TareaRadix *t = arg;
+    memset(t->histograma, 0, sizeof(t->histograma));
+    for (int64_t i = t->inicio; i < t->fin; i++)
+        t->histograma[(t->claves[i] >> t->desplazamiento) & (CUBETAS_RADIX - 1)]++;
+    return NULL;
+}
+
+static void *dispersarRadix(void *arg) {
+    TareaRadix *t = arg;
+    for (int64_t i = t->inicio; i < t->fin; i++) {
+        uint64_t clave = t->claves[i];
+        int64_t pos = t->posiciones[(clave >> t->desplazamiento) & (CUBETAS_RADIX - 1)]++;
+        t->clavesDestino[pos] = clave;
+        t->indicesDestino[pos] = t->indices[i];
+    }
+    return NULL;
+}
+
+// Radix sort LSD estable de pares (clave, índice) con 'bytesClave' dígitos de
+// 8 bits. Cada hilo cuenta y dispersa su trozo contiguo; los trozos se
+// colocan en orden dentro de cada cubeta, así que el resultado es estable.
+int radixSortClaves(uint64_t *claves, int64_t *indices, int64_t n, int bytesClave, int numHilos) {
+    if (n < 2)
+        return 1;
+    if (numHilos < 1)
+        numHilos = 1;
+    if (numHilos > MAX_HILOS)
+        numHilos = MAX_HILOS;
+    if (n / numHilos < MIN_FILAS_POR_HILO_RADIX)
+        numHilos = (int)(n / MIN_FILAS_POR_HILO_RADIX) > 0 ? (int)(n / MIN_FILAS_POR_HILO_RADIX) : 1;
+
+    uint64_t *clavesAux = malloc((size_t)n * sizeof(uint64_t));
+    int64_t *indicesAux = malloc((size_t)n * sizeof(int64_t));
+    TareaRadix *tareas = malloc((size_t)numHilos * sizeof(TareaRadix));
+    if (!clavesAux || !indicesAux || !tareas) {
+        free(clavesAux);
+        free(indicesAux);
+        free(tareas);
+        return 0;
+    }
+
+    uint64_t *origenClaves = claves, *destinoClaves = clavesAux;
+    int64_t *origenIndices = indices, *destinoIndices = indicesAux;
+    for (int byte = 0; byte < bytesClave; byte++) {
+        for (int t = 0; t < numHilos; t++) {
+            tareas[t].claves = origenClaves;
+            tareas[t].indices = origenIndices;
+            tareas[t].clavesDestino = destinoClaves;
+            tareas[t].indicesDestino = destinoIndices;
+            tareas[t].inicio = n * t / numHilos;
+            tareas[t].fin = n * (t + 1) / numHilos;
+            tareas[t].desplazamiento = byte * BITS_DIGITO_RADIX;
+        }
+        ejecutarEnHilos(histogramaRadix, tareas, sizeof(TareaRadix), numHilos);
+
+        // Si todas las claves comparten este dígito la pasada no mueve nada
+        int64_t acumulado = 0;
+        int saltar = 0;
+        for (int d = 0; d < CUBETAS_RADIX; d++) {
+            int64_t total = 0;
+            for (int t = 0; t < numHilos; t++) {
+                tareas[t].posiciones[d] = acumulado + total;
+                total += tareas[t].histograma[d];
+            }
+            if (total == n)
+                saltar = 1;
+            acumulado += total;
+        }
+        if (saltar)
+            continue;
+
+        ejecutarEnHilos(dispersarRadix, tareas, sizeof(TareaRadix), numHilos);
+        uint64_t *auxClaves = origenClaves;
+        origenClaves = destinoClaves;
+        destinoClaves = auxClaves;
+        int64_t *auxIndices = origenIndices;
+        origenIndices = destinoIndices;
+        destinoIndices = auxIndices;
+    }
+    if (origenClaves != claves) {
+        memcpy(claves, origenClaves, (size_t)n * sizeof(uint64_t));
+        memcpy(indices, origenIndices, (size_t)n * sizeof(int64_t));
+    }
+    free(clavesAux);
+    free(indicesAux);
+    free(tareas);
+    return 1;
+}
+
+// Argsort de columnas numéricas y de fecha por radix sort. Los nulos se
+// apartan (primero en asc, al final en des) y el orden descendente se obtiene
+// complementando las claves, lo que conserva la estabilidad.
+static int64_t *argsortRadix(const Columna *col, int64_t numFilas, int descendente) {
+    int64_t *resultado = malloc((size_t)(numFilas > 0 ? numFilas : 1) * sizeof(int64_t));
+    uint64_t *claves = malloc((size_t)(numFilas > 0 ? numFilas : 1) * sizeof(uint64_t));
+    int64_t *indices = malloc((size_t)(numFilas > 0 ? numFilas : 1) * sizeof(int64_t));
+    if (!resultado || !claves || !indices) {
+        free(resultado);
+        free(claves);
+        free(indices);
+        return NULL;
+    }
+
+    int64_t numNulos = 0, numValores = 0;
+    // En las columnas categóricas la clave es el código: el diccionario ya está ordenado
+    int bytesClave = (int)sizeof(uint64_t);
+    if (col->formato == FMT_FECHA)
+        bytesClave = (int)sizeof(int32_t);
+    else if (ES_CATEGORIA(col->formato))
+        bytesClave = (int)tamanoCelda(col->formato);
+    uint64_t mascara = 0;
+    if (descendente)
+        mascara = bytesClave == (int)sizeof(uint64_t) ? ~0ULL : (1ULL << (8 * bytesClave)) - 1;
+    for (int64_t i = 0; i < numFilas; i++) {
+        if (ES_NULO(col, i)) {
+            numNulos++;
+            continue;
+        }
+        uint64_t clave;
+        if (col->formato == FMT_ENTERO)
+            clave = claveOrdenableEntero(col->enteros[i]);
+        else if (col->formato == FMT_REAL)
+            clave = claveOrdenableReal(col->reales[i]);
+        else if (col->formato == FMT_FECHA)
+            clave = claveOrdenableFecha(col->fechas[i]);
+        else
+            clave = codigoCelda(col, i);
+        claves[numValores] = clave ^ mascara;
+        indices[numValores++] = i;
+    }
+    if (!radixSortClaves(claves, indices, numValores, bytesClave, numeroHilos())) {
+        free(resultado);
+        free(claves);
+        free(indices);
+        return NULL;
+    }
+
+    int64_t pos = descendente ? numValores : 0;
+    for (int64_t i = 0; i < numFilas; i++) {
+        if (ES_NULO(col, i))
+            resultado[pos++] = i;
+    }
+    memcpy(resultado + (descendente ? 0 : numNulos), indices, (size_t)numValores * sizeof(int64_t));
+    free(claves);
+    free(indices);
+    return resultado;
+}
+
+static void escribirBigEndian(unsigned char *p, uint64_t v, int bytes) {
+    for (int b = bytes - 1; b >= 0; b--) {
+        p[b] = (unsigned char)v;
+        v >>= 8;
+    }
+}
+
+static size_t anchoClave(Formato formato) {
+    switch (formato) {
+    case FMT_FECHA:
+        return 4;
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        return 2;
+    case FMT_ENTERO:
+    case FMT_REAL:
+        return 8;
+    case FMT_TEXTO:
+    default:
+        return PREFIJO_CLAVE_TEXTO;
+    }
+}
+
+// Argsort estable por varias columnas: construye la clave normalizada de cada
+// fila una sola vez y ordena comparando bytes con memcmp
+int64_t *argsortColumnas(const Columna **cols, const int *descendente, int numClaves,
+                         int64_t numFilas) {
+    if (numClaves < 1 || numClaves > MAX_CLAVES_ORDEN)
+        return NULL;
+    // Una sola clave numérica, de fecha o categórica va por radix
+    if (numClaves == 1 && cols[0]->formato != FMT_TEXTO && numFilas >= MIN_FILAS_RADIX)
+        return argsortRadix(cols[0], numFilas, descendente[0]);
+
+    ClavesOrden orden = {0};
+    for (int c = 0; c < numClaves; c++)
+        orden.ancho += 1 + anchoClave(cols[c]->formato);
+
+    size_t filas = (size_t)(numFilas > 0 ? numFilas : 1);
+    unsigned char *claves = calloc(filas, orden.ancho);
+    int64_t *indices = malloc(filas * sizeof(int64_t));
+    int64_t *temp = malloc(filas * sizeof(int64_t));
+    if (!claves || !indices || !temp) {
+        free(claves);
+        free(indices);
+        free(temp);
+        return NULL;
+    }
+
+    // Se rellena columna a columna para que el bucle interior no cambie de formato
+    size_t desplazamiento = 0;
+    for (int c = 0; c < numClaves; c++) {
+        const Columna *col = cols[c];
+        size_t anchoValor = anchoClave(col->formato);
+        int truncada = 0;
+        for (int64_t i = 0; i < numFilas; i++) {
+            unsigned char *p = claves + (size_t)i * orden.ancho + desplazamiento;
+            if (ES_NULO(col, i))
+                continue;
+            p[0] = 1;
+            switch (col->formato) {
+            case FMT_ENTERO:
+                escribirBigEndian(p + 1, claveOrdenableEntero(col->enteros[i]), 8);
+                break;
+            case FMT_REAL:
+                escribirBigEndian(p + 1, claveOrdenableReal(col->reales[i]), 8);
+                break;
+            case FMT_FECHA:
+                escribirBigEndian(p + 1, claveOrdenableFecha(col->fechas[i]), 4);
+                break;
+            case FMT_CATEGORIA8:
+            case FMT_CATEGORIA16:
+                escribirBigEndian(p + 1, codigoCelda(col, i), 2);
+                break;
+            case FMT_TEXTO:
+            default: {
+                size_t len = strlen(col->datos[i]);
+                if (len >= PREFIJO_CLAVE_TEXTO) {
+                    len = PREFIJO_CLAVE_TEXTO;
+                    truncada = 1;
+                }
+                memcpy(p + 1, col->datos[i], len);
+                break;
+            }
+            }
+        }
+        if (descendente[c]) {
+            for (int64_t i = 0; i < numFilas; i++) {
+                unsigned char *p = claves + (size_t)i * orden.ancho + desplazamiento;
+                for (size_t b = 0; b <= anchoValor; b++)
+                    p[b] = (unsigned char)~p[b];
+            }
+        }
+        desplazamiento += 1 + anchoValor;
+        if (truncada) {
+            CorteTexto corte = {col, desplazamiento, descendente[c]};
+            orden.cortes[orden.numCortes++] = corte;
+        }
+    }
+
+    for (int64_t i = 0; i < numFilas; i++)
+        indices[i] = i;
+    orden.claves = claves;
+    ordenarIndices(indices, temp, numFilas, &orden);
+    free(claves);
+    free(temp);
+    return indices;
+}
+
+int64_t *argsortColumna(const Columna *col, int64_t numFilas, int descendente) {
+    return argsortColumnas(&col, &descendente, 1, numFilas);
+}
+
+// Reordena todas las columnas según 'permutacion' (fila i <- fila permutacion[i])
+// con una sola lectura por columna hacia buffers nuevos. Si falta memoria el
+// dataframe queda intacto.
+int aplicarPermutacion(Dataframe *df, const int64_t *permutacion) {
+    char **valores = calloc((size_t)df->numColumnas, sizeof(char *));
+    uint64_t **nulos = calloc((size_t)df->numColumnas, sizeof(uint64_t *));
+    int ok = valores && nulos;
+    for (int c = 0; ok && c < df->numColumnas; c++) {
+        int64_t capacidad = df->columnas[c].capacidad > 0 ? df->columnas[c].capacidad : 1;
+        valores[c] = calloc((size_t)capacidad, tamanoCelda(df->columnas[c].formato));
+        nulos[c] = malloc(PALABRAS_BITMAP(capacidad) * sizeof(uint64_t));
+        if (nulos[c])
+            memset(nulos[c], 0xFF, PALABRAS_BITMAP(capacidad) * sizeof(uint64_t));
+        ok = valores[c] && nulos[c];
+    }
+    if (!ok) {
+        for (int c = 0; valores && nulos && c < df->numColumnas; c++) {
+            free(valores[c]);
+            free(nulos[c]);
+        }
+        free(valores);
+        free(nulos);
+        return 0;
+    }
+
+    for (int c = 0; c < df->numColumnas; c++) {
+        Columna *col = &df->columnas[c];
+        reunirCeldas(valores[c], col->valores, permutacion, df->numFilas, tamanoCelda(col->formato));
+        reunirValidos(nulos[c], col, permutacion, df->numFilas);
+
+        // Las cadenas no se copian: solo cambian de posición sus punteros
+        soltarAlmacen(col);
+        col->valores = valores[c];
+        col->validos = nulos[c];
+    }
+    free(valores);
+    free(nulos);
+    return 1;
+}
+
+int ordenarDataframe(Dataframe *df, const int *indicesColumnas, const int *descendente,
+                     int numClaves) {
+    const Columna *cols[MAX_CLAVES_ORDEN];
+    for (int c = 0; c < numClaves; c++)
+        cols[c] = &df->columnas[indicesColumnas[c]];
+
+    // Si la única clave ya está en orden ascendente y sin nulos no hay nada que mover
+    const EstadisticasColumna *est = &cols[0]->estadisticas;
+    if (numClaves == 1 && !descendente[0] && est->validas && est->ordenada && est->nulos == 0)
+        return 1;
+
+    int64_t *permutacion = argsortColumnas(cols, descendente, numClaves, df->numFilas);
+    int ok = permutacion && aplicarPermutacion(df, permutacion);
+    free(permutacion);
+    if (!ok)
+        return 0;
+    // Las filas solo siguen ordenadas en la primera clave, si es ascendente
+    for (int c = 0; c < df->numColumnas; c++)
+        df->columnas[c].estadisticas.ordenada = 0;
+    df->columnas[indicesColumnas[0]].estadisticas.ordenada = !descendente[0];
+    return 1;
+}
+
+static int empiezaPorAlguno(const char *input, const char **comandos, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (strncmp(input, comandos[i], strlen(comandos[i])) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Comandos que tienen sentido con un stream abierto (load y quit aparte)
+static int admitidoEnFlujo(const char *input) {
+    static const char *comandos[] = {"filter ", "delnull ", "delcolum ", "quarter ", "prefix ", "save"};
+    return empiezaPorAlguno(input, comandos, sizeof(comandos) / sizeof(comandos[0])) ||
+           strcmp(input, "list") == 0 || strcmp(input, "explain") == 0;
+}
+
+// Comandos que en modo lazy necesitan antes ejecutar el plan
+static int usaDatos(const char *input) {
+    static const char *comandos[] = {"view", "save",        "meta",     "sort ",
+                                     "add ", "materialize", "groupby ", "createindex "};
+    return empiezaPorAlguno(input, comandos, sizeof(comandos) / sizeof(comandos[0]));
+}
+
+// Plan en el que se apuntan las operaciones: el del stream o el del df en modo lazy
+static Plan *planActivo(void) {
+    if (flujoActual)
+        return &flujoActual->plan;
+    return dfActual ? dfActual->plan : NULL;
+}
+
+void CLI() {
+    char input[MAX_LINE_LENGTH];
+
+    while (1) {
+        printf("%s", promptTerminal);
+        fgets(input, sizeof(input), stdin);
+        cortarEspacios(input);
+
+        if (!flujoActual && dfActual && dfActual->plan && usaDatos(input) && !ejecutarPlanDFActual())
+            continue;
+
+        if (strcmp(input, "quit") == 0) {
+            cerrarFlujo();
+            printf(GREEN "Fin...\n" RESET);
+            break;
+        } else if (strncmp(input, "load --stream ", 14) == 0) {
+            char archivo[256] = {0};
+            char sep = ',';
+            if (sscanf(input + 14, "%255s %c", archivo, &sep) < 1) {
+                print_error("Uso: load --stream <nombre_fichero> [<sep>]");
+                continue;
+            }
+            loadearFlujo(archivo, sep);
+        } else if (strncmp(input, "load ", 5) == 0) {
+            char archivo[256] = {0};
+            char sep = ',';
+            int parsed = sscanf(input + 5, "%255s %c", archivo, &sep);
+            cerrarFlujo();
+            if (parsed == 1 && esArchivoDFB(archivo)) {
+                loadearDFB(archivo);
+            } else if (parsed == 1) {
+                loadearCSV(archivo, ',');
+            } else if (parsed == 2) {
+                if (archivo[0] == '\0' || sep == '\0' || input[5 + strlen(archivo) + 1 + 1] != '\0') {
+                    print_error("Uso: load <nombre_fichero> [<sep>]");
+                    continue;
+                }
+                loadearCSV(archivo, sep);
+            } else {
+                print_error("Uso: load <nombre_fichero> [<sep>]");
+            }
+        } else if (flujoActual && !admitidoEnFlujo(input)) {
+            print_error("En modo stream solo se admiten filter, delnull, delcolum, quarter, prefix, explain, save, list y load");
+        } else if (strncmp(input, "add ", 4) == 0) {
+            char archivo[256] = {0};
+            char sep = ',';
+            int parsed = sscanf(input + 4, "%255s %c", archivo, &sep);
+            if (parsed == 1) {
+                addCLI(archivo, ',');
+            } else if (parsed == 2) {
+                if (archivo[0] == '\0' || sep == '\0' || input[4 + strlen(archivo) + 1 + 1] != '\0') {
+                    print_error("Uso: add <nombre_fichero> [<sep>]");
+                    continue;
+                }
+                addCLI(archivo, sep);
+            } else {
+                print_error("Uso: add <nombre_fichero> [<sep>]");
+            }
+        } else if (strcmp(input, "meta") == 0) {
+            metaCLI();
+        } else if (strncmp(input, "save", 4) == 0) {
+            // Saltar espacios después de 'save'
+            const char *nombre_archivo = input + 4;
+            while (*nombre_archivo == ' ') nombre_archivo++;
+            if (flujoActual) {
+                if (*nombre_archivo == '\0' || esArchivoDFB(nombre_archivo))
+                    print_error("Uso en modo stream: save <nombre_fichero>.csv");
+                else
+                    saveFlujo(nombre_archivo);
+            } else if (*nombre_archivo == '\0') {
+                saveCLI(NULL);
+            } else {
+                saveCLI(nombre_archivo);
+            }
+        } else if (strncmp(input, "view", 4) == 0) {
+            int n = 10;
+            if (strlen(input) > 4) {
+                char *endptr;
+                long parsed_n = strtol(input + 4, &endptr, 10);
+                if (endptr != input + 4 && parsed_n != 0) {
+                    viewCLI((int)parsed_n);
+                } else {
+                    print_error("Número de filas no válido");
+                    continue;
+                }
+            } else {
+                viewCLI(n);
+            }
+        }
+
+        else if (strncmp(input, "sort ", 5) == 0) {
+            // sort col1 [asc|des] col2 [asc|des] ...
+            char argumentos[MAX_LINE_LENGTH];
+            const char *nombres[MAX_CLAVES_ORDEN];
+            int descendente[MAX_CLAVES_ORDEN];
+            int numClaves = 0, valido = 1;
+
+            snprintf(argumentos, sizeof(argumentos), "%s", input + 5);
+            for (char *tok = strtok(argumentos, " \t"); tok; tok = strtok(NULL, " \t")) {
+                if (strcmp(tok, "asc") == 0 || strcmp(tok, "des") == 0) {
+                    if (numClaves == 0) {
+                        valido = 0;
+                        break;
+                    }
+                    descendente[numClaves - 1] = strcmp(tok, "des") == 0;
+                } else if (numClaves == MAX_CLAVES_ORDEN) {
+                    print_error("Demasiadas columnas de ordenación");
+                    valido = 0;
+                    break;
+                } else {
+                    nombres[numClaves] = tok;
+                    descendente[numClaves++] = 0;
+                }
+            }
+            if (!valido || numClaves == 0) {
+                print_error("Uso: sort <columna> [asc|des] [<columna> [asc|des]] ...");
+                continue;
+            }
+            sortCLI(nombres, descendente, numClaves);
+        } else if (strncmp(input, "delnull ", 8) == 0) {
+            if (planActivo()) {
+                OperacionPlan op = {.tipo = OP_PLAN_DELNULL};
+                snprintf(op.texto, sizeof(op.texto), "%s", input + 8);
+                apuntarOperacionCLI(&op);
+                continue;
+            }
+            delnullCLI(input + 8);
+        } else if (strncmp(input, "delcolum ", 9) == 0) {
+            const char *nombreColumna = input + 9;
+            while (*nombreColumna == ' ')
+                nombreColumna++;
+            if (planActivo()) {
+                OperacionPlan op = {.tipo = OP_PLAN_DELCOLUM};
+                snprintf(op.texto, sizeof(op.texto), "%s", nombreColumna);
+                apuntarOperacionCLI(&op);
+                continue;
+            }
+            delcolumCLI(nombreColumna);
+        } else if (strncmp(input, "df", 2) == 0 && strlen(input) > 2) {
+            char *endptr;
+            long indice = strtol(input + 2, &endptr, 10);
+            if (*endptr == '\0' && indice >= 0 && indice < listaDF.numDFs) {
+                // Buscar el dataframe por índice en la lista
+                Nodo *nodoActual = listaDF.primero;
+                for (int i = 0; i < indice && nodoActual != NULL; i++) {
+                    nodoActual = nodoActual->siguiente;
+                }
+                if (nodoActual == NULL || nodoActual->df == NULL) {
+                    print_error("Dataframe no encontrado.");
+                    continue;
+                }
+                dfActual = nodoActual->df;
+                actualizarPrompt(dfActual);
+                const char *nombre_df = (dfActual->nombre[0] != '\0') ? dfActual->nombre : dfActual->indice;
+                printf(GREEN "Cambiado a %s con %" PRId64 " filas y %d columnas\n" RESET, nombre_df,
+                       dfActual->numFilas, dfActual->numColumnas);
+            } else {
+                print_error("Índice de dataframe inválido.");
+            }
+        } else if (strncmp(input, "filter ", 7) == 0) {
+            // filter <columna> <op> <valor> [AND|OR [NOT] <columna> <op> <valor>] ...
+            if (planActivo()) {
+                OperacionPlan op = {.tipo = OP_PLAN_FILTRO};
+                snprintf(op.texto, sizeof(op.texto), "%s", input + 7);
+                apuntarOperacionCLI(&op);
+                continue;
+            }
+            if (!dfActual) {
+                print_error("No hay dataframe activo");
+                continue;
+            }
+            filterExprCLI(dfActual, input + 7);
+        } else if (strncmp(input, "quarter ", 8) == 0) {
+            char col_fecha[50], col_nueva[50];
+
+            int parsed = sscanf(input + 8, "%49s %49s", col_fecha, col_nueva);
+            if (parsed != 2) {
+                print_error("Uso: quarter [columna_fecha] [nombre_nueva_columna]");
+                continue;
+            }
+            if (planActivo()) {
+                OperacionPlan op = {.tipo = OP_PLAN_QUARTER};
+                snprintf(op.texto, sizeof(op.texto), "%s", col_fecha);
+                snprintf(op.nueva, sizeof(op.nueva), "%s", col_nueva);
+                apuntarOperacionCLI(&op);
+                continue;
+            }
+
+            quarterCLI(col_fecha, col_nueva);
+        } else if (strncmp(input, "name ", 5) == 0) {
+            char nuevo_nombre[51];
+            strncpy(nuevo_nombre, input + 5, 50);
+            nuevo_nombre[50] = '\0';
+            cortarEspacios(nuevo_nombre);
+            if (strlen(nuevo_nombre) == 0 || strlen(nuevo_nombre) > 50) {
+                print_error("El nombre debe tener entre 1 y 50 caracteres");
+                continue;
+            }
+            if (!nombreDFUnico(&listaDF, nuevo_nombre)) {
+                print_error("Ya existe un dataframe con ese nombre");
+                continue;
+            }
+            if (!dfActual) {
+                print_error("No hay dataframe activo");
+                continue;
+            }
+            strncpy(dfActual->nombre, nuevo_nombre, 50);
+            dfActual->nombre[50] = '\0';
+            actualizarPrompt(dfActual);
+            printf(GREEN "Nombre del dataframe cambiado a '%s'\n" RESET, dfActual->nombre);
+        } else if (strncmp(input, "prefix ", 7) == 0) {
+            char col[50], nueva_col[50];
+            int n = 0;
+            int parsed = sscanf(input + 7, "%49s n %49s", col, nueva_col);
+            char *ptr_n = strstr(input + 7, " n ");
+            if (parsed != 2 || !ptr_n) {
+                print_error("Uso: prefix <columna> n <nueva_columna>");
+                continue;
+            }
+            n = atoi(ptr_n + 3);
+            if (n <= 0) {
+                print_error("n debe ser un entero mayor que 0");
+                continue;
+            }
+            if (planActivo()) {
+                OperacionPlan op = {.tipo = OP_PLAN_PREFIX, .n = n};
+                snprintf(op.texto, sizeof(op.texto), "%s", col);
+                snprintf(op.nueva, sizeof(op.nueva), "%s", nueva_col);
+                apuntarOperacionCLI(&op);
+                continue;
+            }
+            prefixCLI(col, n, nueva_col);
+        } else if (strcmp(input, "materialize") == 0) {
+            if (!dfActual) {
+                print_error("No hay dataframe activo");
+            } else if (!dfActual->padre) {
+                printf(GREEN "El df ya está materializado\n" RESET);
+            } else if (materializarDF(dfActual)) {
+                printf(GREEN "df materializado: %" PRId64 " filas\n" RESET, dfActual->numFilas);
+            }
+        } else if (strncmp(input, "groupby ", 8) == 0) {
+            groupbyCLI(input + 8);
+        } else if (strncmp(input, "join ", 5) == 0) {
+            joinCLI(input + 5);
+        } else if (strncmp(input, "createindex ", 12) == 0) {
+            createindexCLI(input + 12);
+        } else if (strcmp(input, "lazy") == 0 || strcmp(input, "lazy on") == 0) {
+            lazyCLI(1);
+        } else if (strcmp(input, "lazy off") == 0) {
+            lazyCLI(0);
+        } else if (strcmp(input, "collect") == 0) {
+            if (!dfActual || !dfActual->plan)
+                print_error("El df no está en modo lazy (use 'lazy')");
+            else if (dfActual->plan->numOperaciones == 0)
+                printf(GREEN "No hay operaciones pendientes\n" RESET);
+            else
+                ejecutarPlanDFActual();
+        } else if (strcmp(input, "explain") == 0) {
+            if (planActivo())
+                explicarPlan(planActivo());
+            else
+                print_error("No hay plan: use 'lazy' o 'load --stream'");
+        } else if (strcmp(input, "list") == 0) {
+            listCLI();
+        } else {
+            // Intentar cambiar de dataframe por nombre
+            Nodo *actual = listaDF.primero;
+            while (actual) {
+                const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
+                if (strcmp(nombre_df, input) == 0) {
+                    cambiarDFPorNombre(&listaDF, input);
+                    return;
+                }
+                actual = actual->siguiente;
+            }
+            print_error("Comando no reconocido. Escriba un comando válido.");
+        }
+    }
+}
+
+OperadorFiltro parsearOperador(const char *operador) {
+    static const char *nombres[] = {"eq", "neq", "gt", "lt", "get", "let"};
+    for (int i = 0; i < OP_INVALIDO; i++) {
+        if (strcmp(operador, nombres[i]) == 0)
+            return (OperadorFiltro)i;
+    }
+    return OP_INVALIDO;
+}
+
+#define EPSILON_FILTRO 1e-10
+#define LIMITE_INT64 9223372036854775808.0 // 2^63
+
+// floor() sin depender de libm; a partir de 2^52 todo double ya es entero
+static double suelo(double x) {
+    if (isnan(x) || fabs(x) >= 4503599627370496.0)
+        return x;
+    double t = (double)(int64_t)x;
+    return t > x ? t - 1 : t;
+}
+
+static double techo(double x) { return -suelo(-x); }
+
+static int64_t acotarEntero(double x) {
+    if (x <= -LIMITE_INT64)
+        return INT64_MIN;
+    if (x >= LIMITE_INT64)
+        return INT64_MAX;
+    return (int64_t)x;
+}
+
+// Primera posición del diccionario con un valor >= 'valor' (> si 'estricto')
+static int64_t buscarEnDiccionario(const Diccionario *dic, const char *valor, int estricto) {
+    int64_t izq = 0, der = dic->numValores;
+    while (izq < der) {
+        int64_t medio = izq + (der - izq) / 2;
+        int cmp = strcmp(dic->valores[medio], valor);
+        if (cmp < 0 || (estricto && cmp == 0))
+            izq = medio + 1;
+        else
+            der = medio;
+    }
+    return izq;
+}
+
+// Con el diccionario ordenado, comparar con una cadena equivale a comprobar
+// si el código cae en un rango
+static void compilarRangoCategoria(Predicado *pred) {
+    const Diccionario *dic = pred->col->dic;
+    int64_t desde = buscarEnDiccionario(dic, pred->texto, 0);
+    int64_t hasta = buscarEnDiccionario(dic, pred->texto, 1);
+    int64_t minimo = 0, maximo = dic->numValores - 1;
+    switch (pred->op) {
+    case OP_GT:
+        minimo = hasta;
+        break;
+    case OP_GET:
+        minimo = desde;
+        break;
+    case OP_LT:
+        maximo = desde - 1;
+        break;
+    case OP_LET:
+        maximo = hasta - 1;
+        break;
+    case OP_EQ:
+    case OP_NEQ:
+    default:
+        minimo = desde;
+        maximo = hasta - 1;
+        pred->negado = pred->op == OP_NEQ;
+        break;
+    }
+    pred->minimo = minimo;
+    pred->maximo = maximo;
+    pred->vacio = minimo > maximo;
+}
+
+// Convierte operador y constante una sola vez. En columnas enteras la
+// comparación contra un double se traduce a un rango cerrado de enteros.
+int compilarPredicado(Predicado *pred, const Columna *col, OperadorFiltro op, const char *valor) {
+    memset(pred, 0, sizeof(*pred));
+    pred->col = col;
+    pred->op = op;
+    pred->texto = valor;
+    if (op == OP_INVALIDO) {
+        print_error("Operador inválido. Use: eq, neq, gt, lt, get, let");
+        return 0;
+    }
+    if (col->formato == FMT_TEXTO)
+        return 1;
+    if (ES_CATEGORIA(col->formato)) {
+        compilarRangoCategoria(pred);
+        return 1;
+    }
+    if (col->formato == FMT_FECHA) {
+        if (!parsearFecha(valor, &pred->fecha)) {
+            print_error("El valor debe ser una fecha AAAA-MM-DD para esta columna");
+            return 0;
+        }
+        return 1;
+    }
+    if (!parsearReal(valor, &pred->real)) {
+        print_error("El valor debe ser numérico para esta columna");
+        return 0;
+    }
+    if (col->formato == FMT_REAL)
+        return 1;
+
+    double c = pred->real, minimo = -LIMITE_INT64, maximo = LIMITE_INT64;
+    switch (op) {
+    case OP_GT:
+        minimo = suelo(c) + 1;
+        break;
+    case OP_GET:
+        minimo = techo(c);
+        break;
+    case OP_LT:
+        maximo = techo(c) - 1;
+        break;
+    case OP_LET:
+        maximo = suelo(c);
+        break;
+    case OP_EQ:
+    case OP_NEQ:
+    default:
+        minimo = techo(c - EPSILON_FILTRO);
+        maximo = suelo(c + EPSILON_FILTRO);
+        pred->negado = op == OP_NEQ;
+        break;
+    }
+    // Con NaN ninguna comparación se cumple, ni siquiera neq
+    if (isnan(c))
+        pred->negado = 0;
+    pred->vacio = isnan(c) || minimo > maximo;
+    pred->minimo = acotarEntero(minimo);
+    pred->maximo = acotarEntero(maximo);
+    return 1;
+}
+
+#define MARCAR_FILA(seleccion, i, cumple) ((seleccion)[(i) >> 6] |= (uint64_t)(cumple) << ((i) & 63))
+
+#define BUCLE_ESCALAR(condicion)                                                                   \
+    for (int64_t i = inicio; i < fin; i++)                                                         \
+    MARCAR_FILA(seleccion, i, condicion)
+
+static void kernelRealEscalar(const double *v, int64_t inicio, int64_t fin, OperadorFiltro op,
+                              double c, uint64_t *seleccion) {
+    switch (op) {
+    case OP_EQ:
+        BUCLE_ESCALAR(fabs(v[i] - c) < EPSILON_FILTRO);
+        break;
+    case OP_NEQ:
+        BUCLE_ESCALAR(fabs(v[i] - c) >= EPSILON_FILTRO);
+        break;
+    case OP_GT:
+        BUCLE_ESCALAR(v[i] > c);
+        break;
+    case OP_LT:
+        BUCLE_ESCALAR(v[i] < c);
+        break;
+    case OP_GET:
+        BUCLE_ESCALAR(v[i] >= c);
+        break;
+    case OP_LET:
+        BUCLE_ESCALAR(v[i] <= c);
+        break;
+    default:
+        break;
+    }
+}
+
+static void kernelFechaEscalar(const int32_t *v, int64_t inicio, int64_t fin, OperadorFiltro op,
+                               int32_t c, uint64_t *seleccion) {
+    switch (op) {
+    case OP_EQ:
+        BUCLE_ESCALAR(v[i] == c);
+        break;
+    case OP_NEQ:
+        BUCLE_ESCALAR(v[i] != c);
+        break;
+    case OP_GT:
+        BUCLE_ESCALAR(v[i] > c);
+        break;
+    case OP_LT:
+        BUCLE_ESCALAR(v[i] < c);
+        break;
+    case OP_GET:
+        BUCLE_ESCALAR(v[i] >= c);
+        break;
+    case OP_LET:
+        BUCLE_ESCALAR(v[i] <= c);
+        break;
+    default:
+        break;
+    }
+}
+
+static void kernelEnteroEscalar(const int64_t *v, int64_t inicio, int64_t fin,
+                                const Predicado *pred, uint64_t *seleccion) {
+    int64_t minimo = pred->minimo, maximo = pred->maximo;
+    int negado = pred->negado, vacio = pred->vacio;
+    BUCLE_ESCALAR((!vacio && v[i] >= minimo && v[i] <= maximo) != negado);
+}
+
+static void kernelCategoriaEscalar(const Columna *col, int64_t inicio, int64_t fin,
+                                   const Predicado *pred, uint64_t *seleccion) {
+    int64_t minimo = pred->minimo, maximo = pred->maximo;
+    int negado = pred->negado, vacio = pred->vacio;
+    if (col->formato == FMT_CATEGORIA8) {
+        const uint8_t *v = col->codigos8;
+        BUCLE_ESCALAR((!vacio && v[i] >= minimo && v[i] <= maximo) != negado);
+    } else {
+        const uint16_t *v = col->codigos16;
+        BUCLE_ESCALAR((!vacio && v[i] >= minimo && v[i] <= maximo) != negado);
+    }
+}
+
+static int cumpleOrden(int cmp, OperadorFiltro op) {
+    switch (op) {
+    case OP_EQ:
+        return cmp == 0;
+    case OP_NEQ:
+        return cmp != 0;
+    case OP_GT:
+        return cmp > 0;
+    case OP_LT:
+        return cmp < 0;
+    case OP_GET:
+        return cmp >= 0;
+    case OP_LET:
+        return cmp <= 0;
+    default:
+        return 0;
+    }
+}
+
+static void kernelTexto(const Columna *col, int64_t inicio, int64_t fin, const Predicado *pred,
+                        uint64_t *seleccion) {
+    for (int64_t i = inicio; i < fin; i++) {
+        if (!ES_NULO(col, i) && col->datos[i])
+            MARCAR_FILA(seleccion, i, cumpleOrden(strcmp(col->datos[i], pred->texto), pred->op));
+    }
+}
+
+#ifdef USAR_AVX2
+// Los kernels AVX2 procesan bloques completos (4 u 8 filas, que nunca cruzan
+// una palabra del bitmap) y devuelven hasta dónde llegaron; el resto lo
+// termina el kernel escalar
+#define BUCLE_AVX2(ancho, carga, mascara, invertir)                                                \
+    for (; i + (ancho) <= fin; i += (ancho)) {                                                     \
+        carga;                                                                                     \
+        seleccion[i >> 6] |= ((uint64_t)(mascara) ^ (invertir)) << (i & 63);                       \
+    }
+
+__attribute__((target("avx2"))) static int64_t
+kernelRealAVX2(const double *v, int64_t inicio, int64_t fin, OperadorFiltro op, double c,
+               uint64_t *seleccion) {
+    const __m256d vc = _mm256_set1_pd(c), eps = _mm256_set1_pd(EPSILON_FILTRO);
+    const __m256d signo = _mm256_set1_pd(-0.0);
+    int64_t i = inicio;
+#define CARGA_REAL __m256d x = _mm256_loadu_pd(v + i)
+#define DISTANCIA_REAL _mm256_andnot_pd(signo, _mm256_sub_pd(x, vc))
+    switch (op) {
+    case OP_EQ:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(DISTANCIA_REAL, eps, _CMP_LT_OQ)), 0);
+        break;
+    case OP_NEQ:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(DISTANCIA_REAL, eps, _CMP_GE_OQ)), 0);
+        break;
+    case OP_GT:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(x, vc, _CMP_GT_OQ)), 0);
+        break;
+    case OP_LT:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(x, vc, _CMP_LT_OQ)), 0);
+        break;
+    case OP_GET:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(x, vc, _CMP_GE_OQ)), 0);
+        break;
+    case OP_LET:
+        BUCLE_AVX2(4, CARGA_REAL, _mm256_movemask_pd(_mm256_cmp_pd(x, vc, _CMP_LE_OQ)), 0);
+        break;
+    default:
+        break;
+    }
+#undef CARGA_REAL
+#undef DISTANCIA_REAL
+    return i;
+}
+
+__attribute__((target("avx2"))) static int64_t
+kernelFechaAVX2(const int32_t *v, int64_t inicio, int64_t fin, OperadorFiltro op, int32_t c,
+                uint64_t *seleccion) {
+    const __m256i vc = _mm256_set1_epi32(c);
+    int64_t i = inicio;
+#define CARGA_FECHA __m256i x = _mm256_loadu_si256((const __m256i *)(v + i))
+#define BITS_FECHA(m) _mm256_movemask_ps(_mm256_castsi256_ps(m))
+    switch (op) {
+    case OP_EQ:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpeq_epi32(x, vc)), 0);
+        break;
+    case OP_NEQ:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpeq_epi32(x, vc)), 0xFF);
+        break;
+    case OP_GT:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpgt_epi32(x, vc)), 0);
+        break;
+    case OP_LT:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpgt_epi32(vc, x)), 0);
+        break;
+    case OP_GET:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpgt_epi32(vc, x)), 0xFF);
+        break;
+    case OP_LET:
+        BUCLE_AVX2(8, CARGA_FECHA, BITS_FECHA(_mm256_cmpgt_epi32(x, vc)), 0xFF);
+        break;
+    default:
+        break;
+    }
+#undef CARGA_FECHA
+#undef BITS_FECHA
+    return i;
+}
+
+__attribute__((target("avx2"))) static int64_t kernelEnteroAVX2(const int64_t *v, int64_t inicio,
+                                                                int64_t fin, const Predicado *pred,
+                                                                uint64_t *seleccion) {
+    if (pred->vacio)
+        return inicio;
+    const __m256i vmin = _mm256_set1_epi64x(pred->minimo), vmax = _mm256_set1_epi64x(pred->maximo);
+    // La máscara marca las filas fuera del rango; se invierte salvo para neq
+    const uint64_t invertir = pred->negado ? 0 : 0xF;
+    int64_t i = inicio;
+    BUCLE_AVX2(4, __m256i x = _mm256_loadu_si256((const __m256i *)(v + i)),
+               _mm256_movemask_pd(_mm256_castsi256_pd(
+                   _mm256_or_si256(_mm256_cmpgt_epi64(vmin, x), _mm256_cmpgt_epi64(x, vmax)))),
+               invertir);
+    return i;
+}
+
+// Códigos de 8 bits: 32 filas por instrucción; v está en el rango si
+// max(v, minimo) == v y min(v, maximo) == v (comparación sin signo)
+__attribute__((target("avx2"))) static int64_t
+kernelCategoria8AVX2(const uint8_t *v, int64_t inicio, int64_t fin, const Predicado *pred,
+                     uint64_t *seleccion) {
+    if (pred->vacio)
+        return inicio;
+    const __m256i vmin = _mm256_set1_epi8((char)pred->minimo);
+    const __m256i vmax = _mm256_set1_epi8((char)pred->maximo);
+    const uint64_t invertir = pred->negado ? 0xFFFFFFFFULL : 0;
+    int64_t i = inicio;
+    BUCLE_AVX2(32, __m256i x = _mm256_loadu_si256((const __m256i *)(v + i)),
+               (uint32_t)_mm256_movemask_epi8(
+                   _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, vmin), x),
+                                    _mm256_cmpeq_epi8(_mm256_min_epu8(x, vmax), x))),
+               invertir);
+    return i;
+}
+#endif
+
+// Evalúa el predicado sobre las filas [inicio, fin); 'inicio' es múltiplo de 64
+static void evaluarTramo(const Predicado *pred, int64_t inicio, int64_t fin, uint64_t *seleccion) {
+    const Columna *col = pred->col;
+    int avx2 = 0;
+#ifdef USAR_AVX2
+    avx2 = tieneAVX2();
+#endif
+    switch (col->formato) {
+    case FMT_REAL:
+#ifdef USAR_AVX2
+        if (avx2)
+            inicio = kernelRealAVX2(col->reales, inicio, fin, pred->op, pred->real, seleccion);
+#endif
+        kernelRealEscalar(col->reales, inicio, fin, pred->op, pred->real, seleccion);
+        break;
+    case FMT_FECHA:
+#ifdef USAR_AVX2
+        if (avx2)
+            inicio = kernelFechaAVX2(col->fechas, inicio, fin, pred->op, pred->fecha, seleccion);
+#endif
+        kernelFechaEscalar(col->fechas, inicio, fin, pred->op, pred->fecha, seleccion);
+        break;
+    case FMT_ENTERO:
+#ifdef USAR_AVX2
+        if (avx2)
+            inicio = kernelEnteroAVX2(col->enteros, inicio, fin, pred, seleccion);
+#endif
+        kernelEnteroEscalar(col->enteros, inicio, fin, pred, seleccion);
+        break;
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+#ifdef USAR_AVX2
+        if (avx2 && col->formato == FMT_CATEGORIA8)
+            inicio = kernelCategoria8AVX2(col->codigos8, inicio, fin, pred, seleccion);
+#endif
+        kernelCategoriaEscalar(col, inicio, fin, pred, seleccion);
+        break;
+    case FMT_TEXTO:
+    default:
+        kernelTexto(col, inicio, fin, pred, seleccion);
+        break;
+    }
+    (void)avx2;
+}
+
+// Rellena 'seleccion' (un bit por fila, ceil(numFilas/64) palabras) con las
+// filas que cumplen el predicado y devuelve cuántas son. Si hay 'mascara',
+// solo se evalúan las palabras con algún bit activo en ella y el resultado
+// queda limitado a esos bits. Si las estadísticas de la columna descartan la
+// constante no se mira ninguna fila.
+int64_t evaluarPredicadoMascara(const Predicado *pred, int64_t numFilas, const uint64_t *mascara,
+                                uint64_t *seleccion) {
+    if (descartadoPorEstadisticas(pred)) {
+        memset(seleccion, 0, PALABRAS_BITMAP(numFilas) * sizeof(uint64_t));
+        return 0;
+    }
+    int64_t conIndice = evaluarConIndice(pred, numFilas, mascara, seleccion);
+    if (conIndice >= 0)
+        return conIndice;
+
+    const Columna *col = pred->col;
+    int64_t palabras = (numFilas + 63) / 64;
+    memset(seleccion, 0, (size_t)palabras * sizeof(uint64_t));
+
+    int64_t total = 0;
+    for (int64_t w = 0; w < palabras;) {
+        if (mascara && mascara[w] == 0) {
+            w++;
+            continue;
+        }
+        // Tramo de palabras consecutivas con filas por decidir
+        int64_t finTramo = w + 1;
+        while (finTramo < palabras && (!mascara || mascara[finTramo] != 0))
+            finTramo++;
+        int64_t inicio = w * 64, fin = finTramo * 64 < numFilas ? finTramo * 64 : numFilas;
+        evaluarTramo(pred, inicio, fin, seleccion);
+
+        // Los nulos nunca cumplen la condición
+        for (; w < finTramo; w++) {
+            seleccion[w] &= col->validos[w];
+            if (mascara)
+                seleccion[w] &= mascara[w];
+            total += __builtin_popcountll(seleccion[w]);
+        }
+    }
+    return total;
+}
+
+#define BIT_ACTIVO(seleccion, i) (((seleccion)[(i) >> 6] >> ((i) & 63)) & 1)
+
+// Filas lógicas de df cuyo bit está activo en 'seleccion' (un bitmap sobre
+// las filas de las columnas, es decir, del padre si df es una vista)
+static int64_t contarSeleccion(const Dataframe *df, const uint64_t *seleccion) {
+    int64_t total = 0;
+    for (int64_t i = 0; i < df->numFilas; i++)
+        total += BIT_ACTIVO(seleccion, FILA_FISICA(df, i));
+    return total;
+}
+
+// Deja en df solo las filas seleccionadas sin copiar datos: un df normal pasa
+// a ser una vista de sí mismo y una vista compacta su vector de filas
+static int restringirVista(Dataframe *df, const uint64_t *seleccion, int64_t total) {
+    if (df->padre) {
+        int64_t k = 0;
+        for (int64_t i = 0; i < df->numFilas; i++) {
+            if (BIT_ACTIVO(seleccion, df->filas[i]))
+                df->filas[k++] = df->filas[i];
+        }
+        restringirEstadisticas(df, NULL, k);
+        df->numFilas = k;
+        return 1;
+    }
+
+    int64_t *filas = malloc((size_t)(total > 0 ? total : 1) * sizeof(int64_t));
+    Dataframe *padre = malloc(sizeof(Dataframe));
+    if (!filas || !padre) {
+        free(filas);
+        free(padre);
+        return 0;
+    }
+    int64_t k = 0;
+    for (int64_t w = 0; w < (df->numFilas + 63) / 64; w++) {
+        for (uint64_t bits = seleccion[w]; bits; bits &= bits - 1)
+            filas[k++] = w * 64 + __builtin_ctzll(bits);
+    }
+    restringirEstadisticas(df, seleccion, k);
+    *padre = *df;
+    padre->plan = NULL;
+    df->padre = padre;
+    df->filas = filas;
+    df->numFilas = k;
+    return 1;
+}
+
+// --- Expresiones de filter ---------------------------------------------------
+// Gramática:  expr   := term (OR term)*
+//             term   := factor (AND factor)*
+//             factor := NOT factor | '(' expr ')' | <columna> <op> <valor>
+// AND, OR y NOT no distinguen mayúsculas.
+
+#define MAX_TOKENS_FILTRO 256
+#define MUESTRAS_SELECTIVIDAD 1024
+
+typedef struct {
+    ExprFiltro *expr;
+    Dataframe *df;
+    char *tokens[MAX_TOKENS_FILTRO];
+    int numTokens;
+    int pos;
+} ParserFiltro;
+
+static const char *tokenActual(const ParserFiltro *p) {
+    return p->pos < p->numTokens ? p->tokens[p->pos] : NULL;
+}
+
+static int esPalabra(const char *tok, const char *palabra) {
+    return tok && strcasecmp(tok, palabra) == 0;
+}
+
+static int esParentesis(const char *tok) {
+    return tok && (strcmp(tok, "(") == 0 || strcmp(tok, ")") == 0);
+}
+
+// Trocea la expresión en expr->tokens: los paréntesis son tokens propios aunque
+// vayan pegados a un nombre o a un valor
+static int trocearExpresion(ParserFiltro *p, const char *texto) {
+    char *destino = p->expr->tokens;
+    char *limite = p->expr->tokens + sizeof(p->expr->tokens) - 2;
+    p->numTokens = 0;
+    while (*texto) {
+        if (isspace((unsigned char)*texto)) {
+            texto++;
+            continue;
+        }
+        if (p->numTokens == MAX_TOKENS_FILTRO || destino >= limite) {
+            print_error("Expresión de filtro demasiado larga");
+            return 0;
+        }
+        p->tokens[p->numTokens++] = destino;
+        if (*texto == '(' || *texto == ')') {
+            *destino++ = *texto++;
+        } else {
+            while (*texto && !isspace((unsigned char)*texto) && *texto != '(' && *texto != ')' &&
+                   destino < limite)
+                *destino++ = *texto++;
+        }
+        *destino++ = '\0';
+    }
+    return 1;
+}
+
+static int nuevoNodo(ParserFiltro *p, TipoNodoFiltro tipo) {
+    ExprFiltro *e = p->expr;
+    if (e->numNodos == MAX_NODOS_FILTRO) {
+        print_error("Expresión de filtro demasiado larga");
+        return -1;
+    }
+    NodoFiltro *nodo = &e->nodos[e->numNodos];
+    memset(nodo, 0, sizeof(*nodo));
+    nodo->tipo = tipo;
+    nodo->primerHijo = -1;
+    nodo->siguiente = -1;
+    return e->numNodos++;
+}
+
+static void agregarOperando(ExprFiltro *e, int nodo, int hijo) {
+    int *enlace = &e->nodos[nodo].primerHijo;
+    while (*enlace != -1)
+        enlace = &e->nodos[*enlace].siguiente;
+    *enlace = hijo;
+}
+
+static int parsearOr(ParserFiltro *p);
+
+static int parsearFactor(ParserFiltro *p) {
+    const char *tok = tokenActual(p);
+    if (!tok) {
+        print_error("Expresión de filtro incompleta");
+        return -1;
+    }
+    if (esPalabra(tok, "NOT")) {
+        p->pos++;
+        int hijo = parsearFactor(p);
+        int nodo = hijo < 0 ? -1 : nuevoNodo(p, NODO_NOT);
+        if (nodo >= 0)
+            agregarOperando(p->expr, nodo, hijo);
+        return nodo;
+    }
+    if (strcmp(tok, "(") == 0) {
+        p->pos++;
+        int nodo = parsearOr(p);
+        if (nodo < 0)
+            return -1;
+        if (!tokenActual(p) || strcmp(tokenActual(p), ")") != 0) {
+            print_error("Falta ')' en la expresión de filtro");
+            return -1;
+        }
+        p->pos++;
+        return nodo;
+    }
+
+    // Cláusula simple: <columna> <op> <valor>
+    if (p->pos + 2 >= p->numTokens || esParentesis(tok) || esParentesis(p->tokens[p->pos + 1]) ||
+        esParentesis(p->tokens[p->pos + 2])) {
+        print_error("Cláusula de filtro inválida. Use: <columna> <op> <valor>");
+        return -1;
+    }
+    int indice_col = encontrarIndiceColumna(p->df, tok);
+    if (indice_col == -1) {
+        print_error("Columna no encontrada");
+        return -1;
+    }
+    int nodo = nuevoNodo(p, NODO_CLAUSULA);
+    if (nodo < 0)
+        return -1;
+    if (!compilarPredicado(&p->expr->nodos[nodo].pred, &p->df->columnas[indice_col],
+                           parsearOperador(p->tokens[p->pos + 1]), p->tokens[p->pos + 2]))
+        return -1;
+    p->pos += 3;
+    return nodo;
+}
+
+// AND y OR encadenados se guardan como un único nodo con varios operandos
+static int parsearBinario(ParserFiltro *p, TipoNodoFiltro tipo, const char *palabra,
+                          int (*operando)(ParserFiltro *)) {
+    int izq = operando(p);
+    if (izq < 0 || !esPalabra(tokenActual(p), palabra))
+        return izq;
+    int nodo = nuevoNodo(p, tipo);
+    if (nodo < 0)
+        return -1;
+    agregarOperando(p->expr, nodo, izq);
+    while (esPalabra(tokenActual(p), palabra)) {
+        p->pos++;
+        int der = operando(p);
+        if (der < 0)
+            return -1;
+        agregarOperando(p->expr, nodo, der);
+    }
+    return nodo;
+}
+
+static int parsearAnd(ParserFiltro *p) { return parsearBinario(p, NODO_AND, "AND", parsearFactor); }
+
+static int parsearOr(ParserFiltro *p) { return parsearBinario(p, NODO_OR, "OR", parsearAnd); }
+
+// Evalúa una cláusula sobre una sola fila (para estimar selectividades)
+static int cumpleFila(const Predicado *pred, int64_t fila) {
+    const Columna *col = pred->col;
+    if (ES_NULO(col, fila))
+        return 0;
+    switch (col->formato) {
+    case FMT_ENTERO: {
+        int64_t v = col->enteros[fila];
+        return (!pred->vacio && v >= pred->minimo && v <= pred->maximo) != pred->negado;
+    }
+    case FMT_REAL: {
+        double d = col->reales[fila] - pred->real;
+        if (isnan(d))
+            return 0;
+        if (pred->op == OP_EQ)
+            return fabs(d) < EPSILON_FILTRO;
+        if (pred->op == OP_NEQ)
+            return fabs(d) >= EPSILON_FILTRO;
+        return cumpleOrden((d > 0) - (d < 0), pred->op);
+    }
+    case FMT_FECHA: {
+        int32_t v = col->fechas[fila];
+        return cumpleOrden((v > pred->fecha) - (v < pred->fecha), pred->op);
+    }
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16: {
+        int64_t v = codigoCelda(col, fila);
+        return (!pred->vacio && v >= pred->minimo && v <= pred->maximo) != pred->negado;
+    }
+    case FMT_TEXTO:
+    default:
+        return col->datos[fila] && cumpleOrden(strcmp(col->datos[fila], pred->texto), pred->op);
+    }
+}
+
+// Selectividad de cada nodo: las cláusulas se miden sobre una muestra
+// repartida por todo el df y los nodos compuestos suponen independencia
+static double estimarSelectividad(ExprFiltro *e, int nodo, const int64_t *muestra,
+                                  int64_t numMuestras) {
+    NodoFiltro *n = &e->nodos[nodo];
+    double s;
+    switch (n->tipo) {
+    case NODO_CLAUSULA: {
+        // Una cláusula que las estadísticas descartan va la primera en los AND
+        if (descartadoPorEstadisticas(&n->pred)) {
+            s = 0.0;
+            break;
+        }
+        int64_t cumplen = 0;
+        for (int64_t i = 0; i < numMuestras; i++)
+            cumplen += cumpleFila(&n->pred, muestra[i]);
+        s = numMuestras > 0 ? (double)cumplen / (double)numMuestras : 0.5;
+        break;
+    }
+    case NODO_NOT:
+        s = 1.0 - estimarSelectividad(e, n->primerHijo, muestra, numMuestras);
+        break;
+    case NODO_AND:
+        s = 1.0;
+        for (int h = n->primerHijo; h != -1; h = e->nodos[h].siguiente)
+            s *= estimarSelectividad(e, h, muestra, numMuestras);
+        break;
+    case NODO_OR:
+    default: {
+        double ninguno = 1.0;
+        for (int h = n->primerHijo; h != -1; h = e->nodos[h].siguiente)
+            ninguno *= 1.0 - estimarSelectividad(e, h, muestra, numMuestras);
+        s = 1.0 - ninguno;
+        break;
+    }
+    }
+    n->selectividad = s;
+    return s;
+}
+
+int compilarExprFiltro(ExprFiltro *expr, Dataframe *df, const char *texto) {
+    ParserFiltro p = {0};
+    p.expr = expr;
+    p.df = df;
+    expr->numNodos = 0;
+    expr->raiz = -1;
+    if (!trocearExpresion(&p, texto))
+        return 0;
+    if (p.numTokens == 0) {
+        print_error("Uso: filter <columna> <op> <valor> [AND|OR [NOT] <columna> <op> <valor>] ...");
+        return 0;
+    }
+    expr->raiz = parsearOr(&p);
+    if (expr->raiz < 0)
+        return 0;
+    if (p.pos != p.numTokens) {
+        print_error("Texto inesperado tras la expresión de filtro");
+        return 0;
+    }
+
+    int64_t muestra[MUESTRAS_SELECTIVIDAD];
+    int64_t numMuestras = df->numFilas < MUESTRAS_SELECTIVIDAD ? df->numFilas : MUESTRAS_SELECTIVIDAD;
+    for (int64_t i = 0; i < numMuestras; i++)
+        muestra[i] = FILA_FISICA(df, i * df->numFilas / numMuestras);
+    estimarSelectividad(expr, expr->raiz, muestra, numMuestras);
+    return 1;
+}
+
+static int palabrasVacias(const uint64_t *bits, int64_t palabras) {
+    for (int64_t w = 0; w < palabras; w++) {
+        if (bits[w])
+            return 0;
+    }
+    return 1;
+}
+
+// Operandos de un AND/OR ordenados por selectividad: ascendente para AND (el
+// más selectivo descarta antes) y descendente para OR (el más probable decide antes)
+static int operandosOrdenados(const ExprFiltro *e, int nodo, int *hijos) {
+    int n = 0;
+    int descendente = e->nodos[nodo].tipo == NODO_OR;
+    for (int h = e->nodos[nodo].primerHijo; h != -1; h = e->nodos[h].siguiente) {
+        int j = n++;
+        while (j > 0 && (descendente ? e->nodos[hijos[j - 1]].selectividad < e->nodos[h].selectividad
+                                     : e->nodos[hijos[j - 1]].selectividad > e->nodos[h].selectividad)) {
+            hijos[j] = hijos[j - 1];
+            j--;
+        }
+        hijos[j] = h;
+    }
+    return n;
+}
+
+// Calcula en 'falso' las filas de 'mascara' con valor que no cumplen la
+// cláusula. Las celdas nulas no son ni una cosa ni otra, y en FMT_REAL y
+// FMT_TEXTO tampoco los NaN ni las cadenas ausentes: ahí se evalúa la
+// cláusula con el operador contrario.
+static void evaluarClausulaFalsa(const Predicado *pred, int64_t numFilas, const uint64_t *mascara,
+                                 const uint64_t *cierto, uint64_t *falso) {
+    static const OperadorFiltro opuesto[] = {OP_NEQ, OP_EQ, OP_LET, OP_GET, OP_LT, OP_GT};
+    const Columna *col = pred->col;
+    if (col->formato == FMT_REAL || col->formato == FMT_TEXTO) {
+        Predicado contrario = *pred;
+        contrario.op = opuesto[pred->op];
+        evaluarPredicadoMascara(&contrario, numFilas, mascara, falso);
+        return;
+    }
+    // Comparando con NaN no se cumple nada, tampoco lo contrario
+    int nan = col->formato == FMT_ENTERO && isnan(pred->real);
+    for (int64_t w = 0; w < (numFilas + 63) / 64; w++)
+        falso[w] = nan ? 0 : mascara[w] & col->validos[w] & ~cierto[w];
+}
+
+// Calcula en 'res' las filas de 'mascara' que cumplen el nodo y, si 'falso' no
+// es NULL, en 'falso' las que lo incumplen. Con una celda nula la cláusula no
+// es ni cierta ni falsa: NOT intercambia ambos bitmaps y esas filas siguen
+// fuera. Cada operando solo se evalúa en las palabras cuyas filas siguen sin decidir.
+static int evaluarNodoFiltro(const ExprFiltro *e, int nodo, int64_t numFilas,
+                             const uint64_t *mascara, uint64_t *res, uint64_t *falso) {
+    const NodoFiltro *n = &e->nodos[nodo];
+    int64_t palabras = (numFilas + 63) / 64;
+    size_t bytes = (size_t)(palabras > 0 ? palabras : 1) * sizeof(uint64_t);
+
+    if (n->tipo == NODO_CLAUSULA) {
+        evaluarPredicadoMascara(&n->pred, numFilas, mascara, res);
+        if (falso)
+            evaluarClausulaFalsa(&n->pred, numFilas, mascara, res, falso);
+        return 1;
+    }
+    if (n->tipo == NODO_NOT) {
+        // Lo que incumple el operando cumple el NOT y al revés
+        uint64_t *cierto = falso ? falso : malloc(bytes);
+        if (!cierto)
+            return 0;
+        int ok = evaluarNodoFiltro(e, n->primerHijo, numFilas, mascara, cierto, res);
+        if (!falso)
+            free(cierto);
+        return ok;
+    }
+
+    int hijos[MAX_NODOS_FILTRO];
+    int numHijos = operandosOrdenados(e, nodo, hijos);
+    uint64_t *parcial = malloc(bytes);
+    uint64_t *parcialFalso = falso ? malloc(bytes) : NULL;
+    uint64_t *pendiente = n->tipo == NODO_OR || falso ? malloc(bytes) : NULL;
+    if (!parcial || (falso && !parcialFalso) || ((n->tipo == NODO_OR || falso) && !pendiente)) {
+        free(parcial);
+        free(parcialFalso);
+        free(pendiente);
+        return 0;
+    }
+
+    int ok = 1;
+    if (n->tipo == NODO_AND) {
+        // 'res' guarda las filas que aún pueden cumplir todos los operandos y
+        // 'falso' las que ya incumplen alguno. Si hace falta 'falso', se sigue
+        // evaluando en 'pendiente' todo lo que no es falso todavía.
+        uint64_t *evaluar = falso ? pendiente : res;
+        memcpy(res, mascara, (size_t)palabras * sizeof(uint64_t));
+        if (falso) {
+            memcpy(pendiente, mascara, (size_t)palabras * sizeof(uint64_t));
+            memset(falso, 0, (size_t)palabras * sizeof(uint64_t));
+        }
+        for (int i = 0; ok && i < numHijos && !palabrasVacias(evaluar, palabras); i++) {
+            ok = evaluarNodoFiltro(e, hijos[i], numFilas, evaluar, parcial, parcialFalso);
+            for (int64_t w = 0; ok && w < palabras; w++) {
+                res[w] &= parcial[w];
+                if (falso) {
+                    falso[w] |= parcialFalso[w];
+                    pendiente[w] &= ~parcialFalso[w];
+                }
+            }
+        }
+    } else {
+        // 'pendiente' guarda las filas que todavía no cumplen ningún operando y
+        // 'falso' las que incumplen todos los evaluados
+        memcpy(pendiente, mascara, (size_t)palabras * sizeof(uint64_t));
+        memset(res, 0, (size_t)palabras * sizeof(uint64_t));
+        if (falso)
+            memcpy(falso, mascara, (size_t)palabras * sizeof(uint64_t));
+        for (int i = 0; ok && i < numHijos && !palabrasVacias(pendiente, palabras); i++) {
+            ok = evaluarNodoFiltro(e, hijos[i], numFilas, pendiente, parcial, parcialFalso);
+            for (int64_t w = 0; ok && w < palabras; w++) {
+                res[w] |= parcial[w];
+                if (falso)
+                    falso[w] &= parcialFalso[w] | ~pendiente[w];
+                pendiente[w] &= ~parcial[w];
+            }
+        }
+    }
+    free(parcial);
+    free(parcialFalso);
+    free(pendiente);
+    return ok;
+}
+
+// 1 si las estadísticas de las columnas aseguran que ninguna fila cumple el nodo
+static int nodoDescartado(const ExprFiltro *e, int nodo) {
+    const NodoFiltro *n = &e->nodos[nodo];
+    switch (n->tipo) {
+    case NODO_CLAUSULA:
+        return descartadoPorEstadisticas(&n->pred);
+    case NODO_AND:
+        for (int h = n->primerHijo; h != -1; h = e->nodos[h].siguiente) {
+            if (nodoDescartado(e, h))
+                return 1;
+        }
+        return 0;
+    case NODO_OR:
+        for (int h = n->primerHijo; h != -1; h = e->nodos[h].siguiente) {
+            if (!nodoDescartado(e, h))
+                return 0;
+        }
+        return 1;
+    case NODO_NOT:
+    default:
+        return 0;
+    }
+}
+
+// Evalúa la expresión sobre las filas marcadas en 'mascara' y devuelve cuántas
+// la cumplen, o -1 si falta memoria
+int64_t evaluarExprFiltro(const ExprFiltro *expr, int64_t numFilas, const uint64_t *mascara,
+                          uint64_t *seleccion) {
+    if (!evaluarNodoFiltro(expr, expr->raiz, numFilas, mascara, seleccion, NULL))
+        return -1;
+    int64_t total = 0;
+    for (int64_t w = 0; w < (numFilas + 63) / 64; w++)
+        total += __builtin_popcountll(seleccion[w]);
+    return total;
+}
+
+// Deja en 'df' (como vista) las filas que cumplen la expresión. Devuelve
+// cuántas quedan; con 0 el df no cambia y con -1 hubo un error, ya mostrado.
+int64_t filtrarDF(Dataframe *df, const char *expresion) {
+    ExprFiltro *expr = malloc(sizeof(ExprFiltro));
+    if (!expr) {
+        print_error("Error de memoria en filter");
+        return -1;
+    }
+    if (!compilarExprFiltro(expr, df, expresion)) {
+        free(expr);
+        return -1;
+    }
+    // Sin filas posibles no hace falta ni preparar la máscara
+    if (nodoDescartado(expr, expr->raiz)) {
+        free(expr);
+        return 0;
+    }
+
+    // En una vista la expresión se evalúa sobre las columnas del padre, solo
+    // en las filas que siguen en la vista
+    int64_t filasBase = df->padre ? df->padre->numFilas : df->numFilas;
+    size_t palabras = (size_t)((filasBase + 63) / 64 + 1);
+    uint64_t *mascara = calloc(palabras, sizeof(uint64_t));
+    uint64_t *seleccion = calloc(palabras, sizeof(uint64_t));
+    int64_t nuevas_filas = -1;
+    if (mascara && seleccion) {
+        for (int64_t i = 0; i < df->numFilas; i++)
+            MARCAR_FILA(mascara, FILA_FISICA(df, i), 1);
+        nuevas_filas = evaluarExprFiltro(expr, filasBase, mascara, seleccion);
+    }
+    free(mascara);
+    free(expr);
+    if (nuevas_filas > 0 && !restringirVista(df, seleccion, nuevas_filas))
+        nuevas_filas = -1;
+    free(seleccion);
+    if (nuevas_filas < 0)
+        print_error("Error de memoria en filter");
+    return nuevas_filas;
+}
+
+// Aplica a df una serie de filter y delnull seguidos en una sola pasada: cada
+// uno restringe una máscara sobre las filas de las columnas y al final se crea
+// una única vista. Un filter sin filas se ignora, como en filterExprCLI, salvo con
+// 'vaciarSinFilas', que entonces devuelve 0 sin tocar df. Devuelve 1 si quedan
+// filas y -1 si hubo un error, ya mostrado.
+static int filtrarEnUnaPasada(Dataframe *df, const OperacionPlan *ops, int n, int vaciarSinFilas) {
+    int64_t filasBase = df->padre ? df->padre->numFilas : df->numFilas;
+    size_t palabras = PALABRAS_BITMAP(filasBase) + 1;
+    uint64_t *mascara = calloc(palabras, sizeof(uint64_t));
+    uint64_t *seleccion = calloc(palabras, sizeof(uint64_t));
+    ExprFiltro *expr = malloc(sizeof(ExprFiltro));
+    if (!mascara || !seleccion || !expr) {
+        free(mascara);
+        free(seleccion);
+        free(expr);
+        print_error("Error de memoria al ejecutar el plan");
+        return -1;
+    }
+    for (int64_t i = 0; i < df->numFilas; i++)
+        MARCAR_FILA(mascara, FILA_FISICA(df, i), 1);
+
+    int64_t total = df->numFilas;
+    int estado = 1;
+    for (int k = 0; k < n && estado == 1; k++) {
+        if (ops[k].tipo == OP_PLAN_DELNULL) {
+            int c = 0;
+            while (c < df->numColumnas && strcmp(df->columnas[c].nombre, ops[k].texto) != 0)
+                c++;
+            if (c == df->numColumnas) {
+                print_error("Columna no encontrada");
+                estado = -1;
+                break;
+            }
+            // Los bits de la máscara tras filasBase ya están a 0
+            total = 0;
+            for (size_t w = 0; w < PALABRAS_BITMAP(filasBase); w++) {
+                mascara[w] &= df->columnas[c].validos[w];
+                total += __builtin_popcountll(mascara[w]);
+            }
+            if (total == 0 && vaciarSinFilas)
+                estado = 0;
+            continue;
+        }
+
+        int64_t filas = -1;
+        if (!compilarExprFiltro(expr, df, ops[k].texto)) {
+            estado = -1;
+        } else if ((filas = evaluarExprFiltro(expr, filasBase, mascara, seleccion)) < 0) {
+            print_error("Error de memoria al ejecutar el plan");
+            estado = -1;
+        } else if (filas > 0) {
+            uint64_t *t = mascara;
+            mascara = seleccion;
+            seleccion = t;
+            total = filas;
+        } else if (vaciarSinFilas) {
+            estado = 0;
+        } else {
+            printf(GREEN "filter %s: no se encontraron filas que cumplan la condición\n" RESET, ops[k].texto);
+        }
+    }
+    free(expr);
+    free(seleccion);
+    if (estado == 1 && total != df->numFilas && !restringirVista(df, mascara, total)) {
+        print_error("Error de memoria al ejecutar el plan");
+        estado = -1;
+    }
+    free(mascara);
+    return estado;
+}
+
+void filterExprCLI(Dataframe *df, const char *expresion) {
+    VALIDAR_DF_Y_PARAMETROS(df, expresion);
+    int64_t nuevas_filas = filtrarDF(df, expresion);
+    if (nuevas_filas < 0)
+        return;
+    if (nuevas_filas == 0) {
+        printf(GREEN "No se encontraron filas que cumplan la condición\n" RESET);
+        return;
+    }
+    actualizarPrompt(dfActual);
+
+    printf(GREEN "Filtrado completado. Quedan %" PRId64 " filas\n" RESET, nuevas_filas);
+}
+
+// Añade a dfActual, tras la columna de fecha, una columna con su trimestre
+int crearColumnaTrimestre(const char *nombreColumna_fecha, const char *nombre_nueva_columna) {
+    if (!materializarDFActual())
+        return 0;
+
+    int indice_col = encontrarIndiceColumna(dfActual, nombreColumna_fecha);
+    if (indice_col == -1 || dfActual->columnas[indice_col].tipo != FECHA) {
+        print_error("Columna de fecha no encontrada o tipo incorrecto");
+        return 0;
+    }
+
+    if (encontrarIndiceColumna(dfActual, nombre_nueva_columna) != -1) {
+        print_error("Ya existe una columna con ese nombre");
+        return 0;
+    }
+
+    // Las columnas existentes se comparten; solo se reserva la de trimestre,
+    // que va justo después de la de fecha
+    Dataframe *nuevo_df = derivarDFActual(-1, indice_col + 1);
+    if (!nuevo_df)
+        return 0;
+    strncpy(nuevo_df->columnas[indice_col + 1].nombre, nombre_nueva_columna, 29);
+    nuevo_df->columnas[indice_col + 1].nombre[29] = '\0';
+    nuevo_df->columnas[indice_col + 1].tipo = TEXTO;
+
+    // Calcular trimestre. Solo hay cinco valores posibles: se guardan una vez
+    // en la arena y todas las filas apuntan a ellos
+    Columna *nueva = &nuevo_df->columnas[indice_col + 1];
+    static const char *textos[] = {"Q1", "Q2", "Q3", "Q4", "#N/A"};
+    char *trimestres[5];
+    for (int i = 0; i < 5; i++) {
+        trimestres[i] = guardarTextoColumna(nueva, textos[i], strlen(textos[i]));
+        if (!trimestres[i]) {
+            liberarRecursosEnError(nuevo_df, "Error de memoria en quarterCLI");
+            return 0;
+        }
+    }
+    for (int64_t filaActual = 0; filaActual < dfActual->numFilas; filaActual++) {
+        if (ES_NULO(&dfActual->columnas[indice_col], filaActual)) {
+            nueva->datos[filaActual] = trimestres[4];
+            continue;
+        }
+        int anio, mes, dia;
+        descomponerFecha(dfActual->columnas[indice_col].fechas[filaActual], &anio, &mes, &dia);
+        nueva->datos[filaActual] = trimestres[(mes - 1) / 3];
+    }
+
+    // Las columnas compartidas conservan sus estadísticas; solo falta la nueva
+    calcularEstadisticasDF(nuevo_df);
+    reemplazarDFActual(nuevo_df);
+    return 1;
+}
+
+void quarterCLI(const char *nombreColumna_fecha, const char *nombre_nueva_columna) {
+    VALIDAR_DF_Y_PARAMETROS(dfActual, nombreColumna_fecha);
+    VALIDAR_DF_Y_PARAMETROS(dfActual, nombre_nueva_columna);
+    if (crearColumnaTrimestre(nombreColumna_fecha, nombre_nueva_columna))
+        printf(GREEN "Nueva columna '%s' creada con trimestres\n" RESET, nombre_nueva_columna);
+}
+
+void sortCLI(const char **nombres, const int *descendente, int numClaves) {
+    if (!dfActual) {
+        print_error("No hay df cargado.");
+        return;
+    }
+    if (!materializarDFActual())
+        return;
+
+    int indices[MAX_CLAVES_ORDEN] = {0};
+    for (int c = 0; c < numClaves; c++) {
+        indices[c] = encontrarIndiceColumna(dfActual, nombres[c]);
+        if (indices[c] == -1) {
+            print_error("Columna no encontrada.");
+            return;
+        }
+    }
+
+    if (!ordenarDataframe(dfActual, indices, descendente, numClaves)) {
+        print_error("Error de memoria al ordenar");
+        return;
+    }
+
+    printf(GREEN "df ordenado por ");
+    for (int c = 0; c < numClaves; c++)
+        printf("%scolumna '%s' en orden %s", c > 0 ? ", " : "", nombres[c],
+               descendente[c] ? "descendente" : "ascendente");
+    printf(".\n" RESET);
+}
+
+// Escritor de CSV: cada hilo formatea un tramo de filas en su propio buffer y
+// el hilo principal los escribe en orden con write(), por vueltas de
+// numHilos tramos para no tener todo el archivo en memoria.
+typedef struct {
+    char *datos;
+    size_t usado;
+    size_t tamano;
+} BufferCSV;
+
+typedef struct {
+    const Dataframe *df;
+    int64_t inicio, fin;        // Filas [inicio, fin) del tramo
+    BufferCSV salida;
+    int ok;
+} TramoEscrituraCSV;
+
+// Deja sitio para 'extra' bytes más 64 de holgura, que permiten leer bloques
+// completos de 64 bytes a partir de cualquier posición ocupada
+static int reservarBufferCSV(BufferCSV *b, size_t extra) {
+    if (b->usado + extra + 64 <= b->tamano)
+        return 1;
+    size_t tamano = b->tamano ? b->tamano : 1 << 20;
+    while (b->usado + extra + 64 > tamano)
+        tamano *= 2;
+    char *datos = realloc(b->datos, tamano);
+    if (!datos)
+        return 0;
+    b->datos = datos;
+    b->tamano = tamano;
+    return 1;
+}
+
+static const char paresDigitos[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                                   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                                   "8081828384858687888990919293949596979899";
+
+// Escribe v en decimal en 'p' (sin '\0'); devuelve los bytes escritos
+static size_t formatearEntero(char *p, int64_t v) {
+    char tmp[24];
+    char *q = tmp + sizeof(tmp);
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    while (u >= 100) {
+        q -= 2;
+        memcpy(q, paresDigitos + (u % 100) * 2, 2);
+        u /= 100;
+    }
+    if (u >= 10) {
+        q -= 2;
+        memcpy(q, paresDigitos + u * 2, 2);
+    } else {
+        *--q = (char)('0' + u);
+    }
+    if (v < 0)
+        *--q = '-';
+    size_t len = (size_t)(tmp + sizeof(tmp) - q);
+    memcpy(p, q, len);
+    return len;
+}
+
+static const double potencias10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+// Igual que formatearDoble. Los enteros exactos y los valores con pocos
+// decimales no pasan por snprintf: si v * 10^k da un entero m de hasta 15
+// cifras y m / 10^k vuelve a dar v, basta con imprimir m / 10^k.
+static size_t formatearReal(char *p, double v) {
+    double a = v < 0 ? -v : v;
+    if (a < 1e15 && v == (double)(int64_t)v && !(v == 0 && signbit(v)))
+        return formatearEntero(p, (int64_t)v);
+    if (a >= 1e-4 && a < 1e14) {
+        for (int k = 1; k <= 9; k++) {
+            double escalado = a * potencias10[k];
+            if (escalado >= 1e15 || escalado != (double)(int64_t)escalado ||
+                escalado / potencias10[k] != a)
+                continue;
+            uint64_t m = (uint64_t)escalado, divisor = (uint64_t)potencias10[k];
+            uint64_t fraccion = m % divisor;
+            size_t len = 0;
+            if (v < 0)
+                p[len++] = '-';
+            len += formatearEntero(p + len, (int64_t)(m / divisor));
+            p[len++] = '.';
+            for (int d = k - 1; d >= 0; d--, fraccion /= 10)
+                p[len + d] = (char)('0' + fraccion % 10);
+            len += k;
+            while (p[len - 1] == '0')
+                len--;
+            if (p[len - 1] == '.')
+                len--;
+            return len;
+        }
+    }
+    return (size_t)formatearDoble(p, 32, v);
+}
+
+static size_t formatearFecha(char *p, int32_t dias) {
+    int anio, mes, dia;
+    descomponerFecha(dias, &anio, &mes, &dia);
+    if (anio < 0 || anio > 9999)
+        return (size_t)snprintf(p, 32, "%04d-%02d-%02d", anio, mes, dia);
+    memcpy(p, paresDigitos + (anio / 100) * 2, 2);
+    memcpy(p + 2, paresDigitos + (anio % 100) * 2, 2);
+    p[4] = '-';
+    memcpy(p + 5, paresDigitos + mes * 2, 2);
+    p[7] = '-';
+    memcpy(p + 8, paresDigitos + dia * 2, 2);
+    return 10;
+}
+
+// ¿Hay comas, comillas o saltos de línea en los 'len' bytes de 's'? Se leen
+// bloques enteros de 64 bytes (el llamante garantiza la holgura) con las
+// mismas máscaras que el tokenizador.
+static int necesitaComillas(const char *s, size_t len) {
+    for (size_t i = 0; i < len; i += 64) {
+        uint64_t comillas, delim;
+#ifdef USAR_AVX2
+        if (tieneAVX2())
+            mascarasBloqueAVX2(s + i, ',', &comillas, &delim);
+        else
+#endif
+            mascarasBloqueSWAR(s + i, ',', &comillas, &delim);
+        uint64_t especiales = comillas | delim;
+        if (len - i < 64)
+            especiales &= (UINT64_C(1) << (len - i)) - 1;
+        if (especiales)
+            return 1;
+    }
+    return 0;
+}
+
+// Añade una cadena: se copia tal cual y, si hace falta, se reescribe entre
+// comillas con las comillas internas duplicadas
+static int escribirTextoCSV(BufferCSV *b, const char *s) {
+    size_t len = strlen(s);
+    if (!reservarBufferCSV(b, len))
+        return 0;
+    char *p = b->datos + b->usado;
+    memcpy(p, s, len);
+    if (!necesitaComillas(p, len)) {
+        b->usado += len;
+        return 1;
+    }
+    if (!reservarBufferCSV(b, 2 * len + 2))
+        return 0;
+    p = b->datos + b->usado;
+    *p++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '"')
+            *p++ = '"'; // Comillas dobles para escaparlas
+        *p++ = s[i];
+    }
+    *p++ = '"';
+    b->usado = (size_t)(p - b->datos);
+    return 1;
+}
+
+static void *hiloEscribirTramoCSV(void *arg) {
+    TramoEscrituraCSV *t = arg;
+    const Dataframe *df = t->df;
+    BufferCSV *b = &t->salida;
+    b->usado = 0;
+    t->ok = 1;
+    for (int64_t i = t->inicio; i < t->fin && t->ok; i++) {
+        int64_t fila = FILA_FISICA(df, i);
+        for (int c = 0; c < df->numColumnas && t->ok; c++) {
+            const Columna *col = &df->columnas[c];
+            t->ok = reservarBufferCSV(b, 32);
+            if (t->ok && !ES_NULO(col, fila)) {
+                char *p = b->datos + b->usado;
+                switch (col->formato) {
+                case FMT_ENTERO:
+                    b->usado += formatearEntero(p, col->enteros[fila]);
+                    break;
+                case FMT_REAL:
+                    b->usado += formatearReal(p, col->reales[fila]);
+                    break;
+                case FMT_FECHA:
+                    b->usado += formatearFecha(p, col->fechas[fila]);
+                    break;
+                case FMT_CATEGORIA8:
+                case FMT_CATEGORIA16:
+                    t->ok = escribirTextoCSV(b, col->dic->valores[codigoCelda(col, fila)]);
+                    break;
+                case FMT_TEXTO:
+                default:
+                    if (col->datos[fila])
+                        t->ok = escribirTextoCSV(b, col->datos[fila]);
+                    break;
+                }
+            }
+            // La holgura de reservarBufferCSV cubre el separador
+            b->datos[b->usado++] = c < df->numColumnas - 1 ? ',' : '\n';
+        }
+    }
+    return NULL;
+}
+
+static int escribirTodo(int fd, const char *datos, size_t tam) {
+    while (tam > 0) {
+        ssize_t escritos = write(fd, datos, tam);
+        if (escritos < 0 && errno == EINTR)
+            continue;
+        if (escritos <= 0)
+            return 0;
+        datos += escritos;
+        tam -= (size_t)escritos;
+    }
+    return 1;
+}
+
+// Escribe la línea de encabezado con los nombres de las columnas
+int escribirEncabezadoCSV(int fd, const Dataframe *df) {
+    BufferCSV b = {0};
+    int ok = 1;
+    for (int c = 0; c < df->numColumnas && ok; c++) {
+        size_t len = strlen(df->columnas[c].nombre);
+        ok = reservarBufferCSV(&b, len + 1);
+        if (ok) {
+            memcpy(b.datos + b.usado, df->columnas[c].nombre, len);
+            b.usado += len;
+            b.datos[b.usado++] = c < df->numColumnas - 1 ? ',' : '\n';
+        }
+    }
+    ok = ok && escribirTodo(fd, b.datos, b.usado);
+    free(b.datos);
+    return ok;
+}
+
+// Escribe las filas del dataframe (o de la vista) separadas por comas
+int escribirFilasCSV(int fd, const Dataframe *df) {
+    int64_t tramos = (df->numFilas + FILAS_TRAMO_CSV - 1) / FILAS_TRAMO_CSV;
+    int numHilos = numeroHilos();
+    if (numHilos > tramos)
+        numHilos = tramos > 0 ? (int)tramos : 1;
+    TramoEscrituraCSV tareas[MAX_HILOS];
+    memset(tareas, 0, sizeof(tareas));
+
+    int ok = 1;
+    for (int64_t primero = 0; ok && primero < tramos; primero += numHilos) {
+        int n = tramos - primero < numHilos ? (int)(tramos - primero) : numHilos;
+        for (int t = 0; t < n; t++) {
+            tareas[t].df = df;
+            tareas[t].inicio = (primero + t) * FILAS_TRAMO_CSV;
+            tareas[t].fin = tareas[t].inicio + FILAS_TRAMO_CSV < df->numFilas
+                                ? tareas[t].inicio + FILAS_TRAMO_CSV
+                                : df->numFilas;
+        }
+        ejecutarEnHilos(hiloEscribirTramoCSV, tareas, sizeof(TramoEscrituraCSV), n);
+        for (int t = 0; t < n && ok; t++)
+            ok = tareas[t].ok && escribirTodo(fd, tareas[t].salida.datos, tareas[t].salida.usado);
+    }
+
+    for (int t = 0; t < numHilos; t++)
+        free(tareas[t].salida.datos);
+    return ok;
+}
+
+int escribirCSV(const Dataframe *df, const char *nombre_archivo) {
+    int fd = open(nombre_archivo, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        char error_msg[MAX_FILENAME + 50];
+        snprintf(error_msg, sizeof(error_msg), "No se puede crear el archivo: %s", nombre_archivo);
+        print_error(error_msg);
+        return 0;
+    }
+    int ok = escribirEncabezadoCSV(fd, df) && escribirFilasCSV(fd, df);
+    ok = close(fd) == 0 && ok;
+    if (!ok)
+        print_error("Error al escribir el archivo");
+    return ok;
+}
+
+// Guarda dfActual en CSV o, con extensión .dfb, como instantánea. En CSV los
+// enteros y las fechas salen tal como se leyeron, pero los reales se escriben
+// en su forma más corta que se relee igual: "300.00" se guarda como "300" y
+// ".5" como "0.5".
+void saveCLI(const char *nombre_archivo) {
+    if (!dfActual) {
+        print_error("No hay df activo para guardar.");
+        return;
+    }
+    if (!materializarDFActual())
+        return;
+
+    char nombre_saveCLI[MAX_FILENAME];
+    if (nombre_archivo == NULL || strlen(nombre_archivo) == 0) {
+        snprintf(nombre_saveCLI, sizeof(nombre_saveCLI), "%s.csv", dfActual->nombre);
+    } else {
+        strncpy(nombre_saveCLI, nombre_archivo, sizeof(nombre_saveCLI) - 1);
+        nombre_saveCLI[sizeof(nombre_saveCLI) - 1] = '\0';
+        cortarEspacios(nombre_saveCLI);
+    }
+
+    if (esArchivoDFB(nombre_saveCLI)) {
+        if (guardarDFB(dfActual, nombre_saveCLI))
+            printf(GREEN "df guardado exitosamente en %s\n" RESET, nombre_saveCLI);
+        return;
+    }
+
+    if (strlen(nombre_saveCLI) < 4 ||
+        strcmp(nombre_saveCLI + strlen(nombre_saveCLI) - 4, ".csv") != 0) {
+        strncat(nombre_saveCLI, ".csv", sizeof(nombre_saveCLI) - strlen(nombre_saveCLI) - 1);
+    }
+
+    if (escribirCSV(dfActual, nombre_saveCLI))
+        printf(GREEN "df guardado exitosamente en %s\n" RESET, nombre_saveCLI);
+}
+
+void metaCLI() {
+    if (!dfActual) {
+        print_error("No hay df cargado.");
+        return;
+    }
+
+    // Las estadísticas ya están calculadas salvo en columnas recién escritas
+    if (!calcularEstadisticasDF(dfActual)) {
+        print_error("Error de memoria al calcular las estadísticas");
+        return;
+    }
+    for (int col = 0; col < dfActual->numColumnas; col++) {
+        const Columna *c = &dfActual->columnas[col];
+        const EstadisticasColumna *est = &c->estadisticas;
+
+        char *tipo;
+        switch (dfActual->columnas[col].tipo) {
+        case TEXTO:
+            tipo = "Texto";
+            break;
+        case NUMERICO:
+            tipo = "Numerico";
+            break;
+        case FECHA:
+            tipo = "Fecha";
+            break;
+        default:
+            tipo = "Desconocido";
+            break;
+        }
+
+        printf(GREEN "%s: %s (Valores nulos: %" PRId64, dfActual->columnas[col].nombre, tipo, est->nulos);
+        if (est->hayValores) {
+            // Tras un filter los extremos y los distintos son cotas
+            char bufMinimo[64], bufMaximo[64];
+            const char *minimo = textoEstadistica(c, est->minimo, bufMinimo, sizeof(bufMinimo));
+            const char *maximo = textoEstadistica(c, est->maximo, bufMaximo, sizeof(bufMaximo));
+            // La estimación nunca pasa de las filas con valor
+            int64_t distintos = distintosEstimados(est);
+            if (distintos > dfActual->numFilas - est->nulos)
+                distintos = dfActual->numFilas - est->nulos;
+            printf(est->exactas ? ", mín %s, máx %s, ~%" PRId64 " distintos"
+                                : ", entre %s y %s, como mucho ~%" PRId64 " distintos",
+                   minimo, maximo, distintos);
+            if (est->ordenada)
+                printf(", ordenada");
+        }
+        printf(")\n" RESET);
+    }
+}
+
+void viewCLI(int n) {
+    if (!dfActual) {
+        print_error("No hay df cargado.");
+        return;
+    }
+
+    for (int j = 0; j < dfActual->numColumnas; j++) {
+        printf("%s", dfActual->columnas[j].nombre);
+        if (j < dfActual->numColumnas - 1) {
+            printf(",");
+        }
+    }
+    printf("\n");
+
+    int64_t total_filas = dfActual->numFilas;
+    int64_t filas_a_mostrar = (abs(n) < total_filas) ? abs(n) : total_filas;
+
+    char buffer[64];
+    if (n >= 0) {
+        for (int64_t i = 0; i < filas_a_mostrar; i++) {
+            int64_t fila = FILA_FISICA(dfActual, i);
+            for (int j = 0; j < dfActual->numColumnas; j++) {
+                if (ES_NULO(&dfActual->columnas[j], fila)) {
+                    printf("1");
+                } else {
+                    printf("%s", textoCelda(&dfActual->columnas[j], fila, buffer, sizeof(buffer)));
+                }
+                if (j < dfActual->numColumnas - 1) {
+                    printf(",");
+                }
+            }
+            printf("\n");
+        }
+    } else {
+        for (int64_t i = total_filas - 1; i >= total_filas - filas_a_mostrar; i--) {
+            int64_t fila = FILA_FISICA(dfActual, i);
+            for (int j = 0; j < dfActual->numColumnas; j++) {
+                if (ES_NULO(&dfActual->columnas[j], fila)) {
+                    printf("1");
+                } else {
+                    printf("%s", textoCelda(&dfActual->columnas[j], fila, buffer, sizeof(buffer)));
+                }
+                if (j < dfActual->numColumnas - 1) {
+                    printf(",");
+                }
+            }
+            printf("\n");
+        }
+    }
+}
+
+// Quita de dfActual la columna (sin distinguir mayúsculas)
+int quitarColumna(const char *nombreColumna) {
+    if (!materializarDFActual())
+        return 0;
+
+    char nombreColumna_limpio[51];
+    strncpy(nombreColumna_limpio, nombreColumna, 50);
+    nombreColumna_limpio[50] = '\0';
+    for (int i = 0; nombreColumna_limpio[i]; i++) {
+        nombreColumna_limpio[i] = tolower(nombreColumna_limpio[i]);
+    }
+
+    int indice_col = -1;
+    for (int i = 0; i < dfActual->numColumnas; i++) {
+        char nombre_actual_limpio[51];
+        strncpy(nombre_actual_limpio, dfActual->columnas[i].nombre, 50);
+        nombre_actual_limpio[50] = '\0';
+        for (int j = 0; nombre_actual_limpio[j]; j++) {
+            nombre_actual_limpio[j] = tolower(nombre_actual_limpio[j]);
+        }
+        if (strcmp(nombre_actual_limpio, nombreColumna_limpio) == 0) {
+            indice_col = i;
+            break;
+        }
+    }
+
+    if (indice_col == -1) {
+        print_error("Columna no encontrada");
+        return 0;
+    }
+
+    int nuevasColumnas = dfActual->numColumnas - 1;
+    if (nuevasColumnas == 0) {
+        print_error("No se puede eliminar la última columna");
+        return 0;
+    }
+
+    // El resto de columnas se comparten con el df actual sin copiarlas
+    Dataframe *nuevo_df = derivarDFActual(indice_col, -1);
+    if (!nuevo_df)
+        return 0;
+
+    reemplazarDFActual(nuevo_df);
+    return 1;
+}
+
+void delcolumCLI(const char *nombreColumna) {
+    if (!dfActual || !nombreColumna) {
+        print_error("No hay df activo o nombre de columna inválido");
+        return;
+    }
+    if (quitarColumna(nombreColumna))
+        printf(GREEN "Se eliminó la columna '%s'\n" RESET, nombreColumna);
+}
+
+// Quita de dfActual (como vista) las filas con nulo en la columna. Devuelve
+// cuántas se quitaron o -1 si hubo un error, ya mostrado.
+int64_t eliminarNulos(const char *nombreColumna) {
+    int indice_col = -1;
+    for (int i = 0; i < dfActual->numColumnas; i++) {
+        if (strcmp(dfActual->columnas[i].nombre, nombreColumna) == 0) {
+            indice_col = i;
+            break;
+        }
+    }
+
+    if (indice_col == -1) {
+        print_error("Columna no encontrada");
+        return -1;
+    }
+
+    const Columna *col = &dfActual->columnas[indice_col];
+    int64_t filasBase = dfActual->padre ? dfActual->padre->numFilas : dfActual->numFilas;
+    uint64_t *seleccion = calloc(PALABRAS_BITMAP(filasBase) + 1, sizeof(uint64_t));
+    if (!seleccion) {
+        print_error("Error de memoria en delnullCLI");
+        return -1;
+    }
+    // La selección es directamente el bitmap de validez de la columna
+    memcpy(seleccion, col->validos, PALABRAS_BITMAP(filasBase) * sizeof(uint64_t));
+    if (filasBase & 63)
+        seleccion[filasBase >> 6] &= (1ULL << (filasBase & 63)) - 1;
+
+    int64_t validas = dfActual->padre ? contarSeleccion(dfActual, seleccion)
+                                      : filasBase - contarNulos(col, filasBase);
+    int64_t filasNulas = dfActual->numFilas - validas;
+    int ok = filasNulas == 0 || restringirVista(dfActual, seleccion, validas);
+    free(seleccion);
+    if (!ok) {
+        print_error("Error de memoria en delnullCLI");
+        return -1;
+    }
+    return filasNulas;
+}
+
+void delnullCLI(const char *nombreColumna) {
+    if (!dfActual || !nombreColumna) {
+        print_error("No hay df activo o nombre de columna inválido");
+        return;
+    }
+    int64_t filasNulas = eliminarNulos(nombreColumna);
+    if (filasNulas < 0)
+        return;
+    if (filasNulas == 0) {
+        printf(GREEN "No hay valores nulos para eliminar\n" RESET);
+        return;
+    }
+    actualizarPrompt(dfActual);
+    printf(GREEN "Se eliminaron %" PRId64 " filas con valores nulos\n" RESET, filasNulas);
+}
+
+// --- Planes y modo lazy --------------------------------------------------------
+// Con 'lazy', filter, delnull, delcolum, quarter y prefix no se ejecutan: se
+// apuntan en el plan del df tras probarlos sobre una muestra. view, save,
+// meta, sort, add, materialize, groupby, join, createindex y collect ejecutan
+// antes el plan optimizado.
+// El modo stream usa los mismos planes para cada lote.
+
+void liberarPlan(Plan *plan) {
+    if (!plan)
+        return;
+    liberarMemoriaDF(plan->muestra);
+    free(plan);
+}
+
+// Copia de las primeras filas de las columnas de df, para validar operaciones
+static Dataframe *muestraDF(const Dataframe *df, int64_t filas) {
+    int64_t filasBase = df->padre ? df->padre->numFilas : df->numFilas;
+    if (filas > filasBase)
+        filas = filasBase;
+    Dataframe *muestra = crearNuevoDataframe(df->numColumnas, filas, df->nombre);
+    for (int c = 0; muestra && c < df->numColumnas; c++) {
+        if (!copiarColumna(&muestra->columnas[c], &df->columnas[c], filas)) {
+            liberarMemoriaDF(muestra);
+            return NULL;
+        }
+    }
+    return muestra;
+}
+
+static void restaurarPrompt(void) {
+    if (flujoActual)
+        actualizarPromptFlujo();
+    else
+        actualizarPrompt(dfActual);
+}
+
+// Aplica una operación a dfActual: 1 si sigue habiendo filas, 0 si el filtro
+// las descartó todas y -1 si hubo un error
+static int aplicarOperacionPlan(const OperacionPlan *op) {
+    switch (op->tipo) {
+    case OP_PLAN_FILTRO: {
+        int64_t filas = filtrarDF(dfActual, op->texto);
+        return filas < 0 ? -1 : filas > 0;
+    }
+    case OP_PLAN_DELNULL:
+        return eliminarNulos(op->texto) < 0 ? -1 : 1;
+    case OP_PLAN_DELCOLUM:
+        return quitarColumna(op->texto) ? 1 : -1;
+    case OP_PLAN_QUARTER:
+        return crearColumnaTrimestre(op->texto, op->nueva) ? 1 : -1;
+    case OP_PLAN_PREFIX:
+    default:
+        return crearColumnaPrefijo(op->texto, op->n, op->nueva) ? 1 : -1;
+    }
+}
+
+static void anotarLectura(OperacionPlan *op, const char *nombre) {
+    if (op->numLee < 0)
+        return;
+    for (int i = 0; i < op->numLee; i++) {
+        if (strcasecmp(op->lee[i], nombre) == 0)
+            return;
+    }
+    // Con demasiadas columnas se considera que la operación lee todas
+    if (op->numLee == MAX_LECTURAS_OPERACION) {
+        op->numLee = -1;
+        return;
+    }
+    copiarNombreColumna(op->lee[op->numLee++], nombre);
+}
+
+// Anota en 'op' las columnas de df que usa
+static int anotarLecturas(OperacionPlan *op, Dataframe *df) {
+    op->numLee = 0;
+    if (op->tipo == OP_PLAN_DELCOLUM)
+        return 1;
+    if (op->tipo != OP_PLAN_FILTRO) {
+        anotarLectura(op, op->texto);
+        return 1;
+    }
+    ExprFiltro *expr = malloc(sizeof(ExprFiltro));
+    if (!expr) {
+        print_error("Error de memoria en filter");
+        return 0;
+    }
+    int ok = compilarExprFiltro(expr, df, op->texto);
+    for (int i = 0; ok && i < expr->numNodos; i++) {
+        if (expr->nodos[i].tipo == NODO_CLAUSULA)
+            anotarLectura(op, expr->nodos[i].pred.col->nombre);
+    }
+    free(expr);
+    return ok;
+}
+
+// Apunta la operación en el plan tras aplicarla a la muestra
+int anadirOperacionPlan(Plan *plan, const OperacionPlan *op) {
+    if (plan->numOperaciones == MAX_OPERACIONES_PLAN) {
+        print_error("Demasiadas operaciones pendientes en el plan");
+        return 0;
+    }
+    OperacionPlan *nueva = &plan->operaciones[plan->numOperaciones];
+    *nueva = *op;
+    Dataframe *anterior = dfActual;
+    dfActual = plan->muestra;
+    int ok = anotarLecturas(nueva, dfActual) && aplicarOperacionPlan(nueva) >= 0;
+    plan->muestra = dfActual;
+    dfActual = anterior;
+    if (ok)
+        plan->numOperaciones++;
+    restaurarPrompt();
+    return ok;
+}
+
+static int esFiltroPlan(const OperacionPlan *op) {
+    return op->tipo == OP_PLAN_FILTRO || op->tipo == OP_PLAN_DELNULL;
+}
+
+// Columna que la operación crea o borra (NULL si no cambia columnas)
+static const char *columnaEscrita(const OperacionPlan *op) {
+    if (op->tipo == OP_PLAN_DELCOLUM)
+        return op->texto;
+    if (op->tipo == OP_PLAN_QUARTER || op->tipo == OP_PLAN_PREFIX)
+        return op->nueva;
+    return NULL;
+}
+
+static int leeColumna(const OperacionPlan *op, const char *nombre) {
+    if (op->numLee < 0)
+        return 1;
+    for (int i = 0; i < op->numLee; i++) {
+        if (strcasecmp(op->lee[i], nombre) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// a seguida de b da lo mismo que b seguida de a
+static int conmutan(const OperacionPlan *a, const OperacionPlan *b) {
+    const char *ea = columnaEscrita(a), *eb = columnaEscrita(b);
+    if (ea && (leeColumna(b, ea) || (eb && strcasecmp(ea, eb) == 0)))
+        return 0;
+    return !eb || !leeColumna(a, eb);
+}
+
+// Orden preferido: delcolum primero (comparte columnas sin copiar nada),
+// luego filter/delnull (dejan menos filas que copiar) y al final las
+// columnas derivadas, que materializan la vista
+static int prioridadPlan(const OperacionPlan *op) {
+    return op->tipo == OP_PLAN_DELCOLUM ? 0 : esFiltroPlan(op) ? 1 : 2;
+}
+
+// Copia en 'ops' las operaciones del plan optimizadas y devuelve cuántas son.
+// Un quarter/prefix cuya columna se borra sin que nadie la use desaparece
+// junto con su delcolum; después cada operación se adelanta mientras la
+// anterior tenga menos prioridad y conmuten. Los filter y delnull no se
+// reordenan entre sí, porque un filter sin filas se ignora.
+static int optimizarPlan(const Plan *plan, OperacionPlan *ops) {
+    int n = plan->numOperaciones;
+    memcpy(ops, plan->operaciones, (size_t)n * sizeof(OperacionPlan));
+
+    for (int j = 0; j < n; j++) {
+        if (ops[j].tipo != OP_PLAN_DELCOLUM)
+            continue;
+        int i = j - 1;
+        while (i >= 0 && !leeColumna(&ops[i], ops[j].texto) &&
+               !(columnaEscrita(&ops[i]) && strcasecmp(columnaEscrita(&ops[i]), ops[j].texto) == 0))
+            i--;
+        if (i < 0 || ops[i].tipo == OP_PLAN_DELCOLUM || esFiltroPlan(&ops[i]) ||
+            strcasecmp(ops[i].nueva, ops[j].texto) != 0)
+            continue;
+        memmove(&ops[j], &ops[j + 1], (size_t)(n - j - 1) * sizeof(OperacionPlan));
+        memmove(&ops[i], &ops[i + 1], (size_t)(n - i - 2) * sizeof(OperacionPlan));
+        n -= 2;
+        j = i - 1;
+    }
+
+    for (int cambios = 1; cambios;) {
+        cambios = 0;
+        for (int i = 0; i + 1 < n; i++) {
+            if (prioridadPlan(&ops[i + 1]) < prioridadPlan(&ops[i]) && conmutan(&ops[i], &ops[i + 1])) {
+                OperacionPlan t = ops[i];
+                ops[i] = ops[i + 1];
+                ops[i + 1] = t;
+                cambios = 1;
+            }
+        }
+    }
+    return n;
+}
+
+// Ejecuta sobre dfActual el plan optimizado; los filter y delnull seguidos
+// se hacen en una pasada. Devuelve 1 si quedan filas, 0 si un filtro las
+// descartó todas (solo con 'vaciarSinFilas') y -1 si hubo un error.
+int ejecutarPlan(const Plan *plan, int vaciarSinFilas) {
+    OperacionPlan *ops = malloc(MAX_OPERACIONES_PLAN * sizeof(OperacionPlan));
+    if (!ops) {
+        print_error("Error de memoria al ejecutar el plan");
+        return -1;
+    }
+    int n = optimizarPlan(plan, ops);
+    int estado = 1;
+    for (int i = 0; i < n && estado == 1;) {
+        int j = i;
+        while (j < n && esFiltroPlan(&ops[j]))
+            j++;
+        if (j > i) {
+            estado = filtrarEnUnaPasada(dfActual, &ops[i], j - i, vaciarSinFilas);
+            i = j;
+        } else {
+            estado = aplicarOperacionPlan(&ops[i++]);
+        }
+    }
+    free(ops);
+    return estado;
+}
+
+// Ejecuta las operaciones pendientes de dfActual si está en modo lazy
+int ejecutarPlanDFActual(void) {
+    if (!dfActual || !dfActual->plan || dfActual->plan->numOperaciones == 0)
+        return 1;
+    // Las operaciones pueden sustituir dfActual: el plan se aparta mientras
+    Plan *plan = dfActual->plan;
+    dfActual->plan = NULL;
+    double inicio = tiempoActual();
+    int estado = ejecutarPlan(plan, 0);
+    int numOperaciones = plan->numOperaciones;
+    liberarMemoriaDF(plan->muestra);
+    memset(plan, 0, sizeof(Plan));
+    dfActual->plan = plan;
+    actualizarPrompt(dfActual);
+    if (estado < 0) {
+        print_error("No se pudo ejecutar el plan; se descartan las operaciones pendientes");
+        return 0;
+    }
+    printf(GREEN "Plan ejecutado: %d operaciones en %.3f s. Quedan %" PRId64 " filas\n" RESET,
+           numOperaciones, tiempoActual() - inicio, dfActual->numFilas);
+    return 1;
+}
+
+static void describirOperacionPlan(const OperacionPlan *op, char *texto, size_t tam) {
+    switch (op->tipo) {
+    case OP_PLAN_FILTRO:
+        snprintf(texto, tam, "filter %s", op->texto);
+        break;
+    case OP_PLAN_DELNULL:
+        snprintf(texto, tam, "delnull %s", op->texto);
+        break;
+    case OP_PLAN_DELCOLUM:
+        snprintf(texto, tam, "delcolum %s", op->texto);
+        break;
+    case OP_PLAN_QUARTER:
+        snprintf(texto, tam, "quarter %s %s", op->texto, op->nueva);
+        break;
+    case OP_PLAN_PREFIX:
+        snprintf(texto, tam, "prefix %s n %d -> %s", op->texto, op->n, op->nueva);
+        break;
+    }
+}
+
+void explicarPlan(const Plan *plan) {
+    char texto[MAX_LINE_LENGTH + 64];
+    printf("Plan apuntado (%d operaciones):\n", plan->numOperaciones);
+    for (int i = 0; i < plan->numOperaciones; i++) {
+        describirOperacionPlan(&plan->operaciones[i], texto, sizeof(texto));
+        printf("  %d. %s\n", i + 1, texto);
+    }
+
+    OperacionPlan *ops = malloc(MAX_OPERACIONES_PLAN * sizeof(OperacionPlan));
+    if (!ops) {
+        print_error("Error de memoria en explain");
+        return;
+    }
+    int n = optimizarPlan(plan, ops);
+    printf("Plan optimizado (%d operaciones):\n", n);
+    for (int i = 0, paso = 1; i < n; paso++) {
+        int j = i;
+        while (j < n && esFiltroPlan(&ops[j]))
+            j++;
+        if (j - i > 1) {
+            printf("  %d. En una pasada:\n", paso);
+            for (; i < j; i++) {
+                describirOperacionPlan(&ops[i], texto, sizeof(texto));
+                printf("       %s\n", texto);
             }
-            if (!dfActual) {
-                print_error("No hay dataframe activo");
-                continue;
+        } else {
+            describirOperacionPlan(&ops[i++], texto, sizeof(texto));
+            printf("  %d. %s\n", paso, texto);
+        }
+    }
+    if (n < plan->numOperaciones)
+        printf("  (%d operaciones sobre columnas derivadas que no se usan se han eliminado)\n",
+               plan->numOperaciones - n);
+    free(ops);
+}
+
+void lazyCLI(int activar) {
+    if (!dfActual) {
+        print_error("No hay dataframe activo");
+        return;
+    }
+    if (activar) {
+        if (dfActual->plan) {
+            printf(GREEN "El df ya está en modo lazy\n" RESET);
+            return;
+        }
+        dfActual->plan = calloc(1, sizeof(Plan));
+        if (!dfActual->plan) {
+            print_error("Error de memoria al activar el modo lazy");
+            return;
+        }
+        actualizarPrompt(dfActual);
+        printf(GREEN "Modo lazy activado: las operaciones se ejecutarán con view, save o collect\n" RESET);
+        return;
+    }
+    if (!dfActual->plan) {
+        printf(GREEN "El df no está en modo lazy\n" RESET);
+        return;
+    }
+    ejecutarPlanDFActual();
+    liberarPlan(dfActual->plan);
+    dfActual->plan = NULL;
+    actualizarPrompt(dfActual);
+    printf(GREEN "Modo lazy desactivado\n" RESET);
+}
+
+// Apunta una operación en el plan del stream o de dfActual. En modo lazy la
+// muestra se toma de nuevo en la primera operación tras cada ejecución.
+void apuntarOperacionCLI(const OperacionPlan *op) {
+    if (flujoActual) {
+        if (anadirOperacionPlan(&flujoActual->plan, op))
+            printf(GREEN "Operación %d añadida al stream; se aplicará al guardar\n" RESET,
+                   flujoActual->plan.numOperaciones);
+        return;
+    }
+    Plan *plan = dfActual->plan;
+    if (plan->numOperaciones == 0) {
+        liberarMemoriaDF(plan->muestra);
+        plan->muestra = muestraDF(dfActual, FILAS_MUESTRA_PLAN);
+        if (!plan->muestra)
+            return;
+    }
+    if (anadirOperacionPlan(plan, op))
+        printf(GREEN "Operación %d apuntada en el plan; se ejecutará con view, save o collect\n" RESET,
+               plan->numOperaciones);
+}
+
+// Macro para validar punteros
+#define VALIDAR_PTR(ptr)                                                                           \
+    do {                                                                                           \
+        if (!(ptr)) {                                                                              \
+            print_error("Puntero nulo");                                                           \
+            return 0;                                                                              \
+        }                                                                                          \
+    } while (0)
+
+int copiarColumna(Columna *destino, const Columna *origen, int64_t numFilas) {
+    VALIDAR_PTR(destino);
+    VALIDAR_PTR(origen);
+    if (numFilas < 0)
+        return 0;
+
+    // Reutiliza el espacio que ya reservó crearDF para la columna destino
+    if (!separarColumna(destino) ||
+        !prepararColumna(destino, origen->nombre, origen->tipo, origen->formato) ||
+        !reservarFilasColumna(destino, numFilas)) {
+        print_error("Fallo al asignar memoria en copiarColumna");
+        return 0;
+    }
+    if (ES_CATEGORIA(origen->formato) && destino->dic != origen->dic) {
+        liberarDiccionario(destino->dic);
+        destino->dic = retenerDiccionario(origen->dic);
+    }
+    if (origen->formato != FMT_TEXTO) {
+        memcpy(destino->valores, origen->valores, (size_t)numFilas * tamanoCelda(origen->formato));
+    } else if (!destino->arena || destino->arena == origen->arena) {
+        // Las cadenas no cambian nunca: basta con compartir la arena del origen
+        if (!destino->arena)
+            destino->arena = retenerArena(origen->arena);
+        memcpy(destino->datos, origen->datos, (size_t)numFilas * sizeof(char *));
+    } else {
+        for (int64_t i = 0; i < numFilas; i++) {
+            destino->datos[i] = NULL;
+            if (origen->datos[i] &&
+                !(destino->datos[i] =
+                      guardarTextoColumna(destino, origen->datos[i], strlen(origen->datos[i])))) {
+                print_error("Fallo al copiar dato en copiarColumna");
+                return 0;
             }
-            strncpy(dfActual->nombre, nuevo_nombre, 50);
-            dfActual->nombre[50] = '\0';
+        }
+    }
+    if (origen->validos)
+        memcpy(destino->validos, origen->validos, PALABRAS_BITMAP(numFilas) * sizeof(uint64_t));
+    destino->numFilas = numFilas;
+    return 1;
+}
+
+int anexarColumna(Columna *destino, const Columna *origen) {
+    VALIDAR_PTR(destino);
+    VALIDAR_PTR(origen);
+    if (destino->formato != origen->formato) {
+        print_error("Formatos de columna incompatibles en anexarColumna");
+        return 0;
+    }
+    if (ES_CATEGORIA(origen->formato) && destino->dic != origen->dic) {
+        print_error("Diccionarios distintos en anexarColumna");
+        return 0;
+    }
+    int64_t base = destino->numFilas;
+    if (!separarColumna(destino) || !reservarFilasColumna(destino, base + origen->numFilas)) {
+        print_error("Fallo al asignar memoria en anexarColumna");
+        return 0;
+    }
+    for (int64_t i = 0; origen->formato == FMT_TEXTO && i < origen->numFilas; i++) {
+        const char *texto = origen->datos[i];
+        destino->datos[base + i] = texto ? guardarTextoColumna(destino, texto, strlen(texto)) : NULL;
+        if (texto && !destino->datos[base + i]) {
+            destino->numFilas = base + i;
+            print_error("Fallo al copiar dato en anexarColumna");
+            return 0;
+        }
+    }
+    copiarValidos(destino, base, origen, origen->numFilas);
+    if (origen->formato != FMT_TEXTO) {
+        size_t tam = tamanoCelda(origen->formato);
+        memcpy((char *)destino->valores + (size_t)base * tam, origen->valores,
+               (size_t)origen->numFilas * tam);
+    }
+    destino->numFilas = base + origen->numFilas;
+    return 1;
+}
+
+int nombreDFUnico(const Lista *lista, const char *nombre) {
+    if (!lista || !nombre) return 0;
+    Nodo *actual = lista->primero;
+    while (actual) {
+        const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
+        if (strcmp(nombre_df, nombre) == 0) return 0;
+        actual = actual->siguiente;
+    }
+    return 1;
+}
+
+// Escribe en 'nombre' el primer "dfN" que no usa ningún dataframe de la lista
+void nombreLibreDF(char *nombre, size_t tam) {
+    int intento = 0;
+    do {
+        snprintf(nombre, tam, "df%d", intento);
+        intento++;
+    } while (!nombreDFUnico(&listaDF, nombre));
+}
+
+void cambiarDFPorNombre(Lista *lista, const char *nombre) {
+    if (!lista || !nombre) {
+        print_error("Nombre de dataframe inválido.");
+        return;
+    }
+    Nodo *nodoActual = lista->primero;
+    while (nodoActual) {
+        const char *nombre_df = (nodoActual->df->nombre[0] != '\0') ? nodoActual->df->nombre : nodoActual->df->indice;
+        if (strcmp(nombre_df, nombre) == 0) {
+            dfActual = nodoActual->df;
             actualizarPrompt(dfActual);
-            printf(GREEN "Nombre del dataframe cambiado a '%s'\n" RESET, dfActual->nombre);
-        } else if (strncmp(input, "prefix ", 7) == 0) {
-            char col[50], nueva_col[50];
-            int n = 0;
-            int parsed = sscanf(input + 7, "%49s n %49s", col, nueva_col);
-            char *ptr_n = strstr(input + 7, " n ");
-            if (parsed != 2 || !ptr_n) {
-                print_error("Uso: prefix <columna> n <nueva_columna>");
-                continue;
-            }
-            n = atoi(ptr_n + 3);
-            if (n <= 0) {
-                print_error("n debe ser un entero mayor que 0");
-                continue;
-            }
-            prefixCLI(col, n, nueva_col);
-        } else if (strcmp(input, "list") == 0) {
-            listCLI();
+            printf(GREEN "Cambiado a %s con %" PRId64 " filas y %d columnas\n" RESET, nombre_df,
+                       dfActual->numFilas, dfActual->numColumnas);
+            return;
+        }
+        nodoActual = nodoActual->siguiente;
+    }
+    print_error("Dataframe no encontrado por nombre.");
+}
+
+// Añade a dfActual una columna con los primeros n caracteres de otra
+int crearColumnaPrefijo(const char *nombre_col, int n, const char *nombre_nueva_col) {
+    if (!materializarDFActual())
+        return 0;
+    int idx = encontrarIndiceColumna(dfActual, nombre_col);
+    if (idx == -1) {
+        print_error("Columna no encontrada");
+        return 0;
+    }
+    if (dfActual->columnas[idx].tipo != TEXTO) {
+        print_error("La columna debe ser de tipo texto");
+        return 0;
+    }
+    if (encontrarIndiceColumna(dfActual, nombre_nueva_col) != -1) {
+        print_error("Ya existe una columna con ese nombre");
+        return 0;
+    }
+    // Las columnas existentes se comparten; solo se reserva la de prefijos
+    Dataframe *nuevo_df = derivarDFActual(-1, dfActual->numColumnas);
+    if (!nuevo_df)
+        return 0;
+    strncpy(nuevo_df->columnas[dfActual->numColumnas].nombre, nombre_nueva_col, 29);
+    nuevo_df->columnas[dfActual->numColumnas].nombre[29] = '\0';
+    Columna *nueva = &nuevo_df->columnas[dfActual->numColumnas];
+    nueva->tipo = TEXTO;
+    // Todas las celdas nulas comparten la misma cadena vacía
+    char *vacia = guardarTextoColumna(nueva, "", 0);
+    if (!vacia) {
+        liberarRecursosEnError(nuevo_df, "Error de memoria en prefixCLI");
+        return 0;
+    }
+    const Columna *origen = &dfActual->columnas[idx];
+    char buffer[64];
+    for (int64_t fila = 0; fila < dfActual->numFilas; fila++) {
+        const char *valor = ES_NULO(origen, fila) ? NULL : textoCelda(origen, fila, buffer, sizeof(buffer));
+        if (!valor) {
+            nueva->datos[fila] = vacia;
         } else {
-            // Intentar cambiar de dataframe por nombre
-            Nodo *actual = listaDF.primero;
-            while (actual) {
-                const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
-                if (strcmp(nombre_df, input) == 0) {
-                    cambiarDFPorNombre(&listaDF, input);
-                    return;
-                }
-                actual = actual->siguiente;
+            size_t len = strnlen(valor, (size_t)n);
+            nueva->datos[fila] = guardarTextoColumna(nueva, valor, len);
+            if (!nueva->datos[fila]) {
+                liberarRecursosEnError(nuevo_df, "Error de memoria en prefixCLI");
+                return 0;
             }
-            print_error("Comando no reconocido. Escriba un comando válido.");
         }
     }
+    // Las columnas compartidas conservan sus estadísticas; solo falta la nueva
+    calcularEstadisticasDF(nuevo_df);
+    reemplazarDFActual(nuevo_df);
+    return 1;
 }
 
-void filterCLI(Dataframe *df, const char *nombreColumna, const char *operador, void *valor) {
-    VALIDAR_DF_Y_PARAMETROS(df, nombreColumna);
-    VALIDAR_DF_Y_PARAMETROS(df, operador);
-    VALIDAR_DF_Y_PARAMETROS(df, valor);
-    int indice_col = encontrarIndiceColumna(df, nombreColumna);
-    if (indice_col == -1) {
-        print_error("Columna no encontrada");
+void prefixCLI(const char *nombre_col, int n, const char *nombre_nueva_col) {
+    if (!dfActual || !nombre_col || !nombre_nueva_col) {
+        print_error("Argumentos inválidos para prefixCLI");
         return;
     }
-    if (strcmp(operador, "eq") != 0 && strcmp(operador, "neq") != 0 &&
-        strcmp(operador, "gt") != 0 && strcmp(operador, "lt") != 0 &&
-        strcmp(operador, "get") != 0 && strcmp(operador, "let") != 0) {
-        print_error("Operador inválido. Use: eq, neq, gt, lt, get, let");
+    if (crearColumnaPrefijo(nombre_col, n, nombre_nueva_col))
+        printf(GREEN "Nueva columna '%s' creada con los primeros %d caracteres de '%s'\n" RESET, nombre_nueva_col, n, nombre_col);
+}
+
+void listCLI() {
+    Nodo *actual = listaDF.primero;
+    if (!actual) {
+        printf("No hay dataframes cargados en memoria.\n");
         return;
     }
+    while (actual) {
+        const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
+        printf("%s: %" PRId64 " filas, %d columnas\n", nombre_df, actual->df->numFilas,
+               actual->df->numColumnas);
+        actual = actual->siguiente;
+    }
+}
 
-    int nuevas_filas = 0;
-    for (int filaActual = 0; filaActual < df->numFilas; filaActual++) {
-        if (!df->columnas[indice_col].esNulo[filaActual]) {
-            void *valor_actual = df->columnas[indice_col].datos[filaActual];
-            if (valor_actual &&
-                comparar(valor_actual, valor, df->columnas[indice_col].tipo, operador)) {
-                nuevas_filas++;
-            }
+// Expresa 'col' con los códigos de 'dic' (en 'formato') sin cambiar el
+// diccionario. Devuelve 0, sin tocar la columna, si algún valor no está en él.
+static int recodificarColumna(Columna *col, Diccionario *dic, Formato formato) {
+    int64_t n = col->numFilas;
+    int32_t *mapa = NULL;
+    if (ES_CATEGORIA(col->formato)) {
+        // Cada código de origen se busca una sola vez
+        mapa = malloc((size_t)(col->dic->numValores > 0 ? col->dic->numValores : 1) * sizeof(int32_t));
+        if (!mapa)
+            return 0;
+        for (int32_t k = 0; k < col->dic->numValores; k++) {
+            int64_t pos = buscarEnDiccionario(dic, col->dic->valores[k], 0);
+            mapa[k] = pos < dic->numValores && strcmp(dic->valores[pos], col->dic->valores[k]) == 0
+                          ? (int32_t)pos : -1;
+        }
+    }
+    void *codigos = calloc((size_t)(col->capacidad > 0 ? col->capacidad : 1), tamanoCelda(formato));
+    int ok = codigos != NULL;
+    for (int64_t i = 0; ok && i < n; i++) {
+        if (ES_NULO(col, i))
+            continue;
+        int64_t codigo;
+        if (mapa) {
+            codigo = mapa[codigoCelda(col, i)];
+        } else {
+            const char *texto = col->datos[i];
+            codigo = texto ? buscarEnDiccionario(dic, texto, 0) : dic->numValores;
+            if (codigo < dic->numValores && strcmp(dic->valores[codigo], texto) != 0)
+                codigo = -1;
         }
+        ok = codigo >= 0 && codigo < dic->numValores;
+        if (ok && formato == FMT_CATEGORIA8)
+            ((uint8_t *)codigos)[i] = (uint8_t)codigo;
+        else if (ok)
+            ((uint16_t *)codigos)[i] = (uint16_t)codigo;
+    }
+    free(mapa);
+    if (!ok || !separarColumna(col)) {
+        free(codigos);
+        return 0;
     }
+    liberarArena(col->arena);
+    liberarDiccionario(col->dic);
+    col->arena = NULL;
+    col->dic = retenerDiccionario(dic);
+    free(col->valores);
+    col->valores = codigos;
+    col->formato = formato;
+    return 1;
+}
 
-    if (nuevas_filas == 0) {
-        printf(GREEN "No se encontraron filas que cumplan la condición\n" RESET);
+// Ajusta dos columnas con el mismo nombre para que compartan formato antes de
+// anexar 'nueva' a 'existente'. Si no hay un formato numérico común ambas
+// pasan a TEXTO.
+static int unificarColumnas(Columna *existente, Columna *nueva) {
+    // Si todos los valores nuevos están ya en el diccionario de la columna
+    // existente se usan sus códigos y ella no se toca. Si no, se decodifican
+    // ambas y addCLI vuelve a codificar el resultado.
+    if (ES_CATEGORIA(existente->formato) &&
+        (nueva->formato == FMT_TEXTO || ES_CATEGORIA(nueva->formato)) &&
+        recodificarColumna(nueva, existente->dic, existente->formato)) {
+        nueva->tipo = existente->tipo;
+        return 1;
+    }
+    if ((ES_CATEGORIA(existente->formato) && !convertirColumna(existente, FMT_TEXTO)) ||
+        (ES_CATEGORIA(nueva->formato) && !convertirColumna(nueva, FMT_TEXTO)))
+        return 0;
+    int nuevaTodoNula = 1;
+    for (int64_t i = 0; i < nueva->numFilas && nuevaTodoNula; i++)
+        nuevaTodoNula = ES_NULO(nueva, i);
+
+    if (existente->formato == nueva->formato) {
+        if (existente->tipo != nueva->tipo && !nuevaTodoNula)
+            existente->tipo = TEXTO;
+        nueva->tipo = existente->tipo;
+        return 1;
+    }
+    if ((nuevaTodoNula || nueva->formato == FMT_TEXTO) && convertirColumna(nueva, existente->formato)) {
+        nueva->tipo = existente->tipo;
+        return 1;
+    }
+    if (existente->formato == FMT_TEXTO && convertirColumna(existente, nueva->formato)) {
+        existente->tipo = nueva->tipo;
+        return 1;
+    }
+    if (existente->tipo == NUMERICO && nueva->tipo == NUMERICO)
+        return convertirColumna(existente, FMT_REAL) && convertirColumna(nueva, FMT_REAL);
+    existente->tipo = nueva->tipo = TEXTO;
+    return convertirColumna(existente, FMT_TEXTO) && convertirColumna(nueva, FMT_TEXTO);
+}
+
+// Una columna de dfActual mientras addCLI le anexa filas
+typedef struct {
+    Columna prueba;             // Copia compartida donde se unifica el formato
+    int cambiada;               // El formato cambió: 'prueba' sustituirá a la columna
+    int decodificada;           // Era categórica y pasó a TEXTO
+    EstadisticasColumna antes;  // Estadísticas de las filas que ya había
+    IndiceColumna *indice;      // Índice de la columna, por si hay que deshacer
+} AnexoColumna;
+
+void addCLI(const char *nombre_archivo, char sep) {
+    if (!dfActual) {
+        print_error("No hay dataframe activo");
+        return;
+    }
+    if (!materializarDFActual())
+        return;
+    ArchivoMapeado archivo;
+    if (!mapearArchivo(nombre_archivo, &archivo)) {
+        print_error("No se puede abrir el archivo");
         return;
     }
+    const char *p = archivo.datos;
+    const char *fin = archivo.datos + archivo.tamano;
 
-    Dataframe *nuevo_df = malloc(sizeof(Dataframe));
-    if (!nuevo_df) {
-        print_error("Error al asignar memoria para el nuevo dataframe");
+    // Contar columnas del archivo
+    int numColumnasArchivo = contarColumnasCSV(p, fin, sep);
+    if (numColumnasArchivo != dfActual->numColumnas) {
+        print_error("El archivo debe tener el mismo número de columnas que el dataframe actual");
+        desmapearArchivo(&archivo);
         return;
     }
 
-    if (!crearDF(nuevo_df, df->numColumnas, nuevas_filas, df->nombre)) {
-        free(nuevo_df);
-        print_error("Error al crear el nuevo dataframe");
+    // Leer el archivo en un dataframe temporal con sus propios tipos
+    Dataframe *temp = crearNuevoDataframe(numColumnasArchivo, 0, dfActual->nombre);
+    if (!temp) {
+        desmapearArchivo(&archivo);
         return;
     }
+    p = leerEncabezadoCSV(p, fin, sep, temp);
 
-    for (int columnaActual = 0; columnaActual < df->numColumnas; columnaActual++) {
-        strncpy(nuevo_df->columnas[columnaActual].nombre, df->columnas[columnaActual].nombre, 29);
-        nuevo_df->columnas[columnaActual].nombre[29] = '\0';
-        nuevo_df->columnas[columnaActual].tipo = df->columnas[columnaActual].tipo;
+    // Verificar nombres de columnas
+    for (int c = 0; c < numColumnasArchivo; c++) {
+        if (strcmp(temp->columnas[c].nombre, dfActual->columnas[c].nombre) != 0) {
+            char error_msg[120];
+            snprintf(error_msg, sizeof(error_msg),
+                     "Los nombres de las columnas deben coincidir: '%s' en el archivo, '%s' en el df",
+                     temp->columnas[c].nombre, dfActual->columnas[c].nombre);
+            desmapearArchivo(&archivo);
+            liberarRecursosEnError(temp, error_msg);
+            return;
+        }
     }
 
-    int fila_destino = 0;
-    for (int filaActual = 0; filaActual < df->numFilas; filaActual++) {
-        if (!df->columnas[indice_col].esNulo[filaActual]) {
-            void *valor_actual = df->columnas[indice_col].datos[filaActual];
-            if (valor_actual &&
-                comparar(valor_actual, valor, df->columnas[indice_col].tipo, operador)) {
-                if (!copiarFila(nuevo_df, df, filaActual, fila_destino)) {
-                    // Liberar filas ya copiadas
-                    for (int r = 0; r < fila_destino; r++) {
-                        for (int c = 0; c < nuevo_df->numColumnas; c++) {
-                            free(nuevo_df->columnas[c].datos[r]);
-                        }
-                    }
-                    for (int c = 0; c < nuevo_df->numColumnas; c++) {
-                        free(nuevo_df->columnas[c].datos);
-                        free(nuevo_df->columnas[c].esNulo);
-                    }
-                    free(nuevo_df->columnas);
-                    free(nuevo_df);
-                    print_error("Error al copiar fila en filterCLI");
-                    return;
-                }
-                fila_destino++;
+    int64_t filasArchivo = parsearFilasCSVParalelo(p, fin, sep, temp);
+    desmapearArchivo(&archivo);
+    if (filasArchivo < 0) {
+        liberarRecursosEnError(temp, "Error al asignar memoria");
+        return;
+    }
+    if (filasArchivo == 0) {
+        liberarRecursosEnError(temp, "El archivo no tiene datos");
+        return;
+    }
+    tiposColumnas(temp);
+
+    // Las filas nuevas se añaden al final de las columnas actuales, que crecen
+    // geométricamente: las existentes no se copian ni se vuelven a parsear.
+    // Los cambios de formato se hacen sobre una copia compartida que solo
+    // sustituye a la columna cuando todas han anexado sus filas, para que un
+    // fallo deje el df como estaba.
+    int64_t base = dfActual->numFilas;
+    int numColumnas = dfActual->numColumnas, preparadas = 0;
+    AnexoColumna *anexos = calloc((size_t)numColumnas, sizeof(AnexoColumna));
+    int ok = anexos != NULL;
+    for (int c = 0; ok && c < numColumnas; c++, preparadas++) {
+        Columna *destino = &dfActual->columnas[c];
+        AnexoColumna *a = &anexos[c];
+        a->antes = destino->estadisticas;
+        a->indice = retenerIndice(destino->indice);
+        ok = compartirColumna(&a->prueba, destino) && unificarColumnas(&a->prueba, &temp->columnas[c]);
+        a->cambiada = a->prueba.formato != destino->formato || a->prueba.valores != destino->valores;
+        a->decodificada = ES_CATEGORIA(destino->formato) && a->prueba.formato == FMT_TEXTO;
+        // Con el mismo formato las filas se anexan en la propia columna; de la
+        // copia solo queda el tipo
+        if (!a->cambiada)
+            liberarDatosColumna(&a->prueba);
+    }
+    for (int c = 0; ok && c < numColumnas; c++) {
+        Columna *col = anexos[c].cambiada ? &anexos[c].prueba : &dfActual->columnas[c];
+        ok = separarColumna(col) && reservarFilasColumna(col, base + filasArchivo);
+    }
+    for (int c = 0; ok && c < numColumnas; c++)
+        ok = anexarColumna(anexos[c].cambiada ? &anexos[c].prueba : &dfActual->columnas[c], &temp->columnas[c]);
+    liberarMemoriaDF(temp);
+
+    for (int c = 0; c < preparadas; c++) {
+        Columna *destino = &dfActual->columnas[c];
+        AnexoColumna *a = &anexos[c];
+        if (a->cambiada && ok) {
+            Columna vieja = *destino;
+            *destino = a->prueba;
+            liberarDatosColumna(&vieja);
+        } else if (a->cambiada) {
+            liberarDatosColumna(&a->prueba);
+        } else if (ok) {
+            destino->tipo = a->prueba.tipo;
+        } else {
+            // Las filas que ya había no han cambiado: siguen valiendo sus
+            // estadísticas y su índice
+            destino->numFilas = base;
+            destino->estadisticas = a->antes;
+            if (!destino->indice) {
+                destino->indice = a->indice;
+                a->indice = NULL;
             }
         }
+        liberarIndice(a->indice);
+    }
+    if (!ok) {
+        free(anexos);
+        print_error("Error al asignar memoria");
+        return;
+    }
+    dfActual->numFilas = base + filasArchivo;
+    // Solo se vuelven a codificar las columnas que hubo que decodificar. Las
+    // demás completan sus estadísticas con las filas nuevas; las que no pueden
+    // (cambio de formato) las recalculan enteras.
+    for (int c = 0; c < numColumnas; c++) {
+        if (anexos[c].decodificada)
+            codificarColumna(&dfActual->columnas[c]);
+        else if (!anexos[c].cambiada && anexos[c].antes.validas)
+            anexarEstadisticas(&dfActual->columnas[c], &anexos[c].antes, base);
     }
+    calcularEstadisticasDF(dfActual);
+    free(anexos);
 
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
     actualizarPrompt(dfActual);
+    printf(GREEN "Añadidas %" PRId64 " filas del archivo '%s'\n" RESET, filasArchivo, nombre_archivo);
+}
 
-    printf(GREEN "Filtrado completado. Quedan %d filas\n" RESET, nuevas_filas);
+// --- groupby -----------------------------------------------------------------
+// Cada hilo agrega un tramo de filas en su propia tabla hash (direccionamiento
+// abierto con sondeo lineal) y al final las tablas se combinan, en orden, en
+// la del primer hilo: los grupos salen en el orden en que aparecen. Las filas
+// se procesan en bloques: primero las claves de todo el bloque, columna a
+// columna, luego el grupo de cada fila y por último cada agregado, así que
+// dentro de los bucles no se pregunta por el formato. Si todas las claves son
+// categorías con pocas combinaciones, el grupo sale de un array indexado por
+// los códigos y solo se calcula el hash la primera vez que aparece cada uno.
+
+#define MAX_CLAVES_GROUPBY 8
+#define MAX_AGREGADOS 16
+#define FILAS_BLOQUE_GROUPBY 1024
+#define MIN_FILAS_HILO_GROUPBY 65536
+#define HUECOS_INICIALES_GROUPBY 1024
+#define MAX_DIRECTOS_GROUPBY 65536  // Combinaciones de códigos para indexar sin hash
+
+// Valor de un agregado: los enteros, fechas, códigos y cadenas (como
+// puntero) van en 'e' y los reales en 'r'
+typedef union {
+    int64_t e;
+    double r;
+} ValorAgregado;
+
+typedef struct {
+    int64_t cuenta;             // Valores no nulos vistos
+    ValorAgregado suma, minimo, maximo;
+} EstadoAgregado;
+
+typedef struct {
+    const Dataframe *df;
+    const Columna *claves[MAX_CLAVES_GROUPBY];
+    int numClaves;
+    int palabras;               // Palabras por clave: una por columna y la máscara de nulos
+    const Columna *columnas[MAX_AGREGADOS]; // NULL en count(*)
+    FuncionAgregado funciones[MAX_AGREGADOS];
+    int numAgregados;
+    int64_t directos;           // Combinaciones de códigos de las claves (0: se usa el hash)
+    int64_t pasos[MAX_CLAVES_GROUPBY]; // Peso de cada código en la combinación
+} ConsultaGroupBy;
+
+// Cada hueco guarda los 32 bits altos del hash y el grupo + 1 (0: libre)
+typedef struct {
+    uint64_t *huecos;
+    uint64_t mascara;           // Número de huecos - 1 (potencia de 2)
+    uint64_t *claves;           // 'palabras' por grupo
+    uint64_t *hashes;           // Hash de cada grupo, para crecer sin recalcularlo
+    EstadoAgregado *estados;    // 'numAgregados' por grupo
+    int64_t numGrupos, capacidad;
+} TablaGrupos;
+
+typedef struct {
+    const ConsultaGroupBy *consulta;
+    int64_t inicio, fin;        // Filas lógicas del df
+    TablaGrupos tabla;
+    int ok;
+} TareaGroupBy;
+
+static inline uint64_t mezclarHash(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 31);
 }
 
-void quarterCLI(const char *nombreColumna_fecha, const char *nombre_nueva_columna) {
-    VALIDAR_DF_Y_PARAMETROS(dfActual, nombreColumna_fecha);
-    VALIDAR_DF_Y_PARAMETROS(dfActual, nombre_nueva_columna);
+static void liberarTablaGrupos(TablaGrupos *t) {
+    free(t->huecos);
+    free(t->claves);
+    free(t->hashes);
+    free(t->estados);
+    memset(t, 0, sizeof(*t));
+}
 
-    int indice_col = encontrarIndiceColumna(dfActual, nombreColumna_fecha);
-    if (indice_col == -1 || dfActual->columnas[indice_col].tipo != FECHA) {
-        print_error("Columna de fecha no encontrada o tipo incorrecto");
-        return;
+static int iniciarTablaGrupos(TablaGrupos *t) {
+    memset(t, 0, sizeof(*t));
+    t->huecos = calloc(HUECOS_INICIALES_GROUPBY, sizeof(uint64_t));
+    t->mascara = HUECOS_INICIALES_GROUPBY - 1;
+    return t->huecos != NULL;
+}
+
+// Duplica los huecos y vuelve a colocar los grupos con su hash guardado
+static int crecerHuecos(TablaGrupos *t) {
+    uint64_t mascara = t->mascara * 2 + 1;
+    uint64_t *huecos = calloc(mascara + 1, sizeof(uint64_t));
+    if (!huecos)
+        return 0;
+    for (int64_t g = 0; g < t->numGrupos; g++) {
+        uint64_t h = t->hashes[g], i = h & mascara;
+        while (huecos[i])
+            i = (i + 1) & mascara;
+        huecos[i] = (h & 0xFFFFFFFF00000000ULL) | (uint64_t)(g + 1);
     }
+    free(t->huecos);
+    t->huecos = huecos;
+    t->mascara = mascara;
+    return 1;
+}
 
-    if (encontrarIndiceColumna(dfActual, nombre_nueva_columna) != -1) {
-        print_error("Ya existe una columna con ese nombre");
-        return;
+static int clavesIguales(const ConsultaGroupBy *q, const uint64_t *a, const uint64_t *b) {
+    // La última palabra es la máscara de nulos; un nulo tiene la palabra a 0
+    if (a[q->numClaves] != b[q->numClaves])
+        return 0;
+    for (int c = 0; c < q->numClaves; c++) {
+        if (a[c] != b[c] &&
+            (q->claves[c]->formato != FMT_TEXTO ||
+             strcmp((const char *)(uintptr_t)a[c], (const char *)(uintptr_t)b[c]) != 0))
+            return 0;
+    }
+    return 1;
+}
+
+// Grupo de la clave, que se crea vacío si no existía; -1 si falta memoria
+static int64_t buscarGrupo(TablaGrupos *t, const ConsultaGroupBy *q, const uint64_t *clave, uint64_t h) {
+    uint64_t etiqueta = h & 0xFFFFFFFF00000000ULL;
+    uint64_t i = h & t->mascara;
+    for (; t->huecos[i]; i = (i + 1) & t->mascara) {
+        if ((t->huecos[i] & 0xFFFFFFFF00000000ULL) != etiqueta)
+            continue;
+        int64_t g = (int64_t)(t->huecos[i] & 0xFFFFFFFFULL) - 1;
+        if (clavesIguales(q, &t->claves[g * q->palabras], clave))
+            return g;
     }
 
-    Dataframe *nuevo_df =
-        crearNuevoDataframe(dfActual->numColumnas + 1, dfActual->numFilas, dfActual->nombre);
-    if (!nuevo_df)
-        return;
+    if (t->numGrupos == t->capacidad) {
+        int64_t capacidad = t->capacidad ? t->capacidad * 2 : HUECOS_INICIALES_GROUPBY / 2;
+        uint64_t *claves = realloc(t->claves, (size_t)capacidad * q->palabras * sizeof(uint64_t));
+        if (claves)
+            t->claves = claves;
+        uint64_t *hashes = realloc(t->hashes, (size_t)capacidad * sizeof(uint64_t));
+        if (hashes)
+            t->hashes = hashes;
+        EstadoAgregado *estados =
+            realloc(t->estados, (size_t)capacidad * (q->numAgregados ? q->numAgregados : 1) * sizeof(EstadoAgregado));
+        if (estados)
+            t->estados = estados;
+        if (!claves || !hashes || !estados || capacidad > UINT32_MAX)
+            return -1;
+        t->capacidad = capacidad;
+    }
+    int64_t g = t->numGrupos++;
+    memcpy(&t->claves[g * q->palabras], clave, (size_t)q->palabras * sizeof(uint64_t));
+    t->hashes[g] = h;
+    memset(&t->estados[g * q->numAgregados], 0, (size_t)q->numAgregados * sizeof(EstadoAgregado));
+    t->huecos[i] = etiqueta | (uint64_t)(g + 1);
+    // Se mantiene la tabla a menos de la mitad para que los sondeos sean cortos
+    if ((uint64_t)t->numGrupos * 2 > t->mascara && !crecerHuecos(t))
+        return -1;
+    return g;
+}
 
-    // Copiar columnas antes de la columna de fecha
-    for (int columnaActual = 0; columnaActual <= indice_col; columnaActual++) {
-        if (!copiarColumna(&nuevo_df->columnas[columnaActual], &dfActual->columnas[columnaActual],
-                           dfActual->numFilas)) {
-            for (int k = 0; k < columnaActual; k++) {
-                for (int f = 0; f < dfActual->numFilas; f++)
-                    free(nuevo_df->columnas[k].datos[f]);
-                free(nuevo_df->columnas[k].datos);
-                free(nuevo_df->columnas[k].esNulo);
+// Claves de las filas del bloque: el valor de cada columna (0 si es nulo)
+// y la máscara de nulos
+static void calcularClaves(const ConsultaGroupBy *q, const int64_t *filas, int n, uint64_t *claves) {
+    int p = q->palabras, k = q->numClaves;
+    for (int r = 0; r < n; r++)
+        claves[r * p + k] = 0;
+    for (int c = 0; c < k; c++) {
+        const Columna *col = q->claves[c];
+        uint64_t *destino = claves + c;
+        switch (col->formato) {
+        case FMT_ENTERO:
+            for (int r = 0; r < n; r++)
+                destino[r * p] = (uint64_t)col->enteros[filas[r]];
+            break;
+        case FMT_REAL:
+            for (int r = 0; r < n; r++) {
+                // 0.0 y -0.0 van al mismo grupo, y todos los NaN a otro
+                double x = col->reales[filas[r]];
+                if (x == 0.0)
+                    x = 0.0;
+                if (isnan(x))
+                    x = NAN;
+                memcpy(&destino[r * p], &x, sizeof(x));
             }
-            free(nuevo_df->columnas);
-            free(nuevo_df);
-            print_error("Error al copiar columna en quarterCLI");
-            return;
+            break;
+        case FMT_FECHA:
+            for (int r = 0; r < n; r++)
+                destino[r * p] = (uint32_t)col->fechas[filas[r]];
+            break;
+        case FMT_CATEGORIA8:
+            for (int r = 0; r < n; r++)
+                destino[r * p] = col->codigos8[filas[r]];
+            break;
+        case FMT_CATEGORIA16:
+            for (int r = 0; r < n; r++)
+                destino[r * p] = col->codigos16[filas[r]];
+            break;
+        case FMT_TEXTO:
+        default:
+            for (int r = 0; r < n; r++) {
+                destino[r * p] = (uint64_t)(uintptr_t)col->datos[filas[r]];
+                if (!destino[r * p])
+                    claves[r * p + k] |= 1ULL << c;
+            }
+            break;
         }
-    }
-
-    // Nueva columna de trimestre
-    strncpy(nuevo_df->columnas[indice_col + 1].nombre, nombre_nueva_columna, 29);
-    nuevo_df->columnas[indice_col + 1].nombre[29] = '\0';
-    nuevo_df->columnas[indice_col + 1].tipo = TEXTO;
-    nuevo_df->columnas[indice_col + 1].datos = malloc(dfActual->numFilas * sizeof(char *));
-    nuevo_df->columnas[indice_col + 1].esNulo = malloc(dfActual->numFilas * sizeof(EstadoNulo));
-    if (!nuevo_df->columnas[indice_col + 1].datos || !nuevo_df->columnas[indice_col + 1].esNulo) {
-        for (int k = 0; k <= indice_col; k++) {
-            for (int f = 0; f < dfActual->numFilas; f++)
-                free(nuevo_df->columnas[k].datos[f]);
-            free(nuevo_df->columnas[k].datos);
-            free(nuevo_df->columnas[k].esNulo);
-        }
-        free(nuevo_df->columnas);
-        free(nuevo_df);
-        print_error("Error al asignar memoria para columna trimestre en quarterCLI");
-        return;
-    }
-
-    // Copiar columnas después de la columna de fecha
-    for (int columnaActual = indice_col + 1; columnaActual < dfActual->numColumnas;
-         columnaActual++) {
-        if (!copiarColumna(&nuevo_df->columnas[columnaActual + 1],
-                           &dfActual->columnas[columnaActual], dfActual->numFilas)) {
-            for (int k = 0; k <= columnaActual; k++) {
-                for (int f = 0; f < dfActual->numFilas; f++)
-                    free(nuevo_df->columnas[k].datos[f]);
-                free(nuevo_df->columnas[k].datos);
-                free(nuevo_df->columnas[k].esNulo);
+        for (int r = 0; r < n; r++) {
+            if (ES_NULO(col, filas[r])) {
+                destino[r * p] = 0;
+                claves[r * p + k] |= 1ULL << c;
             }
-            free(nuevo_df->columnas);
-            free(nuevo_df);
-            print_error("Error al copiar columna en quarterCLI");
-            return;
         }
     }
+}
 
-    // Calcular trimestre
-    for (int filaActual = 0; filaActual < dfActual->numFilas; filaActual++) {
-        if (dfActual->columnas[indice_col].esNulo[filaActual]) {
-            nuevo_df->columnas[indice_col + 1].datos[filaActual] = strdup("#N/A");
-            nuevo_df->columnas[indice_col + 1].esNulo[filaActual] = NO_NULO;
-            continue;
-        }
-        struct tm fecha = {0};
-        const char *fecha_str = dfActual->columnas[indice_col].datos[filaActual];
-        if (sscanf(fecha_str, "%d-%d-%d", &fecha.tm_year, &fecha.tm_mon, &fecha.tm_mday) != 3) {
-            nuevo_df->columnas[indice_col + 1].datos[filaActual] = strdup("#N/A");
-            nuevo_df->columnas[indice_col + 1].esNulo[filaActual] = NO_NULO;
-            continue;
+// Hash de cada clave; las cadenas por su contenido
+static void hashearClaves(const ConsultaGroupBy *q, const uint64_t *claves, int n, uint64_t *hashes) {
+    int p = q->palabras;
+    for (int r = 0; r < n; r++) {
+        const uint64_t *clave = &claves[r * p];
+        uint64_t h = 0x9E3779B97F4A7C15ULL;
+        for (int c = 0; c < p; c++) {
+            uint64_t v = clave[c];
+            if (c < q->numClaves && q->claves[c]->formato == FMT_TEXTO && v)
+                v = hashTexto((const char *)(uintptr_t)v);
+            h = mezclarHash(h, v);
         }
-        const char *trimestre;
-        if (fecha.tm_mon >= 1 && fecha.tm_mon <= 3)
-            trimestre = "Q1";
-        else if (fecha.tm_mon >= 4 && fecha.tm_mon <= 6)
-            trimestre = "Q2";
-        else if (fecha.tm_mon >= 7 && fecha.tm_mon <= 9)
-            trimestre = "Q3";
-        else if (fecha.tm_mon >= 10 && fecha.tm_mon <= 12)
-            trimestre = "Q4";
-        else
-            trimestre = "#N/A";
-        nuevo_df->columnas[indice_col + 1].datos[filaActual] = strdup(trimestre);
-        nuevo_df->columnas[indice_col + 1].esNulo[filaActual] = NO_NULO;
+        // Mezcla final para que los bits bajos (el hueco) dependan de toda la clave
+        h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDULL;
+        hashes[r] = h ^ (h >> 29);
     }
+}
 
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
-    actualizarPrompt(dfActual);
-    printf(GREEN "Nueva columna '%s' creada con trimestres\n" RESET, nombre_nueva_columna);
+// a < b para los valores de min/max de la columna
+static int menorAgregado(const Columna *col, ValorAgregado a, ValorAgregado b) {
+    if (col->formato == FMT_REAL)
+        return a.r < b.r;
+    if (col->formato == FMT_TEXTO)
+        return strcmp((const char *)(uintptr_t)a.e, (const char *)(uintptr_t)b.e) < 0;
+    return a.e < b.e;
 }
 
-void sortCLI(const char *nombreColumna, int descendente) {
-    if (!dfActual) {
-        print_error("No hay df cargado.");
-        return;
+static void acumularValor(EstadoAgregado *e, FuncionAgregado f, const Columna *col, ValorAgregado v) {
+    if (f == AGG_SUM || f == AGG_MEAN) {
+        if (col->formato == FMT_REAL)
+            e->suma.r += v.r;
+        else
+            e->suma.e += v.e;
+    } else if (f == AGG_MIN && (e->cuenta == 0 || menorAgregado(col, v, e->minimo))) {
+        e->minimo = v;
+    } else if (f == AGG_MAX && (e->cuenta == 0 || menorAgregado(col, e->maximo, v))) {
+        e->maximo = v;
     }
+    e->cuenta++;
+}
 
-    int indice_columna = encontrarIndiceColumna(dfActual, nombreColumna);
-    if (indice_columna == -1) {
-        print_error("Columna no encontrada.");
+// Actualiza el agregado 'a' con las filas del bloque
+static void acumularBloque(const ConsultaGroupBy *q, int a, EstadoAgregado *estados, const int64_t *filas,
+                           const int64_t *grupos, int n) {
+    int numAgregados = q->numAgregados;
+    const Columna *col = q->columnas[a];
+    FuncionAgregado f = q->funciones[a];
+    if (!col) {
+        for (int r = 0; r < n; r++)
+            estados[grupos[r] * numAgregados + a].cuenta++;
         return;
     }
 
-    ordenarDataframe(dfActual, indice_columna, descendente);
-
-    printf(GREEN "df ordenado por columna '%s' en orden %s.\n" RESET, nombreColumna,
-           descendente ? "descendente" : "ascendente");
-}
-
-void saveCLI(const char *nombre_archivo) {
-    if (!dfActual) {
-        print_error("No hay df activo para guardar.");
-        return;
+    // Los valores del bloque se reúnen antes para no elegir formato por fila
+    ValorAgregado valores[FILAS_BLOQUE_GROUPBY];
+    uint8_t validos[FILAS_BLOQUE_GROUPBY];
+    for (int r = 0; r < n; r++)
+        validos[r] = !ES_NULO(col, filas[r]);
+    switch (col->formato) {
+    case FMT_ENTERO:
+        for (int r = 0; r < n; r++)
+            valores[r].e = col->enteros[filas[r]];
+        break;
+    case FMT_REAL:
+        for (int r = 0; r < n; r++)
+            valores[r].r = col->reales[filas[r]];
+        break;
+    case FMT_FECHA:
+        for (int r = 0; r < n; r++)
+            valores[r].e = col->fechas[filas[r]];
+        break;
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        for (int r = 0; r < n; r++)
+            valores[r].e = codigoCelda(col, filas[r]);
+        break;
+    case FMT_TEXTO:
+    default:
+        for (int r = 0; r < n; r++) {
+            valores[r].e = (int64_t)(uintptr_t)col->datos[filas[r]];
+            validos[r] &= valores[r].e != 0;
+        }
+        break;
     }
 
-    char nombre_saveCLI[MAX_FILENAME];
-    if (nombre_archivo == NULL || strlen(nombre_archivo) == 0) {
-        snprintf(nombre_saveCLI, sizeof(nombre_saveCLI), "%s.csv", dfActual->nombre);
+    if (f == AGG_COUNT) {
+        for (int r = 0; r < n; r++)
+            estados[grupos[r] * numAgregados + a].cuenta += validos[r];
+    } else if ((f == AGG_SUM || f == AGG_MEAN) && col->formato == FMT_REAL) {
+        for (int r = 0; r < n; r++) {
+            EstadoAgregado *e = &estados[grupos[r] * numAgregados + a];
+            e->suma.r += validos[r] ? valores[r].r : 0.0;
+            e->cuenta += validos[r];
+        }
+    } else if (f == AGG_SUM || f == AGG_MEAN) {
+        for (int r = 0; r < n; r++) {
+            EstadoAgregado *e = &estados[grupos[r] * numAgregados + a];
+            e->suma.e += validos[r] ? valores[r].e : 0;
+            e->cuenta += validos[r];
+        }
     } else {
-        strncpy(nombre_saveCLI, nombre_archivo, sizeof(nombre_saveCLI) - 1);
-        nombre_saveCLI[sizeof(nombre_saveCLI) - 1] = '\0';
-        cortarEspacios(nombre_saveCLI);
+        for (int r = 0; r < n; r++) {
+            if (validos[r])
+                acumularValor(&estados[grupos[r] * numAgregados + a], f, col, valores[r]);
+        }
     }
+}
 
-    if (strlen(nombre_saveCLI) < 4 ||
-        strcmp(nombre_saveCLI + strlen(nombre_saveCLI) - 4, ".csv") != 0) {
-        strncat(nombre_saveCLI, ".csv", sizeof(nombre_saveCLI) - strlen(nombre_saveCLI) - 1);
+// Grupo de cada fila del bloque a partir de la combinación de códigos de sus
+// claves; 'directo' guarda el grupo de cada combinación (-1: aún no visto)
+static int gruposDirectos(TablaGrupos *t, const ConsultaGroupBy *q, int64_t *directo, const uint64_t *claves,
+                          int n, int64_t *grupos) {
+    int p = q->palabras, k = q->numClaves;
+    for (int r = 0; r < n; r++) {
+        const uint64_t *clave = &claves[r * p];
+        int64_t codigo = 0;
+        for (int c = 0; c < k; c++)
+            codigo += ((clave[k] >> c) & 1 ? q->claves[c]->dic->numValores : (int64_t)clave[c]) * q->pasos[c];
+        if (directo[codigo] < 0) {
+            uint64_t h;
+            hashearClaves(q, clave, 1, &h);
+            if ((directo[codigo] = buscarGrupo(t, q, clave, h)) < 0)
+                return 0;
+        }
+        grupos[r] = directo[codigo];
     }
+    return 1;
+}
 
-    FILE *file = fopen(nombre_saveCLI, "w");
-    if (!file) {
-        char error_msg[MAX_FILENAME + 50];
-        snprintf(error_msg, sizeof(error_msg), "No se puede crear el archivo: %s", nombre_saveCLI);
-        print_error(error_msg);
-        return;
+static void *hiloGroupBy(void *arg) {
+    TareaGroupBy *t = arg;
+    const ConsultaGroupBy *q = t->consulta;
+    int64_t filas[FILAS_BLOQUE_GROUPBY], grupos[FILAS_BLOQUE_GROUPBY];
+    uint64_t hashes[FILAS_BLOQUE_GROUPBY];
+    int p = q->palabras;
+    uint64_t *claves = malloc((size_t)FILAS_BLOQUE_GROUPBY * p * sizeof(uint64_t));
+    int64_t *directo = q->directos ? malloc((size_t)q->directos * sizeof(int64_t)) : NULL;
+    t->ok = claves && (!q->directos || directo) && iniciarTablaGrupos(&t->tabla);
+    for (int64_t i = 0; t->ok && i < q->directos; i++)
+        directo[i] = -1;
+
+    for (int64_t i = t->inicio; t->ok && i < t->fin; i += FILAS_BLOQUE_GROUPBY) {
+        int n = t->fin - i < FILAS_BLOQUE_GROUPBY ? (int)(t->fin - i) : FILAS_BLOQUE_GROUPBY;
+        for (int r = 0; r < n; r++)
+            filas[r] = FILA_FISICA(q->df, i + r);
+        calcularClaves(q, filas, n, claves);
+        if (q->directos) {
+            t->ok = gruposDirectos(&t->tabla, q, directo, claves, n, grupos);
+        } else {
+            hashearClaves(q, claves, n, hashes);
+            for (int r = 0; r < n; r++)
+                __builtin_prefetch(&t->tabla.huecos[hashes[r] & t->tabla.mascara]);
+            for (int r = 0; r < n && t->ok; r++)
+                t->ok = (grupos[r] = buscarGrupo(&t->tabla, q, &claves[r * p], hashes[r])) >= 0;
+        }
+        for (int a = 0; t->ok && a < q->numAgregados; a++)
+            acumularBloque(q, a, t->tabla.estados, filas, grupos, n);
     }
+    free(claves);
+    free(directo);
+    return NULL;
+}
 
-    for (int col = 0; col < dfActual->numColumnas; col++) {
-        fprintf(file, "%s", dfActual->columnas[col].nombre);
-        if (col < dfActual->numColumnas - 1) {
-            fprintf(file, ",");
-        }
-    }
-    fprintf(file, "\n");
-
-    for (int row = 0; row < dfActual->numFilas; row++) {
-        for (int col = 0; col < dfActual->numColumnas; col++) {
-            if (dfActual->columnas[col].esNulo[row]) {
-            } else if (dfActual->columnas[col].datos[row] != NULL) {
-                char *valor = (char *)dfActual->columnas[col].datos[row];
-                int contiene_comas = (strchr(valor, ',') != NULL || strchr(valor, '"') != NULL);
-
-                if (contiene_comas) {
-                    fprintf(file, "\"");
-                    for (char *c = valor; *c; c++) {
-                        if (*c == '"') {
-                            fprintf(file,
-                                    "\"\""); // Comillas dobles para escaparlas
-                        } else {
-                            fprintf(file, "%c", *c);
-                        }
-                    }
-                    fprintf(file, "\"");
-                } else {
-                    fprintf(file, "%s", valor);
-                }
-            }
-
-            if (col < dfActual->numColumnas - 1) {
-                fprintf(file, ",");
-            }
+// Suma a 'destino' los grupos de 'origen'
+static int combinarTablas(TablaGrupos *destino, const TablaGrupos *origen, const ConsultaGroupBy *q) {
+    for (int64_t g = 0; g < origen->numGrupos; g++) {
+        int64_t d = buscarGrupo(destino, q, &origen->claves[g * q->palabras], origen->hashes[g]);
+        if (d < 0)
+            return 0;
+        for (int a = 0; a < q->numAgregados; a++) {
+            EstadoAgregado *e = &destino->estados[d * q->numAgregados + a];
+            const EstadoAgregado *o = &origen->estados[g * q->numAgregados + a];
+            const Columna *col = q->columnas[a];
+            if (o->cuenta == 0)
+                continue;
+            if (q->funciones[a] == AGG_MIN && (e->cuenta == 0 || menorAgregado(col, o->minimo, e->minimo)))
+                e->minimo = o->minimo;
+            if (q->funciones[a] == AGG_MAX && (e->cuenta == 0 || menorAgregado(col, e->maximo, o->maximo)))
+                e->maximo = o->maximo;
+            if (col && col->formato == FMT_REAL)
+                e->suma.r += o->suma.r;
+            else
+                e->suma.e += o->suma.e;
+            e->cuenta += o->cuenta;
         }
-        fprintf(file, "\n");
     }
+    return 1;
+}
 
-    fclose(file);
-    printf(GREEN "df guardado exitosamente en %s\n" RESET, nombre_saveCLI);
+// Prepara 'destino' como columna de valores del formato de 'origen': las
+// cadenas y los diccionarios se comparten
+static int prepararColumnaComo(Columna *destino, const Columna *origen, const char *nombre) {
+    if (!prepararColumna(destino, nombre, origen->tipo, origen->formato))
+        return 0;
+    if (origen->formato == FMT_TEXTO)
+        destino->arena = retenerArena(origen->arena);
+    else if (ES_CATEGORIA(origen->formato))
+        destino->dic = retenerDiccionario(origen->dic);
+    return 1;
 }
 
-void metaCLI() {
-    if (!dfActual) {
-        print_error("No hay df cargado.");
-        return;
+// Escribe en la fila g un valor con el formato de la columna
+static void escribirValorAgregado(Columna *col, int64_t g, ValorAgregado v) {
+    switch (col->formato) {
+    case FMT_ENTERO:
+        col->enteros[g] = v.e;
+        break;
+    case FMT_REAL:
+        col->reales[g] = v.r;
+        break;
+    case FMT_FECHA:
+        col->fechas[g] = (int32_t)v.e;
+        break;
+    case FMT_CATEGORIA8:
+        col->codigos8[g] = (uint8_t)v.e;
+        break;
+    case FMT_CATEGORIA16:
+        col->codigos16[g] = (uint16_t)v.e;
+        break;
+    case FMT_TEXTO:
+    default:
+        col->datos[g] = (char *)(uintptr_t)v.e;
+        break;
     }
+}
 
-    for (int col = 0; col < dfActual->numColumnas; col++) {
-        int contador_nulos = 0;
+static const char *nombreFuncionAgregado(FuncionAgregado f) {
+    static const char *nombres[] = {"count", "sum", "mean", "min", "max"};
+    return nombres[f];
+}
 
-        for (int row = 0; row < dfActual->numFilas; row++) {
-            if (dfActual->columnas[col].esNulo[row]) {
-                contador_nulos++;
+static Dataframe *resultadoGroupBy(const ConsultaGroupBy *q, const TablaGrupos *t, const char *nombre) {
+    int numColumnas = q->numClaves + q->numAgregados;
+    Dataframe *res = crearNuevoDataframe(numColumnas, t->numGrupos, nombre);
+    if (!res)
+        return NULL;
+    for (int c = 0; c < q->numClaves; c++) {
+        Columna *col = &res->columnas[c];
+        if (!prepararColumnaComo(col, q->claves[c], q->claves[c]->nombre)) {
+            liberarRecursosEnError(res, "Error de memoria en groupby");
+            return NULL;
+        }
+        for (int64_t g = 0; g < t->numGrupos; g++) {
+            const uint64_t *clave = &t->claves[g * q->palabras];
+            if ((clave[q->numClaves] >> c) & 1) {
+                MARCAR_NULO(col, g);
+                continue;
             }
+            ValorAgregado v;
+            memcpy(&v, &clave[c], sizeof(v));
+            escribirValorAgregado(col, g, v);
         }
+    }
 
-        char *tipo;
-        switch (dfActual->columnas[col].tipo) {
-        case TEXTO:
-            tipo = "Texto";
-            break;
-        case NUMERICO:
-            tipo = "Numerico";
-            break;
-        case FECHA:
-            tipo = "Fecha";
-            break;
-        default:
-            tipo = "Desconocido";
-            break;
+    for (int a = 0; a < q->numAgregados; a++) {
+        Columna *col = &res->columnas[q->numClaves + a];
+        const Columna *origen = q->columnas[a];
+        FuncionAgregado f = q->funciones[a];
+        char nombreCol[MAX_NOMBRE_COLUMNA + 8];
+        if (origen)
+            snprintf(nombreCol, sizeof(nombreCol), "%s_%s", nombreFuncionAgregado(f), origen->nombre);
+        else
+            snprintf(nombreCol, sizeof(nombreCol), "count");
+        int ok;
+        if (f == AGG_COUNT)
+            ok = prepararColumna(col, nombreCol, NUMERICO, FMT_ENTERO);
+        else if (f == AGG_MEAN)
+            ok = prepararColumna(col, nombreCol, NUMERICO, FMT_REAL);
+        else
+            ok = prepararColumnaComo(col, origen, nombreCol);
+        if (!ok) {
+            liberarRecursosEnError(res, "Error de memoria en groupby");
+            return NULL;
+        }
+        for (int64_t g = 0; g < t->numGrupos; g++) {
+            const EstadoAgregado *e = &t->estados[g * q->numAgregados + a];
+            if (f == AGG_COUNT) {
+                col->enteros[g] = e->cuenta;
+            } else if (e->cuenta == 0) {
+                MARCAR_NULO(col, g);
+            } else if (f == AGG_MEAN) {
+                col->reales[g] = (origen->formato == FMT_REAL ? e->suma.r : (double)e->suma.e) / (double)e->cuenta;
+            } else {
+                escribirValorAgregado(col, g, f == AGG_SUM ? e->suma : f == AGG_MIN ? e->minimo : e->maximo);
+            }
         }
+    }
+    return res;
+}
+
+// Agrupa df por las columnas 'claves' y calcula los agregados de cada grupo
+// en un df nuevo: primero las claves y después un agregado por columna
+Dataframe *agruparDF(const Dataframe *df, const int *claves, int numClaves, const Agregado *agregados,
+                     int numAgregados, const char *nombre) {
+    ConsultaGroupBy q = {.df = df, .numClaves = numClaves, .palabras = numClaves + 1,
+                         .numAgregados = numAgregados};
+    q.directos = 1;
+    for (int c = 0; c < numClaves; c++) {
+        q.claves[c] = &df->columnas[claves[c]];
+        q.pasos[c] = q.directos;
+        // Cada código más uno para los nulos
+        if (!ES_CATEGORIA(q.claves[c]->formato) ||
+            (q.directos *= q.claves[c]->dic->numValores + 1) > MAX_DIRECTOS_GROUPBY)
+            q.directos = 0;
+    }
+    for (int a = 0; a < numAgregados; a++) {
+        q.funciones[a] = agregados[a].funcion;
+        q.columnas[a] = agregados[a].columna >= 0 ? &df->columnas[agregados[a].columna] : NULL;
+    }
 
-        printf(GREEN "%s: %s (Valores nulos: %d)\n" RESET, dfActual->columnas[col].nombre, tipo,
-               contador_nulos);
+    int numHilos = numeroHilos();
+    if (numHilos > df->numFilas / MIN_FILAS_HILO_GROUPBY)
+        numHilos = (int)(df->numFilas / MIN_FILAS_HILO_GROUPBY);
+    if (numHilos < 1)
+        numHilos = 1;
+    TareaGroupBy tareas[MAX_HILOS];
+    for (int t = 0; t < numHilos; t++) {
+        tareas[t].consulta = &q;
+        tareas[t].inicio = df->numFilas * t / numHilos;
+        tareas[t].fin = df->numFilas * (t + 1) / numHilos;
     }
+    ejecutarEnHilos(hiloGroupBy, tareas, sizeof(TareaGroupBy), numHilos);
+
+    int ok = 1;
+    for (int t = 0; t < numHilos; t++)
+        ok = ok && tareas[t].ok;
+    for (int t = 1; ok && t < numHilos; t++)
+        ok = combinarTablas(&tareas[0].tabla, &tareas[t].tabla, &q);
+    Dataframe *res = ok ? resultadoGroupBy(&q, &tareas[0].tabla, nombre) : NULL;
+    for (int t = 0; t < numHilos; t++)
+        liberarTablaGrupos(&tareas[t].tabla);
+    if (!ok)
+        print_error("Error de memoria en groupby");
+    return res;
 }
 
-void viewCLI(int n) {
+// groupby <col> [<col> ...] agg <función>(<col>) [<función>(<col>) ...]
+void groupbyCLI(const char *argumentos) {
     if (!dfActual) {
-        print_error("No hay df cargado.");
+        print_error("No hay dataframe activo");
         return;
     }
+    char texto[MAX_LINE_LENGTH];
+    snprintf(texto, sizeof(texto), "%s", argumentos);
+    int claves[MAX_CLAVES_GROUPBY];
+    Agregado agregados[MAX_AGREGADOS];
+    int numClaves = 0, numAgregados = 0, enAgregados = 0;
+    char error_msg[MAX_LINE_LENGTH + 80];
+
+    for (char *tok = strtok(texto, " \t,"); tok; tok = strtok(NULL, " \t,")) {
+        if (!enAgregados) {
+            if (strcasecmp(tok, "agg") == 0) {
+                enAgregados = 1;
+                continue;
+            }
+            int c = encontrarIndiceColumna(dfActual, tok);
+            if (c < 0) {
+                snprintf(error_msg, sizeof(error_msg), "Columna no encontrada: %s", tok);
+                print_error(error_msg);
+                return;
+            }
+            if (numClaves == MAX_CLAVES_GROUPBY) {
+                print_error("Demasiadas columnas de agrupación");
+                return;
+            }
+            claves[numClaves++] = c;
+            continue;
+        }
 
-    for (int j = 0; j < dfActual->numColumnas; j++) {
-        printf("%s", dfActual->columnas[j].nombre);
-        if (j < dfActual->numColumnas - 1) {
-            printf(",");
+        char *abre = strchr(tok, '('), *cierra = strrchr(tok, ')');
+        if (!abre || !cierra || cierra < abre || cierra[1] != '\0' || numAgregados == MAX_AGREGADOS) {
+            print_error("Uso: groupby <columna> [<columna> ...] agg <count|sum|mean|min|max>(<columna>) ...");
+            return;
+        }
+        *abre = *cierra = '\0';
+        Agregado *agg = &agregados[numAgregados];
+        int f = 0;
+        while (f <= AGG_MAX && strcasecmp(tok, nombreFuncionAgregado((FuncionAgregado)f)) != 0)
+            f++;
+        if (f > AGG_MAX) {
+            snprintf(error_msg, sizeof(error_msg), "Función de agregado no válida: %s", tok);
+            print_error(error_msg);
+            return;
+        }
+        agg->funcion = (FuncionAgregado)f;
+        agg->columna = -1;
+        if (strcmp(abre + 1, "*") != 0 || f != AGG_COUNT) {
+            agg->columna = encontrarIndiceColumna(dfActual, abre + 1);
+            if (agg->columna < 0) {
+                snprintf(error_msg, sizeof(error_msg), "Columna no encontrada: %s", abre + 1);
+                print_error(error_msg);
+                return;
+            }
+            Formato formato = dfActual->columnas[agg->columna].formato;
+            if ((f == AGG_SUM || f == AGG_MEAN) && formato != FMT_ENTERO && formato != FMT_REAL) {
+                snprintf(error_msg, sizeof(error_msg), "%s solo se aplica a columnas numéricas: %s",
+                         nombreFuncionAgregado(agg->funcion), abre + 1);
+                print_error(error_msg);
+                return;
+            }
         }
+        numAgregados++;
+    }
+    if (!enAgregados || numAgregados == 0) {
+        print_error("Uso: groupby <columna> [<columna> ...] agg <count|sum|mean|min|max>(<columna>) ...");
+        return;
     }
-    printf("\n");
 
-    int total_filas = dfActual->numFilas;
-    int filas_a_mostrar = (abs(n) < total_filas) ? abs(n) : total_filas;
+    char nombre_df[51];
+    nombreLibreDF(nombre_df, sizeof(nombre_df));
 
-    if (n >= 0) {
-        for (int i = 0; i < filas_a_mostrar; i++) {
-            for (int j = 0; j < dfActual->numColumnas; j++) {
-                if (dfActual->columnas[j].esNulo[i]) {
-                    printf("1");
-                } else {
-                    printf("%s", (char *)dfActual->columnas[j].datos[i]);
-                }
-                if (j < dfActual->numColumnas - 1) {
-                    printf(",");
-                }
+    double inicio = tiempoActual();
+    int64_t filas = dfActual->numFilas;
+    Dataframe *res = agruparDF(dfActual, claves, numClaves, agregados, numAgregados, nombre_df);
+    if (!res)
+        return;
+    double segundos = tiempoActual() - inicio;
+
+    dfActual = res;
+    agregarDF(res);
+    listaDF.numDFs++;
+    actualizarPrompt(dfActual);
+    printf(GREEN "groupby: %" PRId64 " filas en %" PRId64 " grupos (%.3f s, %.1f Mfilas/s). Resultado en %s\n" RESET,
+           filas, res->numFilas, segundos, segundos > 0 ? (double)filas / segundos / 1e6 : 0.0, nombre_df);
+}
+
+// --- join --------------------------------------------------------------------
+// Hash join: la tabla se construye con el lado de menos filas (en left join
+// siempre con el derecho, para poder emitir las filas izquierdas sin pareja)
+// y se sondea con el otro en bloques, precargando los huecos de todo el bloque
+// antes de recorrer las cadenas. Cada hueco apunta a la primera entrada de su
+// cadena y las entradas (hash, clave, fila) van en orden de fila, así que el
+// resultado sigue el orden del lado de sondeo y, dentro de cada fila, el del
+// lado de construcción. Si las entradas no caben en caché se reparten antes
+// (radix) por los bits altos de su hueco: cada partición ocupa un tramo
+// contiguo de huecos y se enlaza con todo en caché. Las columnas del
+// resultado se reúnen directamente desde las de ambos lados.
+
+#define FILAS_BLOQUE_JOIN 1024
+#define ENTRADAS_CACHE_JOIN 32768     // A partir de aquí la construcción se particiona
+#define ENTRADAS_PARTICION_JOIN 4096  // Entradas por partición, para que quepa en L2
+#define MIN_FILAS_HILO_JOIN 65536
+#define HUECOS_MINIMOS_JOIN 1024
+
+// Las claves se comparan como enteros, como reales (si algún lado es real) o
+// como cadenas (texto y categorías, aunque tengan diccionarios distintos)
+typedef enum { CLAVE_JOIN_ENTERO, CLAVE_JOIN_REAL, CLAVE_JOIN_TEXTO } ClaseClaveJoin;
+
+typedef struct {
+    const Dataframe *df;
+    const Columna *col;
+    uint64_t *hashesDic;        // Hash de cada valor del diccionario (categorías)
+} LadoJoin;
+
+typedef struct {
+    uint64_t hash, clave;
+    int64_t fila;               // Fila física
+} EntradaJoin;
+
+typedef struct {
+    ClaseClaveJoin clase;
+    TipoJoin tipo;
+    LadoJoin construccion, sondeo;
+    int sondeoIzquierdo;        // 1 si se sondea con el lado izquierdo
+    EntradaJoin *entradas;
+    uint32_t *huecos;           // Primera entrada + 1 de cada cadena (0: vacía)
+    uint32_t *siguientes;       // Siguiente entrada + 1 de la cadena
+    uint64_t mascara;           // Número de huecos - 1 (potencia de 2)
+} ConsultaJoin;
+
+typedef struct {
+    const ConsultaJoin *consulta;
+    int64_t inicio, fin;        // Filas lógicas del lado de sondeo
+    int64_t *izquierdas, *derechas; // Parejas de filas físicas (-1: sin pareja)
+    int64_t numParejas, capacidad;
+    int ok;
+} TareaJoin;
+
+typedef struct {
+    Columna *destino;
+    const Columna *origen;
+    const int64_t *filas;
+} ColumnaJoin;
+
+typedef struct {
+    const ColumnaJoin *columnas;
+    int numColumnas;
+    int64_t inicio, fin;        // Filas del resultado; 'inicio' múltiplo de 64
+} TareaReunirJoin;
+
+static int claseClaveJoin(const Columna *a, const Columna *b, ClaseClaveJoin *clase) {
+    int textoA = a->formato == FMT_TEXTO || ES_CATEGORIA(a->formato);
+    int textoB = b->formato == FMT_TEXTO || ES_CATEGORIA(b->formato);
+    int numeroA = a->formato == FMT_ENTERO || a->formato == FMT_REAL;
+    int numeroB = b->formato == FMT_ENTERO || b->formato == FMT_REAL;
+    if (textoA && textoB)
+        *clase = CLAVE_JOIN_TEXTO;
+    else if (numeroA && numeroB)
+        *clase = a->formato == FMT_REAL || b->formato == FMT_REAL ? CLAVE_JOIN_REAL : CLAVE_JOIN_ENTERO;
+    else if (a->formato == FMT_FECHA && b->formato == FMT_FECHA)
+        *clase = CLAVE_JOIN_ENTERO;
+    else
+        return 0;
+    return 1;
+}
+
+// Clave y hash de las filas físicas 'filas'. Las claves nulas se marcan en
+// 'nulos' y nunca coinciden con nada.
+static void clavesJoin(const LadoJoin *l, ClaseClaveJoin clase, const int64_t *filas, int n, uint64_t *claves,
+                       uint64_t *hashes, uint8_t *nulos) {
+    const Columna *col = l->col;
+    switch (col->formato) {
+    case FMT_ENTERO:
+        for (int r = 0; r < n; r++) {
+            if (clase == CLAVE_JOIN_REAL) {
+                double x = (double)col->enteros[filas[r]];
+                memcpy(&claves[r], &x, sizeof(x));
+            } else {
+                claves[r] = (uint64_t)col->enteros[filas[r]];
             }
-            printf("\n");
         }
-    } else {
-        for (int i = total_filas - 1; i >= total_filas - filas_a_mostrar; i--) {
-            for (int j = 0; j < dfActual->numColumnas; j++) {
-                if (dfActual->columnas[j].esNulo[i]) {
-                    printf("1");
-                } else {
-                    printf("%s", (char *)dfActual->columnas[j].datos[i]);
-                }
-                if (j < dfActual->numColumnas - 1) {
-                    printf(",");
-                }
-            }
-            printf("\n");
+        break;
+    case FMT_REAL:
+        for (int r = 0; r < n; r++) {
+            double x = col->reales[filas[r]];
+            if (x == 0.0)
+                x = 0.0;
+            if (isnan(x))
+                x = NAN;
+            memcpy(&claves[r], &x, sizeof(x));
+        }
+        break;
+    case FMT_FECHA:
+        for (int r = 0; r < n; r++)
+            claves[r] = (uint64_t)(int64_t)col->fechas[filas[r]];
+        break;
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        for (int r = 0; r < n; r++) {
+            uint32_t codigo = codigoCelda(col, filas[r]);
+            claves[r] = (uint64_t)(uintptr_t)col->dic->valores[codigo];
+            hashes[r] = l->hashesDic[codigo];
+        }
+        break;
+    case FMT_TEXTO:
+    default:
+        for (int r = 0; r < n; r++) {
+            const char *s = col->datos[filas[r]];
+            claves[r] = (uint64_t)(uintptr_t)s;
+            hashes[r] = s ? hashTexto(s) : 0;
         }
+        break;
+    }
+    for (int r = 0; r < n; r++) {
+        nulos[r] = ES_NULO(col, filas[r]) || (clase == CLAVE_JOIN_TEXTO && !claves[r]);
+        hashes[r] = mezclarHash(0x9E3779B97F4A7C15ULL, clase == CLAVE_JOIN_TEXTO ? hashes[r] : claves[r]);
     }
 }
 
-void delcolumCLI(const char *nombreColumna) {
-    if (!dfActual || !nombreColumna) {
-        print_error("No hay df activo o nombre de columna inválido");
-        return;
+static void liberarConsultaJoin(ConsultaJoin *q) {
+    free(q->construccion.hashesDic);
+    free(q->sondeo.hashesDic);
+    free(q->entradas);
+    free(q->huecos);
+    free(q->siguientes);
+}
+
+static int prepararLadoJoin(LadoJoin *l, const Dataframe *df, int columna) {
+    l->df = df;
+    l->col = &df->columnas[columna];
+    l->hashesDic = NULL;
+    if (!ES_CATEGORIA(l->col->formato))
+        return 1;
+    const Diccionario *dic = l->col->dic;
+    l->hashesDic = malloc((size_t)(dic->numValores > 0 ? dic->numValores : 1) * sizeof(uint64_t));
+    if (!l->hashesDic)
+        return 0;
+    for (int32_t v = 0; v < dic->numValores; v++)
+        l->hashesDic[v] = hashTexto(dic->valores[v]);
+    return 1;
+}
+
+// Tabla hash encadenada con las claves no nulas del lado de construcción
+static int construirTablaJoin(ConsultaJoin *q) {
+    const LadoJoin *l = &q->construccion;
+    int64_t n = l->df->numFilas;
+    if (n >= UINT32_MAX)
+        return 0;
+    EntradaJoin *entradas = malloc((size_t)(n > 0 ? n : 1) * sizeof(EntradaJoin));
+    if (!entradas)
+        return 0;
+    int64_t filas[FILAS_BLOQUE_JOIN];
+    uint64_t claves[FILAS_BLOQUE_JOIN], hashes[FILAS_BLOQUE_JOIN];
+    uint8_t nulos[FILAS_BLOQUE_JOIN];
+    int64_t m = 0;
+    for (int64_t inicio = 0; inicio < n; inicio += FILAS_BLOQUE_JOIN) {
+        int b = n - inicio < FILAS_BLOQUE_JOIN ? (int)(n - inicio) : FILAS_BLOQUE_JOIN;
+        for (int r = 0; r < b; r++)
+            filas[r] = FILA_FISICA(l->df, inicio + r);
+        clavesJoin(l, q->clase, filas, b, claves, hashes, nulos);
+        for (int r = 0; r < b; r++) {
+            if (!nulos[r])
+                entradas[m++] = (EntradaJoin){hashes[r], claves[r], filas[r]};
+        }
     }
 
-    char nombreColumna_limpio[51];
-    strncpy(nombreColumna_limpio, nombreColumna, 50);
-    nombreColumna_limpio[50] = '\0';
-    for (int i = 0; nombreColumna_limpio[i]; i++) {
-        nombreColumna_limpio[i] = tolower(nombreColumna_limpio[i]);
+    int bitsHuecos = 0;
+    while (((uint64_t)1 << bitsHuecos) < HUECOS_MINIMOS_JOIN || ((uint64_t)1 << bitsHuecos) < (uint64_t)m * 2)
+        bitsHuecos++;
+    q->mascara = ((uint64_t)1 << bitsHuecos) - 1;
+    q->huecos = calloc(q->mascara + 1, sizeof(uint32_t));
+    q->siguientes = malloc((size_t)(m > 0 ? m : 1) * sizeof(uint32_t));
+    if (!q->huecos || !q->siguientes) {
+        free(entradas);
+        return 0;
     }
 
-    int indice_col = -1;
-    for (int i = 0; i < dfActual->numColumnas; i++) {
-        char nombre_actual_limpio[51];
-        strncpy(nombre_actual_limpio, dfActual->columnas[i].nombre, 50);
-        nombre_actual_limpio[50] = '\0';
-        for (int j = 0; nombre_actual_limpio[j]; j++) {
-            nombre_actual_limpio[j] = tolower(nombre_actual_limpio[j]);
+    // Reparto estable por los bits altos del hueco: cada partición queda con
+    // sus entradas y sus huecos contiguos
+    int bitsParticion = 0;
+    if (m > ENTRADAS_CACHE_JOIN) {
+        while (((int64_t)ENTRADAS_PARTICION_JOIN << bitsParticion) < m)
+            bitsParticion++;
+    }
+    if (bitsParticion > 0) {
+        int particiones = 1 << bitsParticion;
+        int desplazamiento = bitsHuecos - bitsParticion;
+        int64_t *posiciones = calloc((size_t)particiones, sizeof(int64_t));
+        EntradaJoin *repartidas = malloc((size_t)m * sizeof(EntradaJoin));
+        if (!posiciones || !repartidas) {
+            free(posiciones);
+            free(repartidas);
+            free(entradas);
+            return 0;
         }
-        if (strcmp(nombre_actual_limpio, nombreColumna_limpio) == 0) {
-            indice_col = i;
-            break;
+        for (int64_t e = 0; e < m; e++)
+            posiciones[(entradas[e].hash & q->mascara) >> desplazamiento]++;
+        int64_t acumulado = 0;
+        for (int p = 0; p < particiones; p++) {
+            int64_t cuantas = posiciones[p];
+            posiciones[p] = acumulado;
+            acumulado += cuantas;
         }
+        for (int64_t e = 0; e < m; e++)
+            repartidas[posiciones[(entradas[e].hash & q->mascara) >> desplazamiento]++] = entradas[e];
+        free(posiciones);
+        free(entradas);
+        entradas = repartidas;
     }
 
-    if (indice_col == -1) {
-        print_error("Columna no encontrada");
-        return;
+    // Enlazando de atrás adelante cada cadena queda en orden de fila
+    for (int64_t e = m - 1; e >= 0; e--) {
+        uint64_t h = entradas[e].hash & q->mascara;
+        q->siguientes[e] = q->huecos[h];
+        q->huecos[h] = (uint32_t)(e + 1);
     }
+    q->entradas = entradas;
+    return 1;
+}
 
-    int nuevasColumnas = dfActual->numColumnas - 1;
-    if (nuevasColumnas == 0) {
-        print_error("No se puede eliminar la última columna");
-        return;
+static int anadirParejaJoin(TareaJoin *t, int64_t izquierda, int64_t derecha) {
+    if (t->numParejas == t->capacidad) {
+        int64_t capacidad = t->capacidad ? t->capacidad * 2 : FILAS_BLOQUE_JOIN;
+        int64_t *izquierdas = realloc(t->izquierdas, (size_t)capacidad * sizeof(int64_t));
+        if (izquierdas)
+            t->izquierdas = izquierdas;
+        int64_t *derechas = realloc(t->derechas, (size_t)capacidad * sizeof(int64_t));
+        if (derechas)
+            t->derechas = derechas;
+        if (!izquierdas || !derechas)
+            return 0;
+        t->capacidad = capacidad;
     }
+    t->izquierdas[t->numParejas] = izquierda;
+    t->derechas[t->numParejas] = derecha;
+    t->numParejas++;
+    return 1;
+}
 
-    Dataframe *nuevo_df = malloc(sizeof(Dataframe));
-    if (!crearDF(nuevo_df, nuevasColumnas, dfActual->numFilas, dfActual->nombre)) {
-        print_error("Error al crear nuevo dataframe");
-        free(nuevo_df);
-        return;
+static void *hiloJoin(void *arg) {
+    TareaJoin *t = arg;
+    const ConsultaJoin *q = t->consulta;
+    const Dataframe *df = q->sondeo.df;
+    int64_t filas[FILAS_BLOQUE_JOIN];
+    uint64_t claves[FILAS_BLOQUE_JOIN], hashes[FILAS_BLOQUE_JOIN];
+    uint8_t nulos[FILAS_BLOQUE_JOIN];
+    t->ok = 0;
+    for (int64_t inicio = t->inicio; inicio < t->fin; inicio += FILAS_BLOQUE_JOIN) {
+        int b = t->fin - inicio < FILAS_BLOQUE_JOIN ? (int)(t->fin - inicio) : FILAS_BLOQUE_JOIN;
+        for (int r = 0; r < b; r++)
+            filas[r] = FILA_FISICA(df, inicio + r);
+        clavesJoin(&q->sondeo, q->clase, filas, b, claves, hashes, nulos);
+        for (int r = 0; r < b; r++)
+            __builtin_prefetch(&q->huecos[hashes[r] & q->mascara]);
+
+        for (int r = 0; r < b; r++) {
+            int emparejada = 0;
+            uint32_t e = nulos[r] ? 0 : q->huecos[hashes[r] & q->mascara];
+            for (; e; e = q->siguientes[e - 1]) {
+                const EntradaJoin *entrada = &q->entradas[e - 1];
+                if (entrada->hash != hashes[r] ||
+                    (entrada->clave != claves[r] &&
+                     (q->clase != CLAVE_JOIN_TEXTO ||
+                      strcmp((const char *)(uintptr_t)entrada->clave, (const char *)(uintptr_t)claves[r]) != 0)))
+                    continue;
+                emparejada = 1;
+                if (!(q->sondeoIzquierdo ? anadirParejaJoin(t, filas[r], entrada->fila)
+                                         : anadirParejaJoin(t, entrada->fila, filas[r])))
+                    return NULL;
+            }
+            if (!emparejada && q->tipo == JOIN_LEFT && !anadirParejaJoin(t, filas[r], -1))
+                return NULL;
+        }
+    }
+    t->ok = 1;
+    return NULL;
+}
+
+// destino[inicio + i] = origen[filas[i]], con las filas -1 nulas
+static void *hiloReunirJoin(void *arg) {
+    TareaReunirJoin *t = arg;
+    int64_t n = t->fin - t->inicio;
+    for (int c = 0; c < t->numColumnas; c++) {
+        Columna *destino = t->columnas[c].destino;
+        const Columna *origen = t->columnas[c].origen;
+        const int64_t *filas = t->columnas[c].filas + t->inicio;
+        size_t tam = tamanoCelda(origen->formato);
+        char *valores = (char *)destino->valores + (size_t)t->inicio * tam;
+        switch (tam) {
+        case sizeof(uint8_t):
+            for (int64_t i = 0; i < n; i++)
+                ((uint8_t *)valores)[i] = filas[i] < 0 ? 0 : ((const uint8_t *)origen->valores)[filas[i]];
+            break;
+        case sizeof(uint16_t):
+            for (int64_t i = 0; i < n; i++)
+                ((uint16_t *)valores)[i] = filas[i] < 0 ? 0 : ((const uint16_t *)origen->valores)[filas[i]];
+            break;
+        case sizeof(uint32_t):
+            for (int64_t i = 0; i < n; i++)
+                ((uint32_t *)valores)[i] = filas[i] < 0 ? 0 : ((const uint32_t *)origen->valores)[filas[i]];
+            break;
+        default:
+            for (int64_t i = 0; i < n; i++)
+                ((uint64_t *)valores)[i] = filas[i] < 0 ? 0 : ((const uint64_t *)origen->valores)[filas[i]];
+            break;
+        }
+        uint64_t *validos = destino->validos + (t->inicio >> 6);
+        for (size_t w = 0; w < PALABRAS_BITMAP(n); w++) {
+            int64_t base = (int64_t)w * 64;
+            int64_t cuantas = n - base < 64 ? n - base : 64;
+            uint64_t palabra = ~0ULL;
+            for (int64_t b = 0; b < cuantas; b++) {
+                int64_t f = filas[base + b];
+                if (f < 0 || ES_NULO(origen, f))
+                    palabra &= ~(1ULL << b);
+            }
+            validos[w] = palabra;
+        }
     }
+    return NULL;
+}
 
-    int nuevaColIndex = 0;
-    for (int i = 0; i < dfActual->numColumnas; i++) {
-        if (i == indice_col)
+// Crea el df resultado con las columnas de 'izq' y después las de 'der' salvo
+// su clave, reunidas según las parejas de filas
+static Dataframe *resultadoJoin(const Dataframe *izq, const Dataframe *der, int colDer, const int64_t *izquierdas,
+                                const int64_t *derechas, int64_t numFilas, const char *nombre) {
+    int numColumnas = izq->numColumnas + der->numColumnas - 1;
+    Dataframe *res = crearNuevoDataframe(numColumnas, numFilas, nombre);
+    ColumnaJoin *columnas = malloc((size_t)numColumnas * sizeof(ColumnaJoin));
+    if (!res || !columnas) {
+        free(columnas);
+        liberarRecursosEnError(res, "Error de memoria en join");
+        return NULL;
+    }
+    int c = 0;
+    for (int i = 0; i < izq->numColumnas; i++, c++)
+        columnas[c] = (ColumnaJoin){&res->columnas[c], &izq->columnas[i], izquierdas};
+    for (int i = 0; i < der->numColumnas; i++) {
+        if (i == colDer)
             continue;
-        if (!copiarColumna(&nuevo_df->columnas[nuevaColIndex], &dfActual->columnas[i],
-                           dfActual->numFilas)) {
-            // Liberar columnas ya copiadas
-            for (int k = 0; k < nuevaColIndex; k++) {
-                for (int f = 0; f < dfActual->numFilas; f++)
-                    free(nuevo_df->columnas[k].datos[f]);
-                free(nuevo_df->columnas[k].datos);
-                free(nuevo_df->columnas[k].esNulo);
+        columnas[c] = (ColumnaJoin){&res->columnas[c], &der->columnas[i], derechas};
+        c++;
+    }
+    for (c = 0; c < numColumnas; c++) {
+        char nombreCol[MAX_NOMBRE_COLUMNA + 8];
+        snprintf(nombreCol, sizeof(nombreCol), "%s", columnas[c].origen->nombre);
+        // Las columnas derechas que se llaman como una izquierda llevan sufijo
+        for (int i = 0; c >= izq->numColumnas && i < izq->numColumnas; i++) {
+            if (strcmp(izq->columnas[i].nombre, nombreCol) == 0) {
+                nombreCol[MAX_NOMBRE_COLUMNA - 5] = '\0';
+                strcat(nombreCol, "_der");
+                break;
             }
-            free(nuevo_df->columnas);
-            free(nuevo_df);
-            print_error("Error al copiar columna en delcolumCLI");
-            return;
         }
-        nuevaColIndex++;
+        if (!prepararColumnaComo(columnas[c].destino, columnas[c].origen, nombreCol)) {
+            free(columnas);
+            liberarRecursosEnError(res, "Error de memoria en join");
+            return NULL;
+        }
     }
 
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
-    snprintf(promptTerminal, sizeof(promptTerminal), "[%s: %d,%d]:> ", dfActual->nombre,
-             dfActual->numFilas, dfActual->numColumnas);
-    printf(GREEN "Se eliminó la columna '%s'\n" RESET, nombreColumna);
+    int numHilos = numeroHilos();
+    if (numHilos > numFilas / MIN_FILAS_HILO_JOIN)
+        numHilos = (int)(numFilas / MIN_FILAS_HILO_JOIN);
+    if (numHilos < 1)
+        numHilos = 1;
+    TareaReunirJoin tareas[MAX_HILOS];
+    for (int t = 0; t < numHilos; t++) {
+        tareas[t].columnas = columnas;
+        tareas[t].numColumnas = numColumnas;
+        // Tramos alineados a 64 filas para no compartir palabras del bitmap
+        tareas[t].inicio = (numFilas * t / numHilos) & ~(int64_t)63;
+        tareas[t].fin = t + 1 < numHilos ? (numFilas * (t + 1) / numHilos) & ~(int64_t)63 : numFilas;
+    }
+    ejecutarEnHilos(hiloReunirJoin, tareas, sizeof(TareaReunirJoin), numHilos);
+    free(columnas);
+    return res;
 }
 
-void delnullCLI(const char *nombreColumna) {
-    if (!dfActual || !nombreColumna) {
-        print_error("No hay df activo o nombre de columna inválido");
-        return;
+// Une 'izq' y 'der' por igualdad de las columnas 'colIzq' y 'colDer' en un df
+// nuevo. Las claves nulas no coinciden con nada. En JOIN_LEFT las filas
+// izquierdas sin pareja salen con las columnas derechas nulas.
+Dataframe *unirDF(const Dataframe *izq, const Dataframe *der, int colIzq, int colDer, TipoJoin tipo,
+                  const char *nombre) {
+    ConsultaJoin q = {.tipo = tipo};
+    if (!claseClaveJoin(&izq->columnas[colIzq], &der->columnas[colDer], &q.clase)) {
+        print_error("Las columnas de unión tienen tipos incompatibles");
+        return NULL;
+    }
+    q.sondeoIzquierdo = tipo == JOIN_LEFT || izq->numFilas >= der->numFilas;
+    const Dataframe *construccion = q.sondeoIzquierdo ? der : izq, *sondeo = q.sondeoIzquierdo ? izq : der;
+    int ok = prepararLadoJoin(&q.construccion, construccion, q.sondeoIzquierdo ? colDer : colIzq) &&
+             prepararLadoJoin(&q.sondeo, sondeo, q.sondeoIzquierdo ? colIzq : colDer) && construirTablaJoin(&q);
+
+    int numHilos = numeroHilos();
+    if (numHilos > sondeo->numFilas / MIN_FILAS_HILO_JOIN)
+        numHilos = (int)(sondeo->numFilas / MIN_FILAS_HILO_JOIN);
+    if (numHilos < 1)
+        numHilos = 1;
+    TareaJoin tareas[MAX_HILOS];
+    memset(tareas, 0, sizeof(tareas));
+    for (int t = 0; t < numHilos; t++) {
+        tareas[t].consulta = &q;
+        tareas[t].inicio = sondeo->numFilas * t / numHilos;
+        tareas[t].fin = sondeo->numFilas * (t + 1) / numHilos;
+    }
+    if (ok)
+        ejecutarEnHilos(hiloJoin, tareas, sizeof(TareaJoin), numHilos);
+
+    // Las parejas de cada hilo se juntan en orden en las del primero
+    int64_t total = 0;
+    for (int t = 0; t < numHilos; t++) {
+        ok = ok && tareas[t].ok;
+        total += tareas[t].numParejas;
+    }
+    if (ok && numHilos > 1) {
+        int64_t *izquierdas = realloc(tareas[0].izquierdas, (size_t)(total > 0 ? total : 1) * sizeof(int64_t));
+        if (izquierdas)
+            tareas[0].izquierdas = izquierdas;
+        int64_t *derechas = realloc(tareas[0].derechas, (size_t)(total > 0 ? total : 1) * sizeof(int64_t));
+        if (derechas)
+            tareas[0].derechas = derechas;
+        ok = izquierdas && derechas;
+        for (int t = 1; ok && t < numHilos; t++) {
+            memcpy(tareas[0].izquierdas + tareas[0].numParejas, tareas[t].izquierdas,
+                   (size_t)tareas[t].numParejas * sizeof(int64_t));
+            memcpy(tareas[0].derechas + tareas[0].numParejas, tareas[t].derechas,
+                   (size_t)tareas[t].numParejas * sizeof(int64_t));
+            tareas[0].numParejas += tareas[t].numParejas;
+        }
+    }
+    liberarConsultaJoin(&q);
+
+    Dataframe *res = NULL;
+    if (ok)
+        res = resultadoJoin(izq, der, colDer, tareas[0].izquierdas, tareas[0].derechas, total, nombre);
+    else
+        print_error("Error de memoria en join");
+    for (int t = 0; t < numHilos; t++) {
+        free(tareas[t].izquierdas);
+        free(tareas[t].derechas);
+    }
+    return res;
+}
+
+static Dataframe *buscarDFPorNombre(const char *nombre) {
+    for (Nodo *nodo = listaDF.primero; nodo; nodo = nodo->siguiente) {
+        const char *nombre_df = nodo->df->nombre[0] != '\0' ? nodo->df->nombre : nodo->df->indice;
+        if (strcmp(nombre_df, nombre) == 0)
+            return nodo->df;
     }
+    return NULL;
+}
 
-    int indice_col = -1;
-    for (int i = 0; i < dfActual->numColumnas; i++) {
-        if (strcmp(dfActual->columnas[i].nombre, nombreColumna) == 0) {
-            indice_col = i;
+// Ejecuta el plan pendiente de un df en modo lazy aunque no sea el activo;
+// devuelve el df que lo sustituye en la lista o NULL si falla
+static Dataframe *ejecutarPlanDe(Dataframe *df) {
+    if (!df->plan || df->plan->numOperaciones == 0)
+        return df;
+    Dataframe *anterior = dfActual;
+    dfActual = df;
+    int ok = ejecutarPlanDFActual();
+    Dataframe *nuevo = dfActual;
+    dfActual = anterior == df ? nuevo : anterior;
+    actualizarPrompt(dfActual);
+    return ok ? nuevo : NULL;
+}
+
+// join <izq> <der> on <columna> [inner|left]
+void joinCLI(const char *argumentos) {
+    char texto[MAX_LINE_LENGTH];
+    snprintf(texto, sizeof(texto), "%s", argumentos);
+    char *tokens[6];
+    int numTokens = 0;
+    for (char *tok = strtok(texto, " \t"); tok; tok = strtok(NULL, " \t")) {
+        if (numTokens == 5) {
+            numTokens++;
             break;
         }
+        tokens[numTokens++] = tok;
     }
-
-    if (indice_col == -1) {
-        print_error("Columna no encontrada");
+    TipoJoin tipo = JOIN_INNER;
+    if (numTokens == 5 && strcasecmp(tokens[4], "left") == 0)
+        tipo = JOIN_LEFT;
+    if (numTokens < 4 || numTokens > 5 || strcasecmp(tokens[2], "on") != 0 ||
+        (numTokens == 5 && tipo != JOIN_LEFT && strcasecmp(tokens[4], "inner") != 0)) {
+        print_error("Uso: join <df izquierdo> <df derecho> on <columna> [inner|left]");
         return;
     }
 
-    int filasNulas = 0;
-    for (int i = 0; i < dfActual->numFilas; i++) {
-        if (dfActual->columnas[indice_col].esNulo[i]) {
-            filasNulas++;
+    char error_msg[MAX_LINE_LENGTH + 80];
+    Dataframe *lados[2];
+    int columnas[2];
+    for (int i = 0; i < 2; i++) {
+        lados[i] = buscarDFPorNombre(tokens[i]);
+        if (!lados[i]) {
+            snprintf(error_msg, sizeof(error_msg), "Dataframe no encontrado: %s", tokens[i]);
+            print_error(error_msg);
+            return;
         }
     }
-
-    if (filasNulas == 0) {
-        printf(GREEN "No hay valores nulos para eliminar\n" RESET);
-        return;
+    for (int i = 0; i < 2; i++) {
+        Dataframe *original = lados[i];
+        if (!(lados[i] = ejecutarPlanDe(original)))
+            return;
+        if (lados[1 - i] == original)
+            lados[1 - i] = lados[i];
+        columnas[i] = encontrarIndiceColumna(lados[i], tokens[3]);
+        if (columnas[i] < 0) {
+            snprintf(error_msg, sizeof(error_msg), "Columna %s no encontrada en %s", tokens[3], tokens[i]);
+            print_error(error_msg);
+            return;
+        }
     }
 
-    int validRows = dfActual->numFilas - filasNulas;
-    Dataframe *nuevo_df = malloc(sizeof(Dataframe));
-    if (!crearDF(nuevo_df, dfActual->numColumnas, validRows, dfActual->nombre)) {
-        print_error("Error al crear nuevo dataframe");
-        free(nuevo_df);
+    char nombre_df[51];
+    nombreLibreDF(nombre_df, sizeof(nombre_df));
+
+    double inicio = tiempoActual();
+    Dataframe *res = unirDF(lados[0], lados[1], columnas[0], columnas[1], tipo, nombre_df);
+    if (!res)
         return;
-    }
+    double segundos = tiempoActual() - inicio;
 
-    for (int i = 0; i < dfActual->numColumnas; i++) {
-        strncpy(nuevo_df->columnas[i].nombre, dfActual->columnas[i].nombre, 29);
-        nuevo_df->columnas[i].nombre[29] = '\0';
-        nuevo_df->columnas[i].tipo = dfActual->columnas[i].tipo;
-    }
-
-    int newRow = 0;
-    for (int i = 0; i < dfActual->numFilas; i++) {
-        if (!dfActual->columnas[indice_col].esNulo[i]) {
-            if (!copiarFila(nuevo_df, dfActual, i, newRow)) {
-                // Liberar filas ya copiadas
-                for (int r = 0; r < newRow; r++) {
-                    for (int c = 0; c < nuevo_df->numColumnas; c++) {
-                        free(nuevo_df->columnas[c].datos[r]);
-                    }
-                }
-                for (int c = 0; c < nuevo_df->numColumnas; c++) {
-                    free(nuevo_df->columnas[c].datos);
-                    free(nuevo_df->columnas[c].esNulo);
-                }
-                free(nuevo_df->columnas);
-                free(nuevo_df);
-                print_error("Error al copiar fila en delnullCLI");
-                return;
-            }
-            newRow++;
-        }
+    dfActual = res;
+    agregarDF(res);
+    listaDF.numDFs++;
+    actualizarPrompt(dfActual);
+    printf(GREEN "join: %" PRId64 " x %" PRId64 " filas -> %" PRId64 " filas (%.3f s). Resultado en %s\n" RESET,
+           lados[0]->numFilas, lados[1]->numFilas, res->numFilas, segundos, nombre_df);
+}
+
+// --- Índices -----------------------------------------------------------------
+// createindex guarda en la columna sus filas no nulas agrupadas por valor
+// (hash) u ordenadas por valor (sorted). Una cláusula de filter se resuelve
+// con el índice cuando sus filas ocupan como mucho dos tramos del array de
+// filas: el tramo de la constante o, con neq, lo que queda a sus lados. Si los
+// tramos suman pocas filas se marcan directamente en la selección en vez de
+// recorrer la columna. Como el índice describe el almacenamiento de la
+// columna, sobrevive a los filter y delnull (que solo crean vistas) y se
+// descarta en add, sort o materialize.
+
+#define FRACCION_INDICE 16       // Se usa si cumplen como mucho 1/16 de las filas
+#define FRACCION_INDICE_TEXTO 2  // Comparar cadenas es caro: basta con la mitad
+#define HUECOS_INICIALES_INDICE 1024
+
+// Clave de hash de una fila no nula: la cadena se compara por contenido
+static uint64_t claveIndice(const Columna *col, int64_t fila) {
+    switch (col->formato) {
+    case FMT_ENTERO:
+        return (uint64_t)col->enteros[fila];
+    case FMT_FECHA:
+        return (uint64_t)(int64_t)col->fechas[fila];
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        return codigoCelda(col, fila);
+    case FMT_TEXTO:
+    default:
+        return (uint64_t)(uintptr_t)col->datos[fila];
     }
+}
 
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
-    snprintf(promptTerminal, sizeof(promptTerminal), "[%s: %d,%d]:> ", dfActual->nombre,
-             dfActual->numFilas, dfActual->numColumnas);
-    printf(GREEN "Se eliminaron %d filas con valores nulos\n" RESET, filasNulas);
+static uint64_t hashClaveIndice(const Columna *col, uint64_t clave) {
+    if (col->formato == FMT_TEXTO)
+        clave = hashTexto((const char *)(uintptr_t)clave);
+    return mezclarHash(0x9E3779B97F4A7C15ULL, clave);
 }
 
-// Macro para validar punteros
-#define VALIDAR_PTR(ptr)                                                                           \
-    do {                                                                                           \
-        if (!(ptr)) {                                                                              \
-            print_error("Puntero nulo");                                                           \
-            return 0;                                                                              \
-        }                                                                                          \
-    } while (0)
+// Hueco de la clave en el índice: ocupado por su grupo o libre
+static uint64_t huecoIndice(const IndiceColumna *ind, const Columna *col, uint64_t clave, uint64_t h) {
+    uint64_t i = h & ind->mascara;
+    for (; ind->huecos[i] >= 0; i = (i + 1) & ind->mascara) {
+        uint64_t otra = ind->claves[ind->huecos[i]];
+        if (otra == clave ||
+            (col->formato == FMT_TEXTO && strcmp((const char *)(uintptr_t)otra, (const char *)(uintptr_t)clave) == 0))
+            break;
+    }
+    return i;
+}
 
-int copiarColumna(Columna *destino, const Columna *origen, int numFilas) {
-    VALIDAR_PTR(destino);
-    VALIDAR_PTR(origen);
-    if (numFilas <= 0)
+static int crecerHuecosIndice(IndiceColumna *ind, const Columna *col) {
+    uint64_t mascara = ind->mascara ? ind->mascara * 2 + 1 : HUECOS_INICIALES_INDICE - 1;
+    int32_t *huecos = malloc((size_t)(mascara + 1) * sizeof(int32_t));
+    if (!huecos)
         return 0;
+    memset(huecos, 0xFF, (size_t)(mascara + 1) * sizeof(int32_t));
+    free(ind->huecos);
+    ind->huecos = huecos;
+    ind->mascara = mascara;
+    for (int64_t g = 0; g < ind->numGrupos; g++)
+        huecos[huecoIndice(ind, col, ind->claves[g], hashClaveIndice(col, ind->claves[g]))] = (int32_t)g;
+    return 1;
+}
 
-    destino->datos = malloc(numFilas * sizeof(char *));
-    destino->esNulo = malloc(numFilas * sizeof(EstadoNulo));
-    if (!destino->datos || !destino->esNulo) {
-        free(destino->datos);
-        free(destino->esNulo);
-        print_error("Fallo al asignar memoria en copiarColumna");
+// Agrupa las filas por valor: primero el grupo de cada fila y su tamaño, y
+// después cada fila en su grupo, en orden
+static int construirIndiceHash(IndiceColumna *ind, const Columna *col) {
+    int64_t n = col->numFilas;
+    int32_t *grupos = malloc((size_t)(n > 0 ? n : 1) * sizeof(int32_t));
+    int64_t capacidad = 0;
+    if (!grupos || !crecerHuecosIndice(ind, col)) {
+        free(grupos);
         return 0;
     }
-    for (int i = 0; i < numFilas; i++) {
-        if (origen->datos && origen->datos[i]) {
-            destino->datos[i] = strdup(origen->datos[i]);
-            if (!destino->datos[i]) {
-                // Liberar lo previamente asignado
-                for (int j = 0; j < i; j++)
-                    free(destino->datos[j]);
-                free(destino->datos);
-                free(destino->esNulo);
-                print_error("Fallo al copiar dato en copiarColumna");
+    for (int64_t i = 0; i < n; i++) {
+        if (ES_NULO(col, i) || (col->formato == FMT_TEXTO && !col->datos[i])) {
+            grupos[i] = -1;
+            continue;
+        }
+        uint64_t clave = claveIndice(col, i);
+        uint64_t hueco = huecoIndice(ind, col, clave, hashClaveIndice(col, clave));
+        if (ind->huecos[hueco] < 0) {
+            if (ind->numGrupos == capacidad) {
+                capacidad = capacidad ? capacidad * 2 : HUECOS_INICIALES_INDICE;
+                uint64_t *claves = realloc(ind->claves, (size_t)capacidad * sizeof(uint64_t));
+                if (claves)
+                    ind->claves = claves;
+                int64_t *inicios = realloc(ind->inicios, (size_t)(capacidad + 1) * sizeof(int64_t));
+                if (inicios)
+                    ind->inicios = inicios;
+                if (!claves || !inicios || capacidad > INT32_MAX) {
+                    free(grupos);
+                    return 0;
+                }
+            }
+            int64_t g = ind->numGrupos++;
+            ind->claves[g] = clave;
+            ind->inicios[g] = 0;
+            ind->huecos[hueco] = (int32_t)g;
+            if ((uint64_t)ind->numGrupos * 2 > ind->mascara && !crecerHuecosIndice(ind, col)) {
+                free(grupos);
                 return 0;
             }
+            grupos[i] = (int32_t)g;
         } else {
-            destino->datos[i] = NULL;
+            grupos[i] = ind->huecos[hueco];
         }
-        destino->esNulo[i] = origen->esNulo ? origen->esNulo[i] : 0;
+        ind->inicios[grupos[i]]++;
+    }
+
+    // Tamaños a posiciones de inicio; inicios[numGrupos] es el total
+    if (!ind->inicios && !(ind->inicios = malloc(sizeof(int64_t)))) {
+        free(grupos);
+        return 0;
+    }
+    int64_t acumulado = 0;
+    for (int64_t g = 0; g < ind->numGrupos; g++) {
+        int64_t cuantas = ind->inicios[g];
+        ind->inicios[g] = acumulado;
+        acumulado += cuantas;
+    }
+    ind->inicios[ind->numGrupos] = acumulado;
+    ind->numIndexadas = acumulado;
+    ind->filas = malloc((size_t)(acumulado > 0 ? acumulado : 1) * sizeof(int64_t));
+    int64_t *posiciones = malloc((size_t)(ind->numGrupos > 0 ? ind->numGrupos : 1) * sizeof(int64_t));
+    if (!ind->filas || !posiciones) {
+        free(posiciones);
+        free(grupos);
+        return 0;
     }
-    destino->tipo = origen->tipo;
-    copiarNombreColumna(destino->nombre, origen->nombre);
+    memcpy(posiciones, ind->inicios, (size_t)ind->numGrupos * sizeof(int64_t));
+    for (int64_t i = 0; i < n; i++) {
+        if (grupos[i] >= 0)
+            ind->filas[posiciones[grupos[i]]++] = i;
+    }
+    free(posiciones);
+    free(grupos);
     return 1;
 }
 
-int copiarFila(Dataframe *destino, const Dataframe *origen, int fila_origen, int fila_destino) {
-    VALIDAR_PTR(destino);
-    VALIDAR_PTR(origen);
-    if (fila_origen < 0 || fila_destino < 0 || fila_origen >= origen->numFilas ||
-        fila_destino >= destino->numFilas) {
-        print_error("Índice de fila fuera de rango en copiarFila");
-        return 0;
-    }
-    for (int col = 0; col < origen->numColumnas && col < destino->numColumnas; col++) {
-        if (origen->columnas[col].datos && origen->columnas[col].datos[fila_origen]) {
-            destino->columnas[col].datos[fila_destino] =
-                strdup(origen->columnas[col].datos[fila_origen]);
-            if (!destino->columnas[col].datos[fila_destino]) {
-                // Liberar lo previamente asignado en esta fila
-                for (int j = 0; j < col; j++) {
-                    free(destino->columnas[j].datos[fila_destino]);
-                    destino->columnas[j].datos[fila_destino] = NULL;
-                }
-                print_error("Fallo al copiar dato en copiarFila");
-                return 0;
-            }
-        } else {
-            destino->columnas[col].datos[fila_destino] = NULL;
-        }
-        destino->columnas[col].esNulo[fila_destino] =
-            origen->columnas[col].esNulo ? origen->columnas[col].esNulo[fila_origen] : 0;
+// Filas no nulas ordenadas por valor, con el mismo orden que sort. Los NaN
+// quedan fuera porque no cumplen ninguna comparación.
+static int construirIndiceOrdenado(IndiceColumna *ind, const Columna *col) {
+    ind->filas = argsortColumna(col, col->numFilas, 0);
+    if (!ind->filas)
+        return 0;
+    int64_t k = 0;
+    for (int64_t i = 0; i < col->numFilas; i++) {
+        int64_t f = ind->filas[i];
+        if (!ES_NULO(col, f) && !(col->formato == FMT_REAL && isnan(col->reales[f])))
+            ind->filas[k++] = f;
     }
+    ind->numIndexadas = k;
     return 1;
 }
 
-int nombreDFUnico(const Lista *lista, const char *nombre) {
-    if (!lista || !nombre) return 0;
-    Nodo *actual = lista->primero;
-    while (actual) {
-        const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
-        if (strcmp(nombre_df, nombre) == 0) return 0;
-        actual = actual->siguiente;
+IndiceColumna *crearIndice(const Columna *col, TipoIndice tipo) {
+    IndiceColumna *ind = calloc(1, sizeof(IndiceColumna));
+    if (!ind)
+        return NULL;
+    ind->tipo = tipo;
+    ind->numFilas = col->numFilas;
+    ind->referencias = 1;
+    int ok = tipo == INDICE_HASH ? construirIndiceHash(ind, col) : construirIndiceOrdenado(ind, col);
+    if (!ok) {
+        liberarIndice(ind);
+        return NULL;
+    }
+    return ind;
+}
+
+// Si el valor de 'fila' queda antes del tramo que cumple la cláusula (cota 0)
+// o no después de él (cota 1). Ambas condiciones se cumplen en un prefijo de
+// las filas ordenadas, así que el tramo se encuentra con dos búsquedas binarias.
+static int antesDeCota(const Predicado *pred, int64_t minimo, int64_t maximo, int64_t fila, int cota) {
+    const Columna *col = pred->col;
+    OperadorFiltro op = pred->op;
+    int cmp;
+    switch (col->formato) {
+    case FMT_ENTERO:
+        return cota ? col->enteros[fila] <= maximo : col->enteros[fila] < minimo;
+    case FMT_FECHA:
+        return cota ? col->fechas[fila] <= maximo : col->fechas[fila] < minimo;
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        return cota ? (int64_t)codigoCelda(col, fila) <= maximo : (int64_t)codigoCelda(col, fila) < minimo;
+    case FMT_REAL: {
+        double v = col->reales[fila], c = pred->real;
+        if (op == OP_EQ || op == OP_NEQ)
+            return cota ? v - c < EPSILON_FILTRO : v - c <= -EPSILON_FILTRO;
+        cmp = (v > c) - (v < c);
+        break;
+    }
+    case FMT_TEXTO:
+    default:
+        cmp = strcmp(col->datos[fila], pred->texto);
+        break;
+    }
+    switch (op) {
+    case OP_GT:
+        return cota ? 1 : cmp <= 0;
+    case OP_GET:
+        return cota ? 1 : cmp < 0;
+    case OP_LT:
+        return cota ? cmp < 0 : 0;
+    case OP_LET:
+        return cota ? cmp <= 0 : 0;
+    case OP_EQ:
+    case OP_NEQ:
+    default:
+        return cota ? cmp <= 0 : cmp < 0;
+    }
+}
+
+static int64_t buscarCota(const IndiceColumna *ind, const Predicado *pred, int64_t minimo, int64_t maximo,
+                          int cota) {
+    int64_t izq = 0, der = ind->numIndexadas;
+    while (izq < der) {
+        int64_t medio = izq + (der - izq) / 2;
+        if (antesDeCota(pred, minimo, maximo, ind->filas[medio], cota))
+            izq = medio + 1;
+        else
+            der = medio;
+    }
+    return izq;
+}
+
+// Tramo [desde, hasta) de ind->filas con las filas que son iguales a la
+// constante (hash) o que cumplen la cláusula sin negar (sorted). Devuelve 0 si
+// el índice no sirve para esta cláusula.
+static int tramoIndice(const IndiceColumna *ind, const Predicado *pred, int64_t *desde, int64_t *hasta) {
+    const Columna *col = pred->col;
+    int64_t minimo = pred->minimo, maximo = pred->maximo;
+    int vacio = pred->vacio;
+    if (col->formato == FMT_FECHA) {
+        minimo = pred->op == OP_GT ? (int64_t)pred->fecha + 1 : pred->op == OP_GET ? pred->fecha : INT32_MIN;
+        maximo = pred->op == OP_LT ? (int64_t)pred->fecha - 1 : pred->op == OP_LET ? pred->fecha : INT32_MAX;
+        if (pred->op == OP_EQ || pred->op == OP_NEQ)
+            minimo = maximo = pred->fecha;
+        vacio = 0;
+    } else if (col->formato == FMT_REAL) {
+        vacio = isnan(pred->real);
+    } else if (col->formato == FMT_TEXTO) {
+        vacio = 0;
+    }
+    *desde = *hasta = 0;
+    if (vacio)
+        return 1;
+
+    if (ind->tipo == INDICE_ORDENADO) {
+        *desde = buscarCota(ind, pred, minimo, maximo, 0);
+        *hasta = buscarCota(ind, pred, minimo, maximo, 1);
+        if (*hasta < *desde)
+            *hasta = *desde;
+        return 1;
+    }
+
+    // Hash: solo igualdades con una única clave
+    if (pred->op != OP_EQ && pred->op != OP_NEQ)
+        return 0;
+    uint64_t clave;
+    if (col->formato == FMT_TEXTO)
+        clave = (uint64_t)(uintptr_t)pred->texto;
+    else if (minimo == maximo)
+        clave = (uint64_t)minimo;
+    else
+        return 0;
+    int32_t g = ind->huecos[huecoIndice(ind, col, clave, hashClaveIndice(col, clave))];
+    if (g >= 0) {
+        *desde = ind->inicios[g];
+        *hasta = ind->inicios[g + 1];
     }
     return 1;
 }
 
-void cambiarDFPorNombre(Lista *lista, const char *nombre) {
-    if (!lista || !nombre) {
-        print_error("Nombre de dataframe inválido.");
-        return;
+// Resuelve la cláusula con el índice de su columna si lo tiene y la cláusula
+// es selectiva. Devuelve las filas que la cumplen, como evaluarPredicadoMascara,
+// o -1 si hay que recorrer la columna.
+int64_t evaluarConIndice(const Predicado *pred, int64_t numFilas, const uint64_t *mascara,
+                         uint64_t *seleccion) {
+    const IndiceColumna *ind = pred->col->indice;
+    int64_t desde, hasta;
+    if (!ind || ind->numFilas != numFilas || pred->col->numFilas != numFilas ||
+        !tramoIndice(ind, pred, &desde, &hasta))
+        return -1;
+
+    // Con neq la cláusula se cumple fuera del tramo (salvo contra NaN, que no
+    // cumple nada); en enteros y categorías lo dice el propio predicado
+    const Columna *col = pred->col;
+    int negado = pred->op == OP_NEQ && !(col->formato == FMT_REAL && isnan(pred->real));
+    if (col->formato == FMT_ENTERO || ES_CATEGORIA(col->formato))
+        negado = pred->negado;
+    int64_t cumplen = negado ? ind->numIndexadas - (hasta - desde) : hasta - desde;
+    int fraccion = col->formato == FMT_TEXTO ? FRACCION_INDICE_TEXTO : FRACCION_INDICE;
+    if (cumplen > numFilas / fraccion)
+        return -1;
+
+    size_t palabras = PALABRAS_BITMAP(numFilas);
+    memset(seleccion, 0, palabras * sizeof(uint64_t));
+    const int64_t *filas = ind->filas;
+    if (negado) {
+        for (int64_t k = 0; k < desde; k++)
+            MARCAR_FILA(seleccion, filas[k], 1);
+        for (int64_t k = hasta; k < ind->numIndexadas; k++)
+            MARCAR_FILA(seleccion, filas[k], 1);
+    } else {
+        for (int64_t k = desde; k < hasta; k++)
+            MARCAR_FILA(seleccion, filas[k], 1);
     }
-    Nodo *nodoActual = lista->primero;
-    while (nodoActual) {
-        const char *nombre_df = (nodoActual->df->nombre[0] != '\0') ? nodoActual->df->nombre : nodoActual->df->indice;
-        if (strcmp(nombre_df, nombre) == 0) {
-            dfActual = nodoActual->df;
-            actualizarPrompt(dfActual);
-            printf(GREEN "Cambiado a %s con %d filas y %d columnas\n" RESET, nombre_df, dfActual->numFilas, dfActual->numColumnas);
-            return;
-        }
-        nodoActual = nodoActual->siguiente;
+    int64_t total = 0;
+    for (size_t w = 0; w < palabras; w++) {
+        if (mascara)
+            seleccion[w] &= mascara[w];
+        total += __builtin_popcountll(seleccion[w]);
     }
-    print_error("Dataframe no encontrado por nombre.");
+    return total;
 }
 
-void prefixCLI(const char *nombre_col, int n, const char *nombre_nueva_col) {
-    if (!dfActual || !nombre_col || !nombre_nueva_col) {
-        print_error("Argumentos inválidos para prefixCLI");
+// createindex <columna> [hash|sorted]
+void createindexCLI(const char *argumentos) {
+    if (!dfActual) {
+        print_error("No hay dataframe activo");
         return;
     }
-    int idx = encontrarIndiceColumna(dfActual, nombre_col);
-    if (idx == -1) {
+    char nombre_col[MAX_NOMBRE_COLUMNA], tipo_texto[16] = "sorted";
+    int leidos = sscanf(argumentos, "%29s %15s", nombre_col, tipo_texto);
+    TipoIndice tipo = strcasecmp(tipo_texto, "hash") == 0 ? INDICE_HASH : INDICE_ORDENADO;
+    if (leidos < 1 || (tipo == INDICE_ORDENADO && strcasecmp(tipo_texto, "sorted") != 0)) {
+        print_error("Uso: createindex <columna> [hash|sorted]");
+        return;
+    }
+    int c = encontrarIndiceColumna(dfActual, nombre_col);
+    if (c < 0) {
         print_error("Columna no encontrada");
         return;
     }
-    if (dfActual->columnas[idx].tipo != TEXTO) {
-        print_error("La columna debe ser de tipo texto");
+    Columna *col = &dfActual->columnas[c];
+    if (tipo == INDICE_HASH && col->formato == FMT_REAL) {
+        print_error("eq en columnas reales usa una tolerancia: use un índice sorted");
         return;
     }
-    if (encontrarIndiceColumna(dfActual, nombre_nueva_col) != -1) {
-        print_error("Ya existe una columna con ese nombre");
+
+    double inicio = tiempoActual();
+    IndiceColumna *ind = crearIndice(col, tipo);
+    if (!ind) {
+        print_error("Error de memoria al crear el índice");
         return;
     }
-    Dataframe *nuevo_df = crearNuevoDataframe(dfActual->numColumnas + 1, dfActual->numFilas, dfActual->nombre);
-    if (!nuevo_df) return;
-    // Copiar columnas existentes
-    for (int c = 0; c < dfActual->numColumnas; c++) {
-        if (!copiarColumna(&nuevo_df->columnas[c], &dfActual->columnas[c], dfActual->numFilas)) {
-            for (int k = 0; k < c; k++) {
-                for (int f = 0; f < dfActual->numFilas; f++)
-                    free(nuevo_df->columnas[k].datos[f]);
-                free(nuevo_df->columnas[k].datos);
-                free(nuevo_df->columnas[k].esNulo);
+    liberarIndice(col->indice);
+    col->indice = ind;
+    if (tipo == INDICE_HASH)
+        printf(GREEN "Índice hash sobre %s: %" PRId64 " filas, %" PRId64 " valores distintos (%.3f s)\n" RESET,
+               col->nombre, ind->numIndexadas, ind->numGrupos, tiempoActual() - inicio);
+    else
+        printf(GREEN "Índice sorted sobre %s: %" PRId64 " filas (%.3f s)\n" RESET, col->nombre, ind->numIndexadas,
+               tiempoActual() - inicio);
+}
+
+// --- Estadísticas --------------------------------------------------------------
+// Cada columna guarda sus nulos, mínimo y máximo, si está ordenada y un
+// HyperLogLog de sus valores, del que sale una estimación de los distintos.
+// Se calculan en paralelo por tramos de filas que luego se combinan; add
+// combina del mismo modo las de las filas nuevas con las que ya había. meta
+// solo las imprime y filter descarta sin recorrer la columna las cláusulas
+// cuya constante cae fuera de [mínimo, máximo].
+
+#define BITS_HLL 9                  // log2(REGISTROS_HLL)
+#define MIN_FILAS_HILO_ESTADISTICAS 65536
+
+// Paso final de splitmix64: hashes parecidos acaban en registros distintos
+static uint64_t mezclarBits(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Los bits altos eligen el registro; en él se guarda la posición del primer
+// 1 del resto (el bit centinela la limita a 64 - BITS_HLL)
+static inline void anotarHLL(uint8_t *registros, uint64_t h) {
+    uint64_t resto = (h << BITS_HLL) | (UINT64_C(1) << (BITS_HLL - 1));
+    uint8_t rango = (uint8_t)(__builtin_clzll(resto) + 1);
+    uint8_t *registro = &registros[h >> (64 - BITS_HLL)];
+    if (rango > *registro)
+        *registro = rango;
+}
+
+// log() sin depender de libm: x = m * 2^k con m en [1, 2) y
+// log(m) = 2 * atanh((m - 1) / (m + 1)), que converge deprisa
+static double logaritmo(double x) {
+    int k = 0;
+    while (x >= 2.0) {
+        x /= 2.0;
+        k++;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        k--;
+    }
+    double y = (x - 1.0) / (x + 1.0), potencia = y, suma = 0.0;
+    for (int i = 1; i < 40; i += 2) {
+        suma += potencia / i;
+        potencia *= y * y;
+    }
+    return 2.0 * suma + k * 0.69314718055994530942;
+}
+
+int64_t distintosEstimados(const EstadisticasColumna *est) {
+    if (!est->hayValores)
+        return 0;
+    double suma = 0.0, m = REGISTROS_HLL;
+    int vacios = 0;
+    for (int j = 0; j < REGISTROS_HLL; j++) {
+        int r = est->registros[j] < 63 ? est->registros[j] : 63;
+        suma += 1.0 / (double)(UINT64_C(1) << r);
+        vacios += r == 0;
+    }
+    double estimacion = 0.7213 / (1.0 + 1.079 / m) * m * m / suma;
+    // Con pocos valores es más precisa la proporción de registros vacíos
+    if (estimacion <= 2.5 * m && vacios > 0)
+        estimacion = m * logaritmo(m / vacios);
+    return estimacion < 1.0 ? 1 : (int64_t)(estimacion + 0.5);
+}
+
+static int compararEstadistica(Formato formato, ValorEstadistica a, ValorEstadistica b) {
+    switch (formato) {
+    case FMT_REAL:
+        return (a.r > b.r) - (a.r < b.r);
+    case FMT_TEXTO:
+        return strcmp(a.s, b.s);
+    default:
+        return (a.e > b.e) - (a.e < b.e);
+    }
+}
+
+const char *textoEstadistica(const Columna *col, ValorEstadistica v, char *buffer, size_t tamBuffer) {
+    switch (col->formato) {
+    case FMT_ENTERO:
+        snprintf(buffer, tamBuffer, "%" PRId64, v.e);
+        return buffer;
+    case FMT_REAL:
+        formatearDoble(buffer, tamBuffer, v.r);
+        return buffer;
+    case FMT_FECHA: {
+        int anio, mes, dia;
+        descomponerFecha((int32_t)v.e, &anio, &mes, &dia);
+        snprintf(buffer, tamBuffer, "%04d-%02d-%02d", anio, mes, dia);
+        return buffer;
+    }
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        return col->dic->valores[v.e];
+    case FMT_TEXTO:
+    default:
+        return v.s;
+    }
+}
+
+// Hash de cada valor del diccionario, el mismo que tendría como texto. NULL si
+// falta memoria: entonces se calcula fila a fila.
+static uint64_t *hashesDiccionario(const Diccionario *dic) {
+    uint64_t *hashes = malloc((size_t)(dic->numValores > 0 ? dic->numValores : 1) * sizeof(uint64_t));
+    for (int32_t k = 0; hashes && k < dic->numValores; k++)
+        hashes[k] = hashTexto(dic->valores[k]);
+    return hashes;
+}
+
+// Estadísticas de las filas lógicas [inicio, fin) ('filas': las de una vista)
+static void estadisticasTramo(const Columna *col, const int64_t *filas, int64_t inicio, int64_t fin,
+                              const uint64_t *hashesDic, EstadisticasColumna *est) {
+    memset(est, 0, sizeof(*est));
+    est->validas = est->exactas = est->ordenada = 1;
+    ValorEstadistica anterior = {0};
+    for (int64_t i = inicio; i < fin; i++) {
+        int64_t fila = filas ? filas[i] : i;
+        if (ES_NULO(col, fila)) {
+            est->nulos++;
+            continue;
+        }
+        ValorEstadistica v;
+        uint64_t h;
+        switch (col->formato) {
+        case FMT_ENTERO:
+            h = (uint64_t)(v.e = col->enteros[fila]);
+            break;
+        case FMT_FECHA:
+            h = (uint64_t)(v.e = col->fechas[fila]);
+            break;
+        case FMT_REAL:
+            v.r = col->reales[fila];
+            if (isnan(v.r)) {
+                est->ordenada = 0;
+                continue;
             }
-            free(nuevo_df->columnas);
-            free(nuevo_df);
-            print_error("Error al copiar columna en prefixCLI");
-            return;
+            if (v.r == 0.0)
+                v.r = 0.0; // -0.0 y 0.0 son el mismo valor
+            memcpy(&h, &v.r, sizeof(h));
+            break;
+        case FMT_CATEGORIA8:
+        case FMT_CATEGORIA16:
+            v.e = codigoCelda(col, fila);
+            h = hashesDic ? hashesDic[v.e] : hashTexto(col->dic->valores[v.e]);
+            break;
+        case FMT_TEXTO:
+        default:
+            if (!(v.s = col->datos[fila]))
+                continue;
+            h = hashTexto(v.s);
+            break;
         }
-    }
-    // Nueva columna de prefijos
-    strncpy(nuevo_df->columnas[dfActual->numColumnas].nombre, nombre_nueva_col, 29);
-    nuevo_df->columnas[dfActual->numColumnas].nombre[29] = '\0';
-    nuevo_df->columnas[dfActual->numColumnas].tipo = TEXTO;
-    nuevo_df->columnas[dfActual->numColumnas].datos = malloc(dfActual->numFilas * sizeof(char *));
-    nuevo_df->columnas[dfActual->numColumnas].esNulo = malloc(dfActual->numFilas * sizeof(EstadoNulo));
-    if (!nuevo_df->columnas[dfActual->numColumnas].datos || !nuevo_df->columnas[dfActual->numColumnas].esNulo) {
-        for (int k = 0; k < dfActual->numColumnas; k++) {
-            for (int f = 0; f < dfActual->numFilas; f++)
-                free(nuevo_df->columnas[k].datos[f]);
-            free(nuevo_df->columnas[k].datos);
-            free(nuevo_df->columnas[k].esNulo);
-        }
-        free(nuevo_df->columnas);
-        free(nuevo_df);
-        print_error("Error al asignar memoria para columna prefix");
-        return;
-    }
-    for (int fila = 0; fila < dfActual->numFilas; fila++) {
-        if (dfActual->columnas[idx].esNulo[fila] || !dfActual->columnas[idx].datos[fila]) {
-            nuevo_df->columnas[dfActual->numColumnas].datos[fila] = strdup("");
-            nuevo_df->columnas[dfActual->numColumnas].esNulo[fila] = NO_NULO;
+        anotarHLL(est->registros, mezclarBits(h));
+        if (!est->hayValores) {
+            est->minimo = est->maximo = v;
+            est->hayValores = 1;
         } else {
-            char *valor = dfActual->columnas[idx].datos[fila];
-            size_t len = strlen(valor);
-            size_t pref_len = (len < (size_t)n) ? len : (size_t)n;
-            char *prefijo = malloc(pref_len + 1);
-            strncpy(prefijo, valor, pref_len);
-            prefijo[pref_len] = '\0';
-            nuevo_df->columnas[dfActual->numColumnas].datos[fila] = prefijo;
-            nuevo_df->columnas[dfActual->numColumnas].esNulo[fila] = NO_NULO;
+            if (est->ordenada && compararEstadistica(col->formato, v, anterior) < 0)
+                est->ordenada = 0;
+            if (compararEstadistica(col->formato, v, est->minimo) < 0)
+                est->minimo = v;
+            else if (compararEstadistica(col->formato, v, est->maximo) > 0)
+                est->maximo = v;
         }
+        anterior = v;
     }
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
-    actualizarPrompt(dfActual);
-    printf(GREEN "Nueva columna '%s' creada con los primeros %d caracteres de '%s'\n" RESET, nombre_nueva_col, n, nombre_col);
 }
 
-void listCLI() {
-    Nodo *actual = listaDF.primero;
-    if (!actual) {
-        printf("No hay dataframes cargados en memoria.\n");
-        return;
+// Añade a 'a' las estadísticas 'b' de las filas que van detrás. Siguen
+// ordenadas si ambas lo están y b empieza donde acaba a: ordenadas, el último
+// valor de a es su máximo y el primero de b su mínimo.
+static void combinarEstadisticas(EstadisticasColumna *a, const EstadisticasColumna *b, Formato formato) {
+    a->ordenada = a->ordenada && b->ordenada &&
+                  (!a->hayValores || !b->hayValores || compararEstadistica(formato, a->maximo, b->minimo) <= 0);
+    if (b->hayValores) {
+        if (!a->hayValores || compararEstadistica(formato, b->minimo, a->minimo) < 0)
+            a->minimo = b->minimo;
+        if (!a->hayValores || compararEstadistica(formato, b->maximo, a->maximo) > 0)
+            a->maximo = b->maximo;
+        a->hayValores = 1;
     }
-    while (actual) {
-        const char *nombre_df = (actual->df->nombre[0] != '\0') ? actual->df->nombre : actual->df->indice;
-        printf("%s: %d filas, %d columnas\n", nombre_df, actual->df->numFilas, actual->df->numColumnas);
-        actual = actual->siguiente;
+    a->nulos += b->nulos;
+    a->exactas = a->exactas && b->exactas;
+    for (int j = 0; j < REGISTROS_HLL; j++) {
+        if (b->registros[j] > a->registros[j])
+            a->registros[j] = b->registros[j];
     }
 }
 
-void addCLI(const char *nombre_archivo, char sep) {
-    if (!dfActual) {
-        print_error("No hay dataframe activo");
-        return;
-    }
-    FILE *file = fopen(nombre_archivo, "r");
-    if (!file) {
-        print_error("No se puede abrir el archivo");
-        return;
+void calcularEstadisticasColumna(const Columna *col, const int64_t *filas, int64_t n,
+                                 EstadisticasColumna *est) {
+    uint64_t *hashesDic = ES_CATEGORIA(col->formato) ? hashesDiccionario(col->dic) : NULL;
+    estadisticasTramo(col, filas, 0, n, hashesDic, est);
+    free(hashesDic);
+}
+
+typedef struct {
+    const Dataframe *df;
+    uint64_t **hashesDic;       // Por columna (NULL: no es categórica)
+    int64_t inicio, fin;        // Filas lógicas del df
+    EstadisticasColumna *parciales; // Una por columna
+} TareaEstadisticas;
+
+static void *hiloEstadisticas(void *arg) {
+    TareaEstadisticas *t = arg;
+    for (int c = 0; c < t->df->numColumnas; c++) {
+        const Columna *col = &t->df->columnas[c];
+        if (!col->estadisticas.validas)
+            estadisticasTramo(col, t->df->filas, t->inicio, t->fin, t->hashesDic[c], &t->parciales[c]);
     }
-    char *headerLine = NULL;
-    size_t len = 0;
-    if (getline(&headerLine, &len, file) == -1) {
-        print_error("Error al leer encabezados");
-        free(headerLine);
-        fclose(file);
-        return;
+    return NULL;
+}
+
+// Calcula las estadísticas de las columnas que no las tienen. Devuelve 0 si
+// falta memoria (quedan sin calcular).
+int calcularEstadisticasDF(Dataframe *df) {
+    int pendientes = 0;
+    for (int c = 0; c < df->numColumnas; c++)
+        pendientes += !df->columnas[c].estadisticas.validas;
+    if (pendientes == 0)
+        return 1;
+
+    int numHilos = numeroHilos();
+    if (numHilos > df->numFilas / MIN_FILAS_HILO_ESTADISTICAS)
+        numHilos = (int)(df->numFilas / MIN_FILAS_HILO_ESTADISTICAS);
+    if (numHilos < 1)
+        numHilos = 1;
+    TareaEstadisticas tareas[MAX_HILOS];
+    uint64_t **hashesDic = calloc((size_t)df->numColumnas, sizeof(uint64_t *));
+    int ok = hashesDic != NULL;
+    for (int t = 0; t < numHilos; t++) {
+        tareas[t].df = df;
+        tareas[t].hashesDic = hashesDic;
+        tareas[t].inicio = df->numFilas * t / numHilos;
+        tareas[t].fin = df->numFilas * (t + 1) / numHilos;
+        tareas[t].parciales = malloc((size_t)df->numColumnas * sizeof(EstadisticasColumna));
+        ok = ok && tareas[t].parciales;
     }
-    // Contar columnas del archivo
-    int numColumnasArchivo = 1;
-    for (char *p = headerLine; *p; ++p) {
-        if (*p == sep) numColumnasArchivo++;
+    for (int c = 0; ok && c < df->numColumnas; c++) {
+        const Columna *col = &df->columnas[c];
+        if (!col->estadisticas.validas && ES_CATEGORIA(col->formato))
+            hashesDic[c] = hashesDiccionario(col->dic);
     }
-    if (numColumnasArchivo != dfActual->numColumnas) {
-        print_error("El archivo debe tener el mismo número de columnas que el dataframe actual");
-        free(headerLine);
-        fclose(file);
-        return;
+    if (ok) {
+        ejecutarEnHilos(hiloEstadisticas, tareas, sizeof(TareaEstadisticas), numHilos);
+        // Los tramos se combinan en orden, para saber si la columna está ordenada
+        for (int c = 0; c < df->numColumnas; c++) {
+            Columna *col = &df->columnas[c];
+            if (col->estadisticas.validas)
+                continue;
+            for (int t = 1; t < numHilos; t++)
+                combinarEstadisticas(&tareas[0].parciales[c], &tareas[t].parciales[c], col->formato);
+            col->estadisticas = tareas[0].parciales[c];
+        }
     }
-    // Verificar nombres de columnas
-    char *token = strtok(headerLine, &sep);
-    int columnaActual = 0;
-    while (token && columnaActual < numColumnasArchivo) {
-        // Limpiar espacios y caracteres de nueva línea del token
-        char *clean_token = token;
-        while (*clean_token == ' ' || *clean_token == '\t' || *clean_token == '\r' || *clean_token == '\n') {
-            clean_token++;
-        }
-        char *end = clean_token + strlen(clean_token) - 1;
-        while (end > clean_token && (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')) {
-            end--;
-        }
-        *(end + 1) = '\0';
-        
-        if (strcmp(clean_token, dfActual->columnas[columnaActual].nombre) != 0) {
-            printf("DEBUG: Columna %d - Archivo: '%s' vs DataFrame: '%s'\n", 
-                   columnaActual, clean_token, dfActual->columnas[columnaActual].nombre);
-            print_error("Los nombres de las columnas deben coincidir");
-            free(headerLine);
-            fclose(file);
-            return;
+    for (int c = 0; hashesDic && c < df->numColumnas; c++)
+        free(hashesDic[c]);
+    free(hashesDic);
+    for (int t = 0; t < numHilos; t++)
+        free(tareas[t].parciales);
+    return ok;
+}
+
+// Ajusta las estadísticas de df a las filas que deja un filtro: las marcadas
+// en 'seleccion' si df no es una vista o, si es NULL, las 'total' primeras de
+// su vector de filas. df->numFilas es aún el de antes. Los nulos se recuentan
+// con la validez; mínimo, máximo y distintos pasan a ser cotas.
+void restringirEstadisticas(Dataframe *df, const uint64_t *seleccion, int64_t total) {
+    for (int c = 0; c < df->numColumnas; c++) {
+        Columna *col = &df->columnas[c];
+        EstadisticasColumna *est = &col->estadisticas;
+        if (!est->validas)
+            continue;
+        int64_t nulos = 0;
+        if (seleccion) {
+            int64_t conValor = 0;
+            for (size_t w = 0; w < PALABRAS_BITMAP(df->numFilas); w++)
+                conValor += __builtin_popcountll(seleccion[w] & col->validos[w]);
+            nulos = total - conValor;
+        } else {
+            for (int64_t i = 0; i < total; i++)
+                nulos += ES_NULO(col, df->filas[i]);
         }
-        token = strtok(NULL, &sep);
-        columnaActual++;
+        est->nulos = nulos;
+        if (total < df->numFilas)
+            est->exactas = 0;
+        if (nulos == total)
+            est->hayValores = 0;
     }
-    free(headerLine);
-    // Contar filas del archivo
-    int filasArchivo = 0;
-    char *linea = NULL;
-    size_t lenLinea = 0;
-    while (getline(&linea, &lenLinea, file) != -1) {
-        filasArchivo++;
+}
+
+// Completa las estadísticas 'antes' de las primeras 'base' filas de la columna
+// con las de las filas que add acaba de añadir detrás
+void anexarEstadisticas(Columna *col, const EstadisticasColumna *antes, int64_t base) {
+    EstadisticasColumna nuevas;
+    uint64_t *hashesDic = ES_CATEGORIA(col->formato) ? hashesDiccionario(col->dic) : NULL;
+    estadisticasTramo(col, NULL, base, col->numFilas, hashesDic, &nuevas);
+    free(hashesDic);
+    col->estadisticas = *antes;
+    combinarEstadisticas(&col->estadisticas, &nuevas, col->formato);
+}
+
+// Con la constante comparada con el mínimo y el máximo, ¿puede cumplirse?
+static int fueraDeRango(OperadorFiltro op, int cmpMinimo, int cmpMaximo) {
+    switch (op) {
+    case OP_EQ:
+        return cmpMinimo < 0 || cmpMaximo > 0;
+    case OP_NEQ:
+        return cmpMinimo == 0 && cmpMaximo == 0;
+    case OP_GT:
+        return cmpMaximo >= 0;
+    case OP_LT:
+        return cmpMinimo <= 0;
+    case OP_GET:
+        return cmpMaximo > 0;
+    case OP_LET:
+        return cmpMinimo < 0;
+    default:
+        return 0;
     }
-    free(linea);
-    if (filasArchivo == 0) {
-        print_error("El archivo no tiene datos");
-        fclose(file);
-        return;
+}
+
+// 1 si las estadísticas de la columna aseguran que ninguna fila cumple el
+// predicado. Los nulos (y los NaN) nunca cumplen, así que basta con que la
+// constante quede fuera de [mínimo, máximo], que siguen valiendo como cotas
+// tras un filter.
+int descartadoPorEstadisticas(const Predicado *pred) {
+    const Columna *col = pred->col;
+    const EstadisticasColumna *est = &col->estadisticas;
+    if (!est->validas)
+        return 0;
+    if (!est->hayValores)
+        return 1;
+    switch (col->formato) {
+    case FMT_ENTERO:
+    case FMT_CATEGORIA8:
+    case FMT_CATEGORIA16:
+        if (pred->vacio)
+            return !pred->negado;
+        if (pred->negado)
+            return pred->minimo <= est->minimo.e && est->maximo.e <= pred->maximo;
+        return pred->maximo < est->minimo.e || pred->minimo > est->maximo.e;
+    case FMT_FECHA: {
+        int64_t c = pred->fecha;
+        return fueraDeRango(pred->op, (c > est->minimo.e) - (c < est->minimo.e),
+                            (c > est->maximo.e) - (c < est->maximo.e));
     }
-    // Crear nuevo dataframe con filas adicionales
-    Dataframe *nuevo_df = crearNuevoDataframe(dfActual->numColumnas, dfActual->numFilas + filasArchivo, dfActual->nombre);
-    if (!nuevo_df) {
-        fclose(file);
-        return;
+    case FMT_REAL: {
+        double c = pred->real;
+        if (isnan(c))
+            return 1;
+        // eq admite una diferencia de EPSILON_FILTRO: se deja margen de sobra
+        if (pred->op == OP_EQ)
+            return c < est->minimo.r - 2 * EPSILON_FILTRO || c > est->maximo.r + 2 * EPSILON_FILTRO;
+        return fueraDeRango(pred->op, (c > est->minimo.r) - (c < est->minimo.r),
+                            (c > est->maximo.r) - (c < est->maximo.r));
     }
-    // Copiar columnas existentes
-    for (int c = 0; c < dfActual->numColumnas; c++) {
-        strncpy(nuevo_df->columnas[c].nombre, dfActual->columnas[c].nombre, 29);
-        nuevo_df->columnas[c].nombre[29] = '\0';
-        nuevo_df->columnas[c].tipo = dfActual->columnas[c].tipo;
-        nuevo_df->columnas[c].datos = malloc((dfActual->numFilas + filasArchivo) * sizeof(char *));
-        nuevo_df->columnas[c].esNulo = malloc((dfActual->numFilas + filasArchivo) * sizeof(EstadoNulo));
-        if (!nuevo_df->columnas[c].datos || !nuevo_df->columnas[c].esNulo) {
-            for (int k = 0; k < c; k++) {
-                free(nuevo_df->columnas[k].datos);
-                free(nuevo_df->columnas[k].esNulo);
-            }
-            free(nuevo_df->columnas);
-            free(nuevo_df);
-            fclose(file);
-            print_error("Error al asignar memoria");
-            return;
-        }
-        // Copiar datos existentes
-        for (int f = 0; f < dfActual->numFilas; f++) {
-            if (dfActual->columnas[c].datos[f]) {
-                nuevo_df->columnas[c].datos[f] = strdup(dfActual->columnas[c].datos[f]);
-            } else {
-                nuevo_df->columnas[c].datos[f] = NULL;
-            }
-            nuevo_df->columnas[c].esNulo[f] = dfActual->columnas[c].esNulo[f];
-        }
-    }
-    // Leer y añadir nuevas filas
-    rewind(file);
-    // Saltar encabezados
-    char *tempHeader = NULL;
-    size_t tempLen = 0;
-    getline(&tempHeader, &tempLen, file);
-    free(tempHeader);
-    
-    int filaDestino = dfActual->numFilas;
-    char *nuevaLinea = NULL;
-    size_t nuevaLenLinea = 0;
-    while (getline(&nuevaLinea, &nuevaLenLinea, file) != -1 && filaDestino < dfActual->numFilas + filasArchivo) {
-        char *token = strtok(nuevaLinea, &sep);
-        int col = 0;
-        while (token && col < dfActual->numColumnas) {
-            if (token[0] != '\0' && token[0] != '\n' && token[0] != '\r') {
-                nuevo_df->columnas[col].datos[filaDestino] = strdup(token);
-                nuevo_df->columnas[col].esNulo[filaDestino] = NO_NULO;
-            } else {
-                nuevo_df->columnas[col].datos[filaDestino] = NULL;
-                nuevo_df->columnas[col].esNulo[filaDestino] = NULO;
-            }
-            token = strtok(NULL, &sep);
-            col++;
-        }
-        filaDestino++;
+    case FMT_TEXTO:
+    default:
+        return fueraDeRango(pred->op, strcmp(pred->texto, est->minimo.s),
+                            strcmp(pred->texto, est->maximo.s));
     }
-    free(nuevaLinea);
-    fclose(file);
-    liberarMemoriaDF(dfActual);
-    dfActual = nuevo_df;
-    actualizarPrompt(dfActual);
-    printf(GREEN "Añadidas %d filas del archivo '%s'\n" RESET, filasArchivo, nombre_archivo);
-}
\ No newline at end of file
+}
@@ -3,20 +3,40 @@
 #define LIB_H
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define USAR_AVX2 1                 // Kernels con AVX2 (se eligen en ejecución)
+#endif
 
 // Constantes de configuración del sistema
 #define MAX_LINE_LENGTH 4096
-#define MAX_COLUMNS 1000
-#define MAX_ROWS 5000
 #define MAX_FILENAME 256
 #define MAX_NOMBRE_COLUMNA 30
 #define MAX_INDICE_LENGTH 20
 #define BATCH_SIZE 5000
+#define CAPACIDAD_INICIAL 1024      // Filas reservadas al crear una columna vacía
+#define MAX_HILOS 64                // Límite de hilos de trabajo
+#define MIN_BYTES_HILO_CSV (4 << 20) // Bytes mínimos de CSV por hilo al cargar
+#define FILAS_TRAMO_CSV 65536      // Filas que formatea cada hilo por vuelta al guardar
+#define BYTES_LOTE_FLUJO (64 << 20)  // Bytes de CSV por lote en modo stream
+#define BYTES_MUESTRA_FLUJO (1 << 20) // Bytes de CSV de los que se deduce el esquema del stream
+#define MAX_OPERACIONES_PLAN 32    // Operaciones pendientes en un plan lazy o de stream
+#define FILAS_MUESTRA_PLAN 1024    // Filas con las que se validan las operaciones de un plan lazy
+#define MAX_LECTURAS_OPERACION 16  // Columnas que una operación de plan puede leer
 
 // Códigos de color ANSI para salida por consola
 #define RED "\x1b[31m"
@@ -40,30 +60,148 @@ typedef enum {
     FECHA
 } TipoDato;
 
-// Estado de nulidad de datos
+// Representación en memoria de los valores de una columna
 typedef enum {
-    NO_NULO = 0,
-    NULO = 1
-} EstadoNulo;
+    FMT_TEXTO,                  // Una cadena (char *) por celda
+    FMT_ENTERO,                 // int64_t contiguos (NUMERICO sin decimales)
+    FMT_REAL,                   // double contiguos (NUMERICO con decimales)
+    FMT_FECHA,                  // int32_t con días desde 1970-01-01
+    FMT_CATEGORIA8,             // TEXTO con pocos valores: código uint8_t + diccionario
+    FMT_CATEGORIA16             // TEXTO con pocos valores: código uint16_t + diccionario
+} Formato;
+
+#define ES_CATEGORIA(formato) ((formato) == FMT_CATEGORIA8 || (formato) == FMT_CATEGORIA16)
+
+// Bloque de memoria de una arena de texto; las cadenas se escriben seguidas
+typedef struct BloqueArena {
+    struct BloqueArena *anterior;   // Bloque lleno anterior (NULL en el primero)
+    size_t usado;                   // Bytes ocupados de 'datos'
+    size_t tamano;                  // Bytes disponibles en 'datos'
+    char datos[];
+} BloqueArena;
+
+// Instantánea .dfb proyectada en memoria: las columnas cargadas de ella usan
+// sus arrays en sitio y la mantienen abierta mientras los necesiten
+typedef struct {
+    void *datos;                // Contenido proyectado (MAP_PRIVATE)
+    size_t tamano;              // Tamaño del archivo en bytes
+    int referencias;            // Columnas y arenas que apuntan dentro
+} MapaInstantanea;
+
+// Arena de cadenas de una columna de texto: reserva por incremento dentro de
+// bloques grandes y se libera entera. Las cadenas nunca se mueven, así que
+// las columnas guardan punteros a ellas; varias columnas pueden compartir la
+// misma arena (cuenta de referencias).
+typedef struct {
+    BloqueArena *actual;            // Bloque en el que se escribe
+    MapaInstantanea *mapa;          // Instantánea con más cadenas de la arena (o NULL)
+    int referencias;                // Columnas que usan la arena
+} ArenaTexto;
+
+// Valores distintos de una columna codificada, ordenados: el código de una
+// celda es la posición de su valor, así que comparar códigos equivale a
+// comparar cadenas. Puede compartirse entre columnas (cuenta de referencias).
+typedef struct {
+    char **valores;             // Cadenas ordenadas con strcmp
+    int32_t numValores;         // Número de valores distintos
+    ArenaTexto *arena;          // Dónde viven las cadenas
+    int referencias;            // Columnas que usan el diccionario
+} Diccionario;
+
+typedef enum {
+    INDICE_HASH,                // Filas agrupadas por valor: eq y neq
+    INDICE_ORDENADO             // Filas ordenadas por valor: todos los operadores
+} TipoIndice;
+
+// Índice secundario de una columna con sus filas no nulas (y no NaN). Describe
+// el almacenamiento de la columna: se comparte con él y se descarta cuando se
+// escribe o se sustituye (add, sort, materialize...).
+typedef struct {
+    TipoIndice tipo;
+    int64_t numFilas;           // Filas de la columna al crearlo
+    int64_t *filas;             // Filas indexadas, ordenadas o agrupadas por valor
+    int64_t numIndexadas;
+    uint64_t *claves;           // INDICE_HASH: valor de cada grupo (las cadenas como puntero)
+    int64_t *inicios;           // INDICE_HASH: el grupo g ocupa filas[inicios[g]..inicios[g + 1])
+    int64_t numGrupos;
+    int32_t *huecos;            // INDICE_HASH: grupo de cada hueco (-1: libre)
+    uint64_t mascara;           // INDICE_HASH: número de huecos - 1
+    int referencias;            // Columnas que comparten el índice
+} IndiceColumna;
+
+#define REGISTROS_HLL 512       // Registros del estimador de valores distintos
+
+// Valor mínimo o máximo de una columna, en el formato de la columna
+typedef union {
+    int64_t e;                  // FMT_ENTERO, FMT_FECHA y códigos de FMT_CATEGORIA*
+    double r;                   // FMT_REAL
+    const char *s;              // FMT_TEXTO: cadena de la arena de la columna
+} ValorEstadistica;
+
+// Estadísticas de las filas de una columna. Se calculan al cargar, las
+// mantienen add, filter, sort y las columnas derivadas y se descartan cuando
+// alguien escribe en la columna (separarColumna). Tras filtrar, mínimo,
+// máximo y distintos pasan a ser cotas; los nulos siempre son exactos.
+typedef struct {
+    int validas;                // 0: hay que recalcularlas
+    int exactas;                // 0: mínimo, máximo y distintos son cotas
+    int ordenada;               // Los valores no nulos están en orden no decreciente
+    int hayValores;             // Alguna fila tiene valor (sin contar NaN)
+    int64_t nulos;              // Filas nulas
+    ValorEstadistica minimo, maximo;
+    uint8_t registros[REGISTROS_HLL]; // HyperLogLog de los valores
+} EstadisticasColumna;
 
 // Estructura para representar una columna del dataframe
 typedef struct {
     char nombre[30];            // Nombre de la columna
     TipoDato tipo;              // Tipo de datos de la columna (TEXTO, NUMERICO, FECHA)
-    char **datos;               // Array de punteros a datos
-    EstadoNulo *esNulo;         // Array paralelo, indica valores nulos
-    int numFilas;               // Número de filas en la columna
+    Formato formato;            // Cómo se guardan los valores en memoria
+    union {
+        char **datos;           // FMT_TEXTO: array de punteros a cadenas
+        int64_t *enteros;       // FMT_ENTERO
+        double *reales;         // FMT_REAL
+        int32_t *fechas;        // FMT_FECHA
+        uint8_t *codigos8;      // FMT_CATEGORIA8
+        uint16_t *codigos16;    // FMT_CATEGORIA16
+        void *valores;          // Acceso genérico (tamanoCelda bytes por fila)
+    };
+    uint64_t *validos;          // Bitmap de validez: bit a 1 si la fila tiene valor
+    int *referencias;           // Columnas que comparten valores y validos (NULL: solo esta)
+    MapaInstantanea *mapa;      // Instantánea donde están valores y validos (NULL: en el heap)
+    ArenaTexto *arena;          // FMT_TEXTO: dónde viven las cadenas de 'datos'
+    Diccionario *dic;           // FMT_CATEGORIA*: valores a los que apuntan los códigos
+    IndiceColumna *indice;      // Índice de createindex (NULL: sin índice)
+    EstadisticasColumna estadisticas; // De las filas del df al que pertenece la columna
+    int64_t numFilas;           // Número de filas en la columna
+    int64_t capacidad;          // Filas reservadas (crece geométricamente)
 } Columna;
 
+// Acceso al bitmap de validez de una columna (64 filas por palabra)
+#define PALABRAS_BITMAP(n) ((size_t)(((n) + 63) / 64))
+#define ES_NULO(col, fila) (!(((col)->validos[(fila) >> 6] >> ((fila) & 63)) & 1))
+#define MARCAR_VALIDO(col, fila) ((col)->validos[(fila) >> 6] |= UINT64_C(1) << ((fila) & 63))
+#define MARCAR_NULO(col, fila) ((col)->validos[(fila) >> 6] &= ~(UINT64_C(1) << ((fila) & 63)))
+#define FIJAR_NULO(col, fila, nulo) ((nulo) ? MARCAR_NULO(col, fila) : MARCAR_VALIDO(col, fila))
+
+typedef struct Plan Plan;
+
 // Estructura para representar el dataframe como un conjunto de columnas
-typedef struct {
+typedef struct Dataframe {
     Columna *columnas;          // Array de columnas (con tipos de datos distintos)
     int numColumnas;            // Número de columnas en el dataframe
-    int numFilas;               // Número de filas (igual para todas las columnas)
+    int64_t numFilas;           // Número de filas (igual para todas las columnas)
     char indice[MAX_INDICE_LENGTH];  // Nombre del dataframe
     char nombre[51];            // Nombre único del dataframe (nuevo campo)
+    struct Dataframe *padre;    // Vista filtrada: df del que se toman las filas (le pertenece)
+    int64_t *filas;             // Vista filtrada: filas de 'padre' seleccionadas, en orden
+    Plan *plan;                 // Modo lazy: operaciones pendientes (NULL fuera de él)
 } Dataframe;
 
+// Fila de 'columnas' que corresponde a la fila lógica i (en una vista, las
+// columnas son las del padre)
+#define FILA_FISICA(df, i) ((df)->filas ? (df)->filas[i] : (i))
+
 // Alias para tipo FECHA: 'Fecha' alias de 'struct tm' (#include <time.h>)
 typedef struct tm Fecha;
 
@@ -79,17 +217,130 @@ typedef struct {
     Nodo *primero;             // Puntero al primer Nodo de la lista
 } Lista;
 
+// Archivo proyectado en memoria (mmap) para lectura secuencial
+typedef struct {
+    int fd;                     // Descriptor del archivo abierto
+    const char *datos;          // Contenido proyectado
+    size_t tamano;              // Tamaño del archivo en bytes
+} ArchivoMapeado;
+
+// Operadores de comparación de filter
+typedef enum {
+    OP_EQ,
+    OP_NEQ,
+    OP_GT,
+    OP_LT,
+    OP_GET,
+    OP_LET,
+    OP_INVALIDO
+} OperadorFiltro;
+
+// Condición de filter compilada: operador y constante ya convertidos al
+// formato de la columna, listos para recorrerla sin volver a parsear
+typedef struct {
+    const Columna *col;         // Columna sobre la que se evalúa
+    OperadorFiltro op;          // Operador
+    double real;                // Constante para FMT_REAL
+    int32_t fecha;              // Constante para FMT_FECHA
+    int64_t minimo, maximo;     // FMT_ENTERO y FMT_CATEGORIA*: se cumple si minimo <= v <= maximo
+    int negado;                 // FMT_ENTERO y FMT_CATEGORIA*: se cumple fuera del rango (neq)
+    int vacio;                  // FMT_ENTERO y FMT_CATEGORIA*: el rango está vacío
+    const char *texto;          // Constante para FMT_TEXTO
+} Predicado;
+
+// Expresión de filter con AND/OR/NOT y paréntesis, compilada a un árbol de
+// predicados. Los operandos de AND/OR forman una lista enlazada.
+#define MAX_NODOS_FILTRO 64
+
+typedef enum {
+    NODO_CLAUSULA,
+    NODO_AND,
+    NODO_OR,
+    NODO_NOT
+} TipoNodoFiltro;
+
+typedef struct {
+    TipoNodoFiltro tipo;
+    Predicado pred;             // NODO_CLAUSULA: condición compilada
+    int primerHijo;             // Primer operando (-1 en las cláusulas)
+    int siguiente;              // Siguiente operando del mismo nodo padre (-1 si no hay)
+    double selectividad;        // Fracción estimada de filas que cumplen el nodo
+} NodoFiltro;
+
+typedef struct {
+    NodoFiltro nodos[MAX_NODOS_FILTRO];
+    int numNodos;
+    int raiz;
+    char tokens[2 * MAX_LINE_LENGTH];  // Expresión troceada; las constantes apuntan aquí
+} ExprFiltro;
+
+// Operación de un plan: se apunta en modo lazy o stream y se ejecuta después
+typedef enum {
+    OP_PLAN_FILTRO,             // filter <expresión>
+    OP_PLAN_DELNULL,            // delnull <columna>
+    OP_PLAN_DELCOLUM,           // delcolum <columna>
+    OP_PLAN_QUARTER,            // quarter <columna_fecha> <nueva>
+    OP_PLAN_PREFIX              // prefix <columna> n <N> <nueva>
+} TipoOperacionPlan;
+
+typedef struct {
+    TipoOperacionPlan tipo;
+    char texto[MAX_LINE_LENGTH];    // Expresión de filter o columna de origen
+    char nueva[50];                 // Columna creada por quarter y prefix
+    int n;                          // Caracteres de prefix
+    char lee[MAX_LECTURAS_OPERACION][MAX_NOMBRE_COLUMNA]; // Columnas que usa (para optimizar)
+    int numLee;
+} OperacionPlan;
+
+// Operaciones pendientes sobre un dataframe. La muestra son unas pocas filas
+// a las que cada operación se aplica al apuntarla, para validarla y saber
+// qué columnas habrá después; se optimizan y ejecutan juntas más tarde.
+struct Plan {
+    Dataframe *muestra;
+    OperacionPlan operaciones[MAX_OPERACIONES_PLAN];
+    int numOperaciones;
+};
+
+// Agregado de groupby: función y columna a la que se aplica
+typedef enum {
+    AGG_COUNT,                  // Valores no nulos (filas del grupo con count(*))
+    AGG_SUM,
+    AGG_MEAN,
+    AGG_MIN,
+    AGG_MAX
+} FuncionAgregado;
+
+typedef struct {
+    FuncionAgregado funcion;
+    int columna;                // Índice de la columna en el df (-1: count(*))
+} Agregado;
+
+typedef enum {
+    JOIN_INNER,                 // Solo las filas con pareja
+    JOIN_LEFT                   // Todas las filas izquierdas
+} TipoJoin;
+
+// CSV abierto con 'load --stream': no se carga entero, solo una muestra
+typedef struct {
+    char archivo[MAX_FILENAME];
+    char sep;
+    Plan plan;                      // Operaciones que save aplica a cada lote
+    TipoDato *tipos;                // Tipo de cada columna del archivo, deducido de la muestra
+    Formato *formatos;              // Formato de cada columna del archivo
+} Flujo;
+
 // Variables globales para gestión del sistema
 extern Lista listaDF;         // Declaración de la variable global
 extern Dataframe *dfActual;  // Declaración de la variable global
 extern char promptTerminal[MAX_LINE_LENGTH];  // Declaración de la variable global
+extern Flujo *flujoActual;    // Stream abierto con 'load --stream' (o NULL)
 
 // Funciones helper para manejo de memoria y datos
-Dataframe* crearNuevoDataframe(int numColumnas, int numFilas, const char* indice);
+Dataframe* crearNuevoDataframe(int numColumnas, int64_t numFilas, const char* indice);
 void copiarNombreColumna(char* destino, const char* origen);
-char* copiarDatoSeguro(const char* origen);
 void actualizarPrompt(const Dataframe* df);
 void liberarRecursosEnError(Dataframe* df, const char* mensaje);
+void reemplazarDFActual(Dataframe* nuevo);
 
 // Funciones de inicialización y gestión
 void inicializarLista(void);
@@ -97,46 +348,119 @@ void CLI(void);
 void print_error(const char *mensaje_error);
 
 // Funciones de carga y creación de dataframes
-void contarFilasYColumnas(const char *nombre_archivo, int *numFilas, int *numColumnas);
 void loadearCSV(const char *nombre_archivo, char sep);
-int crearDF(Dataframe *df, int numColumnas, int numFilas, const char *nombre_df);
+void loadearDFB(const char *nombre_archivo);
+int guardarDFB(const Dataframe *df, const char *nombre_archivo);
+int escribirCSV(const Dataframe *df, const char *nombre_archivo);
+int escribirEncabezadoCSV(int fd, const Dataframe *df);
+int escribirFilasCSV(int fd, const Dataframe *df);
+void loadearFlujo(const char *nombre_archivo, char sep);
+void saveFlujo(const char *nombre_archivo);
+void cerrarFlujo(void);
+int esArchivoDFB(const char *nombre_archivo);
+MapaInstantanea *retenerMapa(MapaInstantanea *mapa);
+void liberarMapa(MapaInstantanea *mapa);
+int mapearArchivo(const char *nombre_archivo, ArchivoMapeado *am);
+void desmapearArchivo(ArchivoMapeado *am);
+const char *leerEncabezadoCSV(const char *p, const char *fin, char sep, Dataframe *df);
+int contarColumnasCSV(const char *p, const char *fin, char sep);
+int64_t parsearFilasCSV(const char *p, const char *fin, char sep, Dataframe *df);
+int64_t parsearFilasCSVParalelo(const char *p, const char *fin, char sep, Dataframe *df);
+double tiempoActual(void);
+int crearDF(Dataframe *df, int numColumnas, int64_t numFilas, const char *nombre_df);
+int reservarFilasColumna(Columna *col, int64_t minimo);
+int reservarFilas(Dataframe *df, int64_t minimo);
+void liberarDatosColumna(Columna *col);
+void soltarAlmacen(Columna *col);
+int compartirColumna(Columna *destino, Columna *origen);
+int separarColumna(Columna *col);
+ArenaTexto *crearArena(void);
+ArenaTexto *retenerArena(ArenaTexto *arena);
+void liberarArena(ArenaTexto *arena);
+char *copiarEnArena(ArenaTexto *arena, const char *texto, size_t len);
+void traspasarArena(ArenaTexto *destino, ArenaTexto *origen);
+char *guardarTextoColumna(Columna *col, const char *texto, size_t len);
+Diccionario *retenerDiccionario(Diccionario *dic);
+void liberarDiccionario(Diccionario *dic);
+IndiceColumna *retenerIndice(IndiceColumna *indice);
+void liberarIndice(IndiceColumna *indice);
+uint32_t codigoCelda(const Columna *col, int64_t fila);
+int codificarColumna(Columna *col);
+int prepararColumna(Columna *col, const char *nombre, TipoDato tipo, Formato formato);
 void liberarMemoriaDF(Dataframe *df);
+int materializarDF(Dataframe *df);
 
 // Funciones de procesamiento de datos
-int contarColumnas(const char *line);
 void cortarEspacios(char *str);
-void leerEncabezados(FILE *file, Dataframe *df, int numColumnas);
-void leerFilas(FILE *file, Dataframe *df, int numFilas, int numColumnas);
 
 // Funciones de manipulación de dataframes
 int agregarDF(Dataframe *nuevoDF);
-void cambiarDF(Lista *lista, int indice);
 void cambiarDFPorNombre(Lista *lista, const char *nombre);
 int nombreDFUnico(const Lista *lista, const char *nombre);
+void nombreLibreDF(char *nombre, size_t tam);
 
 // Funciones de interfaz de usuario
 void metaCLI(void);
 void viewCLI(int n);
-void viewNegativeCLI(int n);
-void sortCLI(const char *nombre_col, int esta_desc);
+void sortCLI(const char **nombres, const int *descendente, int numClaves);
 void saveCLI(const char *nombre_archivo);
-void filterCLI(Dataframe *df, const char *nombre_columna, const char *operador, void *valor);
+void filterExprCLI(Dataframe *df, const char *expresion);
 void delnullCLI(const char *nombre_col);
 void quarterCLI(const char *nombre_columna_fecha, const char *nombre_nueva_columna);
+int64_t filtrarDF(Dataframe *df, const char *expresion);
+int crearColumnaTrimestre(const char *nombre_columna_fecha, const char *nombre_nueva_columna);
+int crearColumnaPrefijo(const char *nombre_col, int n, const char *nombre_nueva_col);
+int quitarColumna(const char *nombre_col);
+int64_t eliminarNulos(const char *nombre_col);
+void liberarPlan(Plan *plan);
+int anadirOperacionPlan(Plan *plan, const OperacionPlan *op);
+int ejecutarPlan(const Plan *plan, int vaciarSinFilas);
+int ejecutarPlanDFActual(void);
+void explicarPlan(const Plan *plan);
+void apuntarOperacionCLI(const OperacionPlan *op);
+void lazyCLI(int activar);
 
 // Funciones de procesamiento y validación
 int fechaValida(const char *str_fecha);
-void verificarNulos(char *lineaLeida, int fila, Dataframe *df, char *resultado);
-int compararValores(void *a, void *b, TipoDato tipo, int esta_desc);
+int parsearEntero(const char *str, int64_t *valor);
+int parsearReal(const char *str, double *valor);
+int parsearFecha(const char *str, int32_t *dias);
+int32_t diasDesdeEpoch(int anio, int mes, int dia);
+void descomponerFecha(int32_t dias, int *anio, int *mes, int *dia);
+size_t tamanoCelda(Formato formato);
+int convertirColumna(Columna *col, Formato formato);
+const char *textoCelda(const Columna *col, int64_t fila, char *buffer, size_t tamBuffer);
 void tiposColumnas(Dataframe *df);
 void delcolumCLI(const char *nombre_col);
 
 // Funciones de filtrado y manipulación de datos
 void liberarListaCompleta(Lista *lista);
-void procesarPorLotes(FILE *file, Dataframe *df, int tamanoLote);
 int encontrarIndiceColumna(Dataframe *df, const char *nombre_columna);
-void intercambiarFilas(Dataframe *df, int fila1, int fila2);
-int comparar(void *dato1, void *dato2, TipoDato tipo, const char *operador);
+int64_t *argsortColumna(const Columna *col, int64_t numFilas, int descendente);
+int64_t *argsortColumnas(const Columna **cols, const int *descendente, int numClaves,
+                         int64_t numFilas);
+int ordenarDataframe(Dataframe *df, const int *indicesColumnas, const int *descendente,
+                     int numClaves);
+int aplicarPermutacion(Dataframe *df, const int64_t *permutacion);
+void reunirCeldas(void *destino, const void *origen, const int64_t *filas, int64_t n, size_t tam);
+void reunirValidos(uint64_t *destino, const Columna *origen, const int64_t *filas, int64_t n);
+void copiarValidos(Columna *destino, int64_t desde, const Columna *origen, int64_t n);
+int64_t contarNulos(const Columna *col, int64_t n);
+uint64_t claveOrdenableEntero(int64_t v);
+uint64_t claveOrdenableReal(double v);
+uint64_t claveOrdenableFecha(int32_t v);
+int radixSortClaves(uint64_t *claves, int64_t *indices, int64_t n, int bytesClave, int numHilos);
+
+// Funciones de soporte para trabajo en paralelo
+int numeroHilos(void);
+void ejecutarEnHilos(void *(*funcion)(void *), void *tareas, size_t tamTarea, int numHilos);
+OperadorFiltro parsearOperador(const char *operador);
+int compilarPredicado(Predicado *pred, const Columna *col, OperadorFiltro op, const char *valor);
+int compilarExprFiltro(ExprFiltro *expr, Dataframe *df, const char *texto);
+int64_t evaluarExprFiltro(const ExprFiltro *expr, int64_t numFilas, const uint64_t *mascara,
+                          uint64_t *seleccion);
+int64_t evaluarPredicadoMascara(const Predicado *pred, int64_t numFilas, const uint64_t *mascara,
+                                uint64_t *seleccion);
 
 // Funciones de copia seguras y reutilizables
 /**
@@ -146,21 +470,40 @@ int comparar(void *dato1, void *dato2, TipoDato tipo, const char *operador);
  * @param numFilas Número de filas a copiar
  * @return 1 si la copia fue exitosa, 0 en caso de error
  */
-int copiarColumna(Columna *destino, const Columna *origen, int numFilas);
+int copiarColumna(Columna *destino, const Columna *origen, int64_t numFilas);
 
 /**
- * Copia una fila completa de un dataframe origen a uno destino.
- * @param destino Dataframe destino
- * @param origen Dataframe origen (const)
- * @param fila_origen Índice de la fila en el dataframe origen
- * @param fila_destino Índice de la fila en el dataframe destino
+ * Añade al final de destino todas las filas de origen. Ambas columnas deben
+ * tener el mismo formato.
  * @return 1 si la copia fue exitosa, 0 en caso de error
  */
-int copiarFila(Dataframe *destino, const Dataframe *origen, int fila_origen, int fila_destino);
+int anexarColumna(Columna *destino, const Columna *origen);
 
 void prefixCLI(const char *nombre_col, int n, const char *nombre_nueva_col);
 void listCLI(void);
 
 void addCLI(const char *nombre_archivo, char sep);
 
+Dataframe *agruparDF(const Dataframe *df, const int *claves, int numClaves, const Agregado *agregados,
+                     int numAgregados, const char *nombre);
+void groupbyCLI(const char *argumentos);
+
+Dataframe *unirDF(const Dataframe *izq, const Dataframe *der, int colIzq, int colDer, TipoJoin tipo,
+                  const char *nombre);
+void joinCLI(const char *argumentos);
+
+IndiceColumna *crearIndice(const Columna *col, TipoIndice tipo);
+int64_t evaluarConIndice(const Predicado *pred, int64_t numFilas, const uint64_t *mascara,
+                         uint64_t *seleccion);
+void createindexCLI(const char *argumentos);
+
+void calcularEstadisticasColumna(const Columna *col, const int64_t *filas, int64_t n,
+                                 EstadisticasColumna *est);
+int calcularEstadisticasDF(Dataframe *df);
+void restringirEstadisticas(Dataframe *df, const uint64_t *seleccion, int64_t total);
+void anexarEstadisticas(Columna *col, const EstadisticasColumna *antes, int64_t base);
+int descartadoPorEstadisticas(const Predicado *pred);
+int64_t distintosEstimados(const EstadisticasColumna *est);
+const char *textoEstadistica(const Columna *col, ValorEstadistica v, char *buffer, size_t tamBuffer);
+
 #endif